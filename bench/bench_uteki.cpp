@@ -0,0 +1,325 @@
+//
+//  benchmark uteki C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/elapsed_timer.h"
+#include "uteki/stopwatch_timer.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace
+{
+
+// Benchmarks that use a `static` timer share it between all benchmark threads,
+// so runs with more than one thread measure the operation under contention.
+
+void thread_counts( benchmark::internal::Benchmark* b )
+{
+    int max_threads = static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) );
+    for ( int n = 1; n < max_threads; n *= 2 )
+    {
+        b->Threads( n );
+    }
+    b->Threads( max_threads );
+    b->UseRealTime();
+}
+
+//
+// elapsed_timer
+//
+
+template< class ClockType >
+void BM_elapsed_timer_construct( benchmark::State& state )
+{
+    for ( auto _ : state )
+    {
+        uteki::elapsed_timer<ClockType> my_timer;
+        benchmark::DoNotOptimize( my_timer );
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_value( benchmark::State& state )
+{
+    static uteki::elapsed_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize( shared_timer.value() );
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_restart( benchmark::State& state )
+{
+    static uteki::elapsed_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        shared_timer.restart();
+        benchmark::ClobberMemory();
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_copy_construct( benchmark::State& state )
+{
+    static uteki::elapsed_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        uteki::elapsed_timer<ClockType> other_timer( shared_timer );
+        benchmark::DoNotOptimize( other_timer );
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_move_construct( benchmark::State& state )
+{
+    uteki::elapsed_timer<ClockType> my_timer;
+    for ( auto _ : state )
+    {
+        uteki::elapsed_timer<ClockType> other_timer( std::move( my_timer ) );
+        benchmark::DoNotOptimize( other_timer );
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_copy_assign( benchmark::State& state )
+{
+    static uteki::elapsed_timer<ClockType> shared_timer;
+    uteki::elapsed_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        other_timer = shared_timer;
+        benchmark::ClobberMemory();
+    }
+}
+
+template< class ClockType >
+void BM_elapsed_timer_move_assign( benchmark::State& state )
+{
+    uteki::elapsed_timer<ClockType> my_timer;
+    uteki::elapsed_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        other_timer = std::move( my_timer );
+        benchmark::ClobberMemory();
+    }
+}
+
+//! `Compare` is one of the `std::equal_to<>` family, applied to the timers
+template< class ClockType, class Compare >
+void BM_elapsed_timer_compare( benchmark::State& state )
+{
+    static uteki::elapsed_timer<ClockType> shared_timer;
+    uteki::elapsed_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize( Compare()( shared_timer, other_timer ) );
+    }
+}
+
+//
+// stopwatch_timer
+//
+
+template< class ClockType >
+void BM_stopwatch_timer_construct( benchmark::State& state )
+{
+    for ( auto _ : state )
+    {
+        uteki::stopwatch_timer<ClockType> my_timer;
+        benchmark::DoNotOptimize( my_timer );
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_start_stop( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        shared_timer.start();
+        shared_timer.stop();
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_value( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize( shared_timer.value() );
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_restart( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        shared_timer.restart();
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_reset( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        shared_timer.reset();
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_copy_construct( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    for ( auto _ : state )
+    {
+        uteki::stopwatch_timer<ClockType> other_timer( shared_timer );
+        benchmark::DoNotOptimize( other_timer );
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_move_construct( benchmark::State& state )
+{
+    uteki::stopwatch_timer<ClockType> my_timer;
+    for ( auto _ : state )
+    {
+        uteki::stopwatch_timer<ClockType> other_timer( std::move( my_timer ) );
+        benchmark::DoNotOptimize( other_timer );
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_copy_assign( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    uteki::stopwatch_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        other_timer = shared_timer;
+    }
+}
+
+template< class ClockType >
+void BM_stopwatch_timer_move_assign( benchmark::State& state )
+{
+    uteki::stopwatch_timer<ClockType> my_timer;
+    uteki::stopwatch_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        other_timer = std::move( my_timer );
+        benchmark::ClobberMemory();
+    }
+}
+
+//! `Compare` is one of the `std::equal_to<>` family, applied to the timers
+template< class ClockType, class Compare >
+void BM_stopwatch_timer_compare( benchmark::State& state )
+{
+    static uteki::stopwatch_timer<ClockType> shared_timer;
+    uteki::stopwatch_timer<ClockType> other_timer;
+    for ( auto _ : state )
+    {
+        benchmark::DoNotOptimize( Compare()( shared_timer, other_timer ) );
+    }
+}
+
+//! register the benchmarks of every public operation for one clock type
+template< class ClockType >
+typename std::enable_if< ClockType::is_steady >::type register_clock( const char* clock_name )
+{
+    struct entry
+    {
+        const char* name;
+        void ( *function )( benchmark::State& );
+    };
+    const entry entries[] = {
+        { "elapsed_timer_construct", &BM_elapsed_timer_construct<ClockType> },
+        { "elapsed_timer_value", &BM_elapsed_timer_value<ClockType> },
+        { "elapsed_timer_restart", &BM_elapsed_timer_restart<ClockType> },
+        { "elapsed_timer_copy_construct", &BM_elapsed_timer_copy_construct<ClockType> },
+        { "elapsed_timer_move_construct", &BM_elapsed_timer_move_construct<ClockType> },
+        { "elapsed_timer_copy_assign", &BM_elapsed_timer_copy_assign<ClockType> },
+        { "elapsed_timer_move_assign", &BM_elapsed_timer_move_assign<ClockType> },
+        { "elapsed_timer_equal", &BM_elapsed_timer_compare< ClockType, std::equal_to<> > },
+        { "elapsed_timer_not_equal", &BM_elapsed_timer_compare< ClockType, std::not_equal_to<> > },
+        { "elapsed_timer_less", &BM_elapsed_timer_compare< ClockType, std::less<> > },
+        { "elapsed_timer_less_equal", &BM_elapsed_timer_compare< ClockType, std::less_equal<> > },
+        { "elapsed_timer_greater", &BM_elapsed_timer_compare< ClockType, std::greater<> > },
+        { "elapsed_timer_greater_equal", &BM_elapsed_timer_compare< ClockType, std::greater_equal<> > },
+        { "stopwatch_timer_construct", &BM_stopwatch_timer_construct<ClockType> },
+        { "stopwatch_timer_start_stop", &BM_stopwatch_timer_start_stop<ClockType> },
+        { "stopwatch_timer_value", &BM_stopwatch_timer_value<ClockType> },
+        { "stopwatch_timer_restart", &BM_stopwatch_timer_restart<ClockType> },
+        { "stopwatch_timer_reset", &BM_stopwatch_timer_reset<ClockType> },
+        { "stopwatch_timer_copy_construct", &BM_stopwatch_timer_copy_construct<ClockType> },
+        { "stopwatch_timer_move_construct", &BM_stopwatch_timer_move_construct<ClockType> },
+        { "stopwatch_timer_copy_assign", &BM_stopwatch_timer_copy_assign<ClockType> },
+        { "stopwatch_timer_move_assign", &BM_stopwatch_timer_move_assign<ClockType> },
+        { "stopwatch_timer_equal", &BM_stopwatch_timer_compare< ClockType, std::equal_to<> > },
+        { "stopwatch_timer_not_equal", &BM_stopwatch_timer_compare< ClockType, std::not_equal_to<> > },
+        { "stopwatch_timer_less", &BM_stopwatch_timer_compare< ClockType, std::less<> > },
+        { "stopwatch_timer_less_equal", &BM_stopwatch_timer_compare< ClockType, std::less_equal<> > },
+        { "stopwatch_timer_greater", &BM_stopwatch_timer_compare< ClockType, std::greater<> > },
+        { "stopwatch_timer_greater_equal", &BM_stopwatch_timer_compare< ClockType, std::greater_equal<> > },
+    };
+    for ( const auto& e : entries )
+    {
+        std::string name = std::string( e.name ) + "<" + clock_name + ">";
+        benchmark::RegisterBenchmark( name.c_str(), e.function )->Apply( thread_counts );
+    }
+}
+
+//! clock types that are not steady cannot be used by the timers
+template< class ClockType >
+typename std::enable_if< ! ClockType::is_steady >::type register_clock( const char* )
+{
+}
+
+}
+
+int main( int argc, char** argv )
+{
+    register_clock< std::chrono::steady_clock >( "steady_clock" );
+    register_clock< std::chrono::high_resolution_clock >( "high_resolution_clock" );
+
+    benchmark::Initialize( &argc, argv );
+    if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+#  check_baseline.py
+#
+#  Copyright © 2021 Mitchell Burghart.
+#
+#  Compare Google Benchmark JSON results against a committed baseline.
+#
+#  usage: check_baseline.py [--tolerance 0.25] [--floor-ns 1.0] [--allow-unmatched]
+#                           [--allow-host-mismatch] baseline.json results.json
+#
+#  A benchmark regresses when its time exceeds the baseline time by more than
+#  the relative tolerance plus the absolute floor. Benchmarks present in only
+#  one of the files are not gated, so they fail the check unless
+#  --allow-unmatched is given. The check also fails when the two files come
+#  from hosts with a different number of CPUs, whose thread counts differ, or
+#  from Google Benchmark libraries of different build types, unless
+#  --allow-host-mismatch is given. Files that both come from a debug library
+#  are compared, with a warning that the timings include its overhead. The
+#  exit status is 1 on any failure.
+#
+
+import argparse
+import json
+import sys
+
+TIME_UNIT_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_report(path):
+    with open(path) as f:
+        report = json.load(f)
+    times = {}
+    for b in report.get("benchmarks", []):
+        if b.get("run_type", "iteration") != "iteration":
+            continue
+        scale = TIME_UNIT_NS[b.get("time_unit", "ns")]
+        times[b["name"]] = b["real_time"] * scale
+    return report.get("context", {}), times
+
+
+def host_problems(baseline_context, results_context):
+    problems = []
+    base_build = baseline_context.get("library_build_type")
+    build = results_context.get("library_build_type")
+    if base_build != build:
+        problems.append("baseline used a %s Google Benchmark library, results a %s one"
+                        % (base_build, build))
+    base_cpus = baseline_context.get("num_cpus")
+    cpus = results_context.get("num_cpus")
+    if base_cpus != cpus:
+        problems.append("baseline host has %s CPUs, results host has %s" % (base_cpus, cpus))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="compare Google Benchmark JSON results against a baseline")
+    parser.add_argument("--tolerance", type=float, default=0.25,
+                        help="allowed relative slowdown (default 0.25)")
+    parser.add_argument("--floor-ns", type=float, default=1.0,
+                        help="allowed absolute slowdown in ns (default 1.0)")
+    parser.add_argument("--allow-unmatched", action="store_true",
+                        help="do not fail on benchmarks missing from either file")
+    parser.add_argument("--allow-host-mismatch", action="store_true",
+                        help="do not fail on CPU count or library build differences")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    args = parser.parse_args()
+
+    baseline_context, baseline = load_report(args.baseline)
+    results_context, results = load_report(args.results)
+
+    regressions = 0
+    unmatched = 0
+    width = max([len(n) for n in results] + [9])
+    print("%-*s %12s %12s %9s" % (width, "benchmark", "baseline ns", "current ns", "change"))
+    for name in sorted(results):
+        current = results[name]
+        if name not in baseline:
+            print("%-*s %12s %12.2f %9s" % (width, name, "-", current, "new"))
+            unmatched += 1
+            continue
+        base = baseline[name]
+        change = (current - base) / base if base > 0 else 0.0
+        status = ""
+        if current > base * (1.0 + args.tolerance) + args.floor_ns:
+            status = "  REGRESSION"
+            regressions += 1
+        print("%-*s %12.2f %12.2f %+8.1f%%%s" % (width, name, base, current, 100.0 * change, status))
+    for name in sorted(set(baseline) - set(results)):
+        print("%-*s %12.2f %12s %9s" % (width, name, baseline[name], "-", "missing"))
+        unmatched += 1
+
+    failed = False
+    if regressions:
+        print("%d benchmark(s) regressed beyond tolerance" % regressions)
+        failed = True
+    if unmatched:
+        print("%d benchmark(s) not in both files and not gated; regenerate the baseline"
+              % unmatched, file=sys.stderr)
+        failed = failed or not args.allow_unmatched
+    if "debug" in (baseline_context.get("library_build_type"),
+                   results_context.get("library_build_type")):
+        print("warning: built against a debug Google Benchmark library; timings include "
+              "its overhead", file=sys.stderr)
+    for problem in host_problems(baseline_context, results_context):
+        print("host mismatch: %s; regenerate the baseline on the checking host" % problem,
+              file=sys.stderr)
+        failed = failed or not args.allow_host_mismatch
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,216 @@
+//
+//  adaptive_timeout.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef adaptive_timeout_h
+#define adaptive_timeout_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+
+namespace uteki
+{
+
+//! adaptive timeout class
+//! @tparam Duration  `std::chrono::duration` type used for the estimate. The
+//! duration's tick count type must be an integral type.
+//! @details Recommends RPC timeouts and hedging delays from measured
+//! durations, such as the `value()` of an `elapsed_timer`. The estimator is
+//! the Jacobson/Karels algorithm used for TCP retransmission timeouts: a
+//! smoothed mean updated with gain 1/8 and a smoothed mean deviation updated
+//! with gain 1/4. The recommended timeout is the mean plus four deviations
+//! and the hedging delay is the mean plus one deviation, both clamped to a
+//! configured range. Until the first duration is recorded both return the
+//! initial timeout.
+//!
+//! Both estimates are kept as scaled fixed-point values packed into a single
+//! 64-bit atomic, so concurrent updates are lock-free and a reader never sees
+//! a mean and deviation from different updates. Each estimate saturates at
+//! 2^29 ticks, about nine minutes with the default microsecond resolution.
+//!
+//!  \snippet test_adaptive_timeout.cpp record adaptive_timeout example
+template< class Duration = std::chrono::microseconds >
+class adaptive_timeout
+{
+    static_assert( std::is_integral< typename Duration::rep >::value,
+                   "duration must have an integral tick count type" );
+
+public:
+    //! `std::chrono::duration` type of the estimate
+    using duration = Duration;
+    //! scalar type for duration tick count
+    using rep = typename Duration::rep;
+
+    //! timeout in deviations above the smoothed mean
+    static constexpr unsigned timeout_deviations = 4;
+    //! hedging delay in deviations above the smoothed mean
+    static constexpr unsigned hedge_deviations = 1;
+
+    //! constructor
+    //! @param initial      timeout recommended before any duration is recorded
+    //! @param min_timeout  lower bound of the recommended timeout and hedging delay
+    //! @param max_timeout  upper bound of the recommended timeout and hedging delay
+    template< class Rep1, class Period1, class Rep2, class Period2, class Rep3, class Period3 >
+    adaptive_timeout( std::chrono::duration<Rep1, Period1> initial,
+                      std::chrono::duration<Rep2, Period2> min_timeout,
+                      std::chrono::duration<Rep3, Period3> max_timeout )
+        : initial_( std::chrono::duration_cast<duration>( initial ) )
+        , min_( std::chrono::duration_cast<duration>( min_timeout ) )
+        , max_( std::chrono::duration_cast<duration>( max_timeout ) )
+        , state_( empty_state )
+        , sample_count_( 0 )
+    {}
+
+    adaptive_timeout( const adaptive_timeout& ) = delete;
+    adaptive_timeout& operator=( const adaptive_timeout& ) = delete;
+
+    ~adaptive_timeout( ) = default;
+
+    //! update the estimate with a measured duration
+    template< class Rep, class Period >
+    void record( std::chrono::duration<Rep, Period> value )
+    {
+        auto ticks = std::chrono::duration_cast<duration>( value ).count();
+        std::int64_t m = ( ticks > 0 ) ? static_cast<std::int64_t>( ticks ) : 0;
+        m = ( m < max_estimate ) ? m : max_estimate;
+
+        std::uint64_t current = state_.load( std::memory_order_relaxed );
+        std::uint64_t next;
+        do
+        {
+            std::int64_t srtt8;
+            std::int64_t rttvar4;
+            if ( current == empty_state )
+            {
+                srtt8 = m << 3;
+                rttvar4 = m << 1;
+            }
+            else
+            {
+                srtt8 = static_cast<std::int64_t>( current >> 32 );
+                rttvar4 = static_cast<std::int64_t>( current & 0xffffffffu );
+                std::int64_t error = m - ( srtt8 >> 3 );
+                srtt8 += error;
+                rttvar4 += ( ( error < 0 ) ? -error : error ) - ( rttvar4 >> 2 );
+            }
+            next = pack( srtt8, rttvar4 );
+        } while ( ! state_.compare_exchange_weak( current, next, std::memory_order_relaxed ) );
+        sample_count_.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //! smoothed mean of the recorded durations
+    //! @returns  smoothed mean, or zero if nothing was recorded
+    duration smoothed( ) const
+    {
+        std::uint64_t s = state_.load( std::memory_order_relaxed );
+        return ( s == empty_state ) ? duration::zero() : duration( static_cast<rep>( ( s >> 32 ) >> 3 ) );
+    }
+
+    //! smoothed mean deviation of the recorded durations
+    //! @returns  smoothed mean deviation, or zero if nothing was recorded
+    duration variation( ) const
+    {
+        std::uint64_t s = state_.load( std::memory_order_relaxed );
+        return ( s == empty_state ) ? duration::zero() : duration( static_cast<rep>( ( s & 0xffffffffu ) >> 2 ) );
+    }
+
+    //! recommended timeout
+    //! @returns  smoothed mean plus `timeout_deviations` deviations, clamped
+    //!  to the configured range
+    template< typename T = duration >
+    T timeout( ) const
+    {
+        return std::chrono::duration_cast<T>( estimate( timeout_deviations ) );
+    }
+
+    //! recommended delay before sending a hedged request
+    //! @returns  smoothed mean plus `hedge_deviations` deviations, clamped to
+    //!  the configured range
+    template< typename T = duration >
+    T hedge_delay( ) const
+    {
+        return std::chrono::duration_cast<T>( estimate( hedge_deviations ) );
+    }
+
+    //! number of recorded durations
+    std::uint64_t sample_count( ) const
+    {
+        return sample_count_.load( std::memory_order_relaxed );
+    }
+
+    //! discard the estimate and return to the initial timeout
+    void reset( )
+    {
+        state_.store( empty_state, std::memory_order_relaxed );
+        sample_count_.store( 0, std::memory_order_relaxed );
+    }
+
+private:
+    //! state before the first recorded duration
+    static constexpr std::uint64_t empty_state = ~std::uint64_t( 0 );
+    //! largest duration in ticks that the scaled estimates can hold
+    static constexpr std::int64_t max_estimate = ( std::int64_t( 1 ) << 29 ) - 1;
+
+    const duration initial_;
+    const duration min_;
+    const duration max_;
+    //! smoothed mean times 8 in the upper 32 bits, mean deviation times 4 in the lower
+    std::atomic<std::uint64_t> state_;
+    std::atomic<std::uint64_t> sample_count_;
+
+    static std::uint64_t pack( std::int64_t srtt8, std::int64_t rttvar4 )
+    {
+        const std::int64_t limit = 0xffffffffll - 1;
+        srtt8 = ( srtt8 < 0 ) ? 0 : ( srtt8 > limit ) ? limit : srtt8;
+        rttvar4 = ( rttvar4 < 0 ) ? 0 : ( rttvar4 > limit ) ? limit : rttvar4;
+        return ( static_cast<std::uint64_t>( srtt8 ) << 32 ) | static_cast<std::uint64_t>( rttvar4 );
+    }
+
+    duration estimate( unsigned deviations ) const
+    {
+        std::uint64_t s = state_.load( std::memory_order_relaxed );
+        duration result = initial_;
+        if ( s != empty_state )
+        {
+            std::uint64_t srtt = ( s >> 32 ) >> 3;
+            std::uint64_t rttvar = ( s & 0xffffffffu ) >> 2;
+            result = duration( static_cast<rep>( srtt + deviations * rttvar ) );
+        }
+        return ( result < min_ ) ? min_ : ( result > max_ ) ? max_ : result;
+    }
+};
+
+template< class Duration >
+constexpr unsigned adaptive_timeout<Duration>::timeout_deviations;
+template< class Duration >
+constexpr unsigned adaptive_timeout<Duration>::hedge_deviations;
+template< class Duration >
+constexpr std::uint64_t adaptive_timeout<Duration>::empty_state;
+template< class Duration >
+constexpr std::int64_t adaptive_timeout<Duration>::max_estimate;
+
+}
+
+#endif
@@ -0,0 +1,306 @@
+//
+//  bench_compare.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef bench_compare_h
+#define bench_compare_h
+
+#include "uteki/bench_result.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace uteki
+{
+
+//! result of a Mann-Whitney U test
+struct mann_whitney_result
+{
+    //! U statistic of the first sample
+    double u;
+    //! normal approximation z score, corrected for ties and continuity
+    double z;
+    //! two-sided p-value
+    double p_value;
+};
+
+//! comparison options
+struct compare_options
+{
+    //! significance level of the Mann-Whitney U test
+    double alpha = 0.05;
+    //! relative slowdown of the median below which a change is not a regression
+    double threshold = 0.0;
+    //! confidence level of the bootstrap interval
+    double confidence = 0.95;
+    //! number of bootstrap resamples
+    std::size_t resamples = 2000;
+    //! seed of the bootstrap random number generator, for reproducible results
+    std::uint64_t seed = 0x5eed;
+};
+
+//! comparison of one benchmark between a baseline and a candidate
+struct bench_comparison
+{
+    //! benchmark name
+    std::string name;
+    //! number of baseline samples
+    std::size_t baseline_count;
+    //! number of candidate samples
+    std::size_t candidate_count;
+    //! median baseline sample, in nanoseconds
+    double baseline_median;
+    //! median candidate sample, in nanoseconds
+    double candidate_median;
+    //! relative change of the median, positive when the candidate is slower
+    double change;
+    //! lower end of the bootstrap confidence interval of `change`
+    double change_low;
+    //! upper end of the bootstrap confidence interval of `change`
+    double change_high;
+    //! Mann-Whitney U test of the two sample sets
+    mann_whitney_result test;
+    //! is the difference statistically significant
+    bool significant;
+    //! is the candidate significantly slower by more than the threshold
+    bool regression;
+    //! is the candidate significantly faster by more than the threshold
+    bool improvement;
+};
+
+//! median of a sample set
+//! @returns  the median, or zero for an empty set
+inline double bench_median( std::vector<double> samples )
+{
+    if ( samples.empty() )
+    {
+        return 0.0;
+    }
+    auto middle = samples.begin() + static_cast<std::ptrdiff_t>( samples.size() / 2 );
+    std::nth_element( samples.begin(), middle, samples.end() );
+    double upper = *middle;
+    if ( samples.size() % 2 != 0 )
+    {
+        return upper;
+    }
+    double lower = *std::max_element( samples.begin(), middle );
+    return ( lower + upper ) / 2.0;
+}
+
+//! two-sided Mann-Whitney U test
+//! @details Tests whether values of one sample set tend to be larger than
+//! those of the other, without assuming a distribution; benchmark timings are
+//! skewed and heavy tailed, so this is more robust than a t-test. Uses the
+//! normal approximation with tie and continuity corrections, which is
+//! accurate for sample sets of about ten values or more.
+//!
+//!  \snippet test_bench_compare.cpp mann_whitney bench_compare example
+inline mann_whitney_result mann_whitney_u( const std::vector<double>& a, const std::vector<double>& b )
+{
+    const std::size_t n1 = a.size();
+    const std::size_t n2 = b.size();
+    if ( n1 == 0 || n2 == 0 )
+    {
+        return mann_whitney_result{ 0.0, 0.0, 1.0 };
+    }
+
+    std::vector< std::pair<double, int> > pooled;
+    pooled.reserve( n1 + n2 );
+    for ( double v : a )
+    {
+        pooled.emplace_back( v, 0 );
+    }
+    for ( double v : b )
+    {
+        pooled.emplace_back( v, 1 );
+    }
+    std::sort( pooled.begin(), pooled.end() );
+
+    // average ranks over ties
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for ( std::size_t first = 0; first < pooled.size(); )
+    {
+        std::size_t last = first;
+        while ( last + 1 < pooled.size() && pooled[last + 1].first == pooled[first].first )
+        {
+            ++last;
+        }
+        double rank = ( static_cast<double>( first + last ) / 2.0 ) + 1.0;
+        double ties = static_cast<double>( last - first + 1 );
+        tie_term += ties * ties * ties - ties;
+        for ( std::size_t k = first; k <= last; ++k )
+        {
+            if ( pooled[k].second == 0 )
+            {
+                rank_sum_a += rank;
+            }
+        }
+        first = last + 1;
+    }
+
+    const double d1 = static_cast<double>( n1 );
+    const double d2 = static_cast<double>( n2 );
+    const double n = d1 + d2;
+    const double u = rank_sum_a - d1 * ( d1 + 1.0 ) / 2.0;
+    const double mean = d1 * d2 / 2.0;
+    const double variance = d1 * d2 / 12.0 * ( ( n + 1.0 ) - tie_term / ( n * ( n - 1.0 ) ) );
+    if ( variance <= 0.0 )
+    {
+        return mann_whitney_result{ u, 0.0, 1.0 };
+    }
+    double difference = u - mean;
+    double corrected = ( difference > 0.5 ) ? difference - 0.5 : ( difference < -0.5 ) ? difference + 0.5 : 0.0;
+    double z = corrected / std::sqrt( variance );
+    double p = std::erfc( std::fabs( z ) / std::sqrt( 2.0 ) );
+    return mann_whitney_result{ u, z, p };
+}
+
+//! bootstrap confidence interval of the relative change of the median
+//! @param baseline    baseline samples
+//! @param candidate   candidate samples
+//! @param options     confidence level, resample count and seed
+//! @returns  lower and upper end of the interval of `median(candidate) / median(baseline) - 1`
+inline std::pair<double, double> bootstrap_median_change( const std::vector<double>& baseline,
+                                                          const std::vector<double>& candidate,
+                                                          const compare_options& options = compare_options() )
+{
+    if ( baseline.empty() || candidate.empty() || options.resamples == 0 )
+    {
+        return std::make_pair( 0.0, 0.0 );
+    }
+    std::mt19937_64 random( options.seed );
+    std::uniform_int_distribution<std::size_t> pick_baseline( 0, baseline.size() - 1 );
+    std::uniform_int_distribution<std::size_t> pick_candidate( 0, candidate.size() - 1 );
+
+    std::vector<double> changes;
+    changes.reserve( options.resamples );
+    std::vector<double> resample_baseline( baseline.size() );
+    std::vector<double> resample_candidate( candidate.size() );
+    for ( std::size_t r = 0; r < options.resamples; ++r )
+    {
+        for ( auto& v : resample_baseline )
+        {
+            v = baseline[ pick_baseline( random ) ];
+        }
+        for ( auto& v : resample_candidate )
+        {
+            v = candidate[ pick_candidate( random ) ];
+        }
+        double base = bench_median( resample_baseline );
+        if ( base > 0.0 )
+        {
+            changes.push_back( bench_median( resample_candidate ) / base - 1.0 );
+        }
+    }
+    if ( changes.empty() )
+    {
+        return std::make_pair( 0.0, 0.0 );
+    }
+    std::sort( changes.begin(), changes.end() );
+    double tail = ( 1.0 - options.confidence ) / 2.0;
+    auto at = [&changes]( double fraction ) {
+        auto index = static_cast<std::size_t>( fraction * static_cast<double>( changes.size() - 1 ) + 0.5 );
+        return changes[ std::min( index, changes.size() - 1 ) ];
+    };
+    return std::make_pair( at( tail ), at( 1.0 - tail ) );
+}
+
+//! compare the samples of one benchmark
+//! @details The difference is significant when the Mann-Whitney U test
+//! rejects equality at `alpha`. A significant difference is a regression
+//! when the whole bootstrap interval of the median change lies above
+//! `threshold`, and an improvement when it lies below `-threshold`.
+inline bench_comparison compare_results( const bench_result& baseline, const bench_result& candidate,
+                                         const compare_options& options = compare_options() )
+{
+    bench_comparison result;
+    result.name = baseline.name;
+    result.baseline_count = baseline.samples_ns.size();
+    result.candidate_count = candidate.samples_ns.size();
+    result.baseline_median = bench_median( baseline.samples_ns );
+    result.candidate_median = bench_median( candidate.samples_ns );
+    result.change = ( result.baseline_median > 0.0 )
+        ? result.candidate_median / result.baseline_median - 1.0 : 0.0;
+    auto interval = bootstrap_median_change( baseline.samples_ns, candidate.samples_ns, options );
+    result.change_low = interval.first;
+    result.change_high = interval.second;
+    result.test = mann_whitney_u( candidate.samples_ns, baseline.samples_ns );
+    result.significant = result.test.p_value < options.alpha;
+    result.regression = result.significant && result.change_low > options.threshold;
+    result.improvement = result.significant && result.change_high < -options.threshold;
+    return result;
+}
+
+//! compare every benchmark present in both result sets
+//! @returns  one comparison per benchmark, in baseline order
+//!
+//!  \snippet test_bench_compare.cpp compare bench_compare example
+inline std::vector<bench_comparison> compare_results( const bench_results& baseline, const bench_results& candidate,
+                                                      const compare_options& options = compare_options() )
+{
+    std::vector<bench_comparison> comparisons;
+    for ( const auto& b : baseline.results )
+    {
+        const bench_result* c = candidate.find( b.name );
+        if ( c != nullptr )
+        {
+            comparisons.push_back( compare_results( b, *c, options ) );
+        }
+    }
+    return comparisons;
+}
+
+//! metadata keys whose values differ between two result sets
+//! @details keys present in only one set are included
+inline std::vector<std::string> metadata_differences( const bench_results& baseline,
+                                                      const bench_results& candidate )
+{
+    std::vector<std::string> keys;
+    for ( const auto& m : baseline.metadata )
+    {
+        auto other = candidate.metadata.find( m.first );
+        if ( other == candidate.metadata.end() || other->second != m.second )
+        {
+            keys.push_back( m.first );
+        }
+    }
+    for ( const auto& m : candidate.metadata )
+    {
+        if ( baseline.metadata.find( m.first ) == baseline.metadata.end() )
+        {
+            keys.push_back( m.first );
+        }
+    }
+    return keys;
+}
+
+}
+
+#endif
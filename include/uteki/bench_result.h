@@ -0,0 +1,320 @@
+//
+//  bench_result.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef bench_result_h
+#define bench_result_h
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace uteki
+{
+
+//! raw samples of one benchmark
+struct bench_result
+{
+    //! benchmark name, without whitespace
+    std::string name;
+    //! duration of each measured iteration, in nanoseconds
+    std::vector<double> samples_ns;
+
+    //! add the duration of one measured iteration
+    template< class Rep, class Period >
+    void add_sample( std::chrono::duration<Rep, Period> elapsed )
+    {
+        samples_ns.push_back( std::chrono::duration<double, std::nano>( elapsed ).count() );
+    }
+};
+
+//! benchmark result set class
+//! @details Raw per-iteration samples of a set of benchmarks together with
+//! metadata about the environment they ran in, such as the CPU model, the
+//! frequency governor and the clock type, so that two runs can be compared
+//! statistically with `bench_compare` and differences in the environment can
+//! be spotted. Result sets are persisted in a versioned line-oriented text
+//! format:
+//!
+//!     uteki-bench-results 1
+//!     meta <key> <value to end of line>
+//!     bench <name> <sample count> <sample ns>...
+//!
+//! Keys and names must not contain whitespace.
+//!
+//!  \snippet test_bench_result.cpp write bench_result example
+class bench_results
+{
+public:
+    //! current format version
+    static constexpr int format_version = 1;
+
+    //! environment metadata, keyed by name
+    std::map<std::string, std::string> metadata;
+    //! benchmark results, in order of addition
+    std::vector<bench_result> results;
+
+    //! result of the benchmark with a given name
+    //! @returns  the result, or `nullptr` if there is none
+    const bench_result* find( const std::string& name ) const
+    {
+        for ( const auto& r : results )
+        {
+            if ( r.name == name )
+            {
+                return &r;
+            }
+        }
+        return nullptr;
+    }
+
+    //! result of the benchmark with a given name, added if there is none
+    bench_result& operator[]( const std::string& name )
+    {
+        for ( auto& r : results )
+        {
+            if ( r.name == name )
+            {
+                return r;
+            }
+        }
+        results.push_back( bench_result{ name, {} } );
+        return results.back();
+    }
+
+    //! record metadata describing the current environment
+    //! @tparam ClockType  clock type the samples were measured with
+    //! @details sets `clock`, `clock_period_ns`, `clock_is_steady`, `cpu`,
+    //!  `cpu_count`, `governor` and `compiler` where they can be determined
+    template< class ClockType >
+    void describe_environment( )
+    {
+        metadata["clock"] = clock_name<ClockType>();
+        std::ostringstream period;
+        period << 1e9 * ClockType::period::num / ClockType::period::den;
+        metadata["clock_period_ns"] = period.str();
+        metadata["clock_is_steady"] = ClockType::is_steady ? "true" : "false";
+        metadata["cpu_count"] = std::to_string( std::thread::hardware_concurrency() );
+#if defined( __VERSION__ )
+        metadata["compiler"] = __VERSION__;
+#elif defined( _MSC_FULL_VER )
+        metadata["compiler"] = "MSVC " + std::to_string( _MSC_FULL_VER );
+#endif
+#if defined( __linux__ )
+        std::ifstream cpuinfo( "/proc/cpuinfo" );
+        std::string line;
+        while ( std::getline( cpuinfo, line ) )
+        {
+            if ( line.compare( 0, 10, "model name" ) == 0 )
+            {
+                auto colon = line.find( ':' );
+                if ( colon != std::string::npos )
+                {
+                    metadata["cpu"] = trim( line.substr( colon + 1 ) );
+                }
+                break;
+            }
+        }
+        std::ifstream governor( "/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor" );
+        if ( std::getline( governor, line ) )
+        {
+            metadata["governor"] = trim( line );
+        }
+#endif
+    }
+
+    //! write the result set in the text format
+    void write( std::ostream& out ) const
+    {
+        auto precision = out.precision( std::numeric_limits<double>::max_digits10 );
+        out << "uteki-bench-results " << format_version << '\n';
+        for ( const auto& m : metadata )
+        {
+            out << "meta " << m.first << ' ' << m.second << '\n';
+        }
+        for ( const auto& r : results )
+        {
+            out << "bench " << r.name << ' ' << r.samples_ns.size();
+            for ( double s : r.samples_ns )
+            {
+                out << ' ' << s;
+            }
+            out << '\n';
+        }
+        out.precision( precision );
+    }
+
+    //! read a result set in the text format, replacing the current contents
+    //! @param in     stream to read from
+    //! @param error  receives a description of the problem if reading fails
+    //! @returns  `true` on success
+    bool read( std::istream& in, std::string* error = nullptr )
+    {
+        metadata.clear();
+        results.clear();
+
+        std::string line;
+        std::size_t line_number = 0;
+        bool have_header = false;
+        while ( std::getline( in, line ) )
+        {
+            ++line_number;
+            if ( line.empty() )
+            {
+                continue;
+            }
+            std::istringstream fields( line );
+            std::string kind;
+            fields >> kind;
+            if ( ! have_header )
+            {
+                int version = 0;
+                if ( kind != "uteki-bench-results" || ! ( fields >> version ) )
+                {
+                    return fail( error, line_number, "not a uteki benchmark result file" );
+                }
+                if ( version != format_version )
+                {
+                    return fail( error, line_number, "unsupported format version " + std::to_string( version ) );
+                }
+                have_header = true;
+            }
+            else if ( kind == "meta" )
+            {
+                std::string key;
+                if ( ! ( fields >> key ) )
+                {
+                    return fail( error, line_number, "missing metadata key" );
+                }
+                std::string value;
+                std::getline( fields >> std::ws, value );
+                metadata[key] = value;
+            }
+            else if ( kind == "bench" )
+            {
+                bench_result r;
+                std::size_t count = 0;
+                if ( ! ( fields >> r.name >> count ) )
+                {
+                    return fail( error, line_number, "malformed bench line" );
+                }
+                // a corrupt count must not reserve more than the line can hold,
+                // at least two characters per sample
+                r.samples_ns.reserve( std::min( count, line.size() / 2 ) );
+                double sample = 0.0;
+                while ( r.samples_ns.size() < count && fields >> sample )
+                {
+                    r.samples_ns.push_back( sample );
+                }
+                if ( r.samples_ns.size() != count )
+                {
+                    return fail( error, line_number, "expected " + std::to_string( count ) + " samples" );
+                }
+                results.push_back( std::move( r ) );
+            }
+            else
+            {
+                return fail( error, line_number, "unknown record '" + kind + "'" );
+            }
+        }
+        if ( ! have_header )
+        {
+            return fail( error, line_number, "empty file" );
+        }
+        return true;
+    }
+
+    //! write the result set to a file
+    //! @returns  `true` on success
+    bool save( const std::string& path ) const
+    {
+        std::ofstream out( path );
+        write( out );
+        return static_cast<bool>( out );
+    }
+
+    //! read a result set from a file
+    //! @returns  `true` on success
+    bool load( const std::string& path, std::string* error = nullptr )
+    {
+        std::ifstream in( path );
+        if ( ! in )
+        {
+            if ( error != nullptr )
+            {
+                *error = path + ": cannot open";
+            }
+            return false;
+        }
+        return read( in, error );
+    }
+
+private:
+    template< class ClockType >
+    static std::string clock_name( )
+    {
+        if ( std::is_same<ClockType, std::chrono::steady_clock>::value )
+        {
+            return "std::chrono::steady_clock";
+        }
+        if ( std::is_same<ClockType, std::chrono::system_clock>::value )
+        {
+            return "std::chrono::system_clock";
+        }
+        if ( std::is_same<ClockType, std::chrono::high_resolution_clock>::value )
+        {
+            return "std::chrono::high_resolution_clock";
+        }
+        return "other";
+    }
+
+    static std::string trim( const std::string& s )
+    {
+        auto first = s.find_first_not_of( " \t\r\n" );
+        auto last = s.find_last_not_of( " \t\r\n" );
+        return ( first == std::string::npos ) ? std::string() : s.substr( first, last - first + 1 );
+    }
+
+    static bool fail( std::string* error, std::size_t line_number, const std::string& message )
+    {
+        if ( error != nullptr )
+        {
+            *error = "line " + std::to_string( line_number ) + ": " + message;
+        }
+        return false;
+    }
+};
+
+}
+
+#endif
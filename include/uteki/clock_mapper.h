@@ -0,0 +1,292 @@
+//
+//  clock_mapper.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef clock_mapper_h
+#define clock_mapper_h
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace uteki
+{
+
+//! clock mapper class
+//! @tparam SourceClock  steady `std::chrono` clock type of the timestamps to convert
+//! @tparam WallClock    wall clock type to convert to
+//! @details Maps timestamps of a steady clock to wall clock time without
+//! reading either clock per timestamp. The mapper keeps a window of recent
+//! (source, wall) sample pairs. Each pair is taken as the best of a few
+//! bracketed reads, so a preemption between the two clock reads does not
+//! skew it. A least squares fit over the window gives the offset and the
+//! rate of the wall clock relative to the source clock, so drift from NTP
+//! slewing is tracked. Converting a timestamp is then a multiply-add. Call
+//! `update()` periodically, for example once per export batch; it samples
+//! the clocks only when the configured interval has passed. The mapper is
+//! thread-safe.
+//!
+//!  \snippet test_clock_mapper.cpp to_wall clock_mapper example
+template< class SourceClock = std::chrono::steady_clock,
+          class WallClock = std::chrono::system_clock >
+class clock_mapper
+{
+    static_assert( SourceClock::is_steady, "must use steady clock type" );
+
+public:
+    //! source clock's `time_point` type
+    using source_time_point = typename SourceClock::time_point;
+    //! source clock's `duration` type
+    using source_duration = typename SourceClock::duration;
+    //! wall clock's `time_point` type
+    using wall_time_point = typename WallClock::time_point;
+
+    //! constructor
+    //! @details takes the first sample
+    //! @param interval  minimum time between samples taken by `update()`
+    //! @param window    number of samples used for the fit, at least 2
+    template< class Rep = std::int64_t, class Period = std::ratio<1> >
+    explicit clock_mapper( std::chrono::duration<Rep, Period> interval = std::chrono::seconds( 1 ),
+                           std::size_t window = 16 )
+        : lock_( )
+        , interval_( std::chrono::duration_cast<source_duration>( interval ) )
+        , samples_( window < 2 ? 2 : window )
+        , sample_count_( 0 )
+        , next_sample_( 0 )
+        , last_sample_time_( )
+        , base_source_( 0 )
+        , base_wall_( 0 )
+        , base_correction_( 0.0 )
+        , rate_( 1.0 )
+        , residual_( 0 )
+    {
+        sample();
+    }
+
+    clock_mapper( const clock_mapper& ) = delete;
+    clock_mapper& operator=( const clock_mapper& ) = delete;
+
+    ~clock_mapper( ) = default;
+
+    //! sample the clocks if the sample interval has passed
+    //! @returns  `true` if a sample was taken
+    bool update( )
+    {
+        {
+            std::lock_guard<std::mutex> guard( lock_ );
+            if ( SourceClock::now() - last_sample_time_ < interval_ )
+            {
+                return false;
+            }
+        }
+        sample();
+        return true;
+    }
+
+    //! sample the clocks and refit the mapping
+    void sample( )
+    {
+        constexpr int attempts = 3;
+        std::int64_t best_source = 0;
+        std::int64_t best_wall = 0;
+        std::int64_t best_bracket = 0;
+        source_time_point last_read;
+        for ( int k = 0; k < attempts; ++k )
+        {
+            auto before = SourceClock::now();
+            auto wall = WallClock::now();
+            auto after = SourceClock::now();
+            std::int64_t bracket = to_ns( after - before );
+            if ( k == 0 || bracket < best_bracket )
+            {
+                best_bracket = bracket;
+                best_source = to_ns( before.time_since_epoch() ) + bracket / 2;
+                best_wall = to_ns( wall.time_since_epoch() );
+            }
+            last_read = after;
+        }
+
+        std::lock_guard<std::mutex> guard( lock_ );
+        samples_[next_sample_] = sample_pair{ best_source, best_wall };
+        next_sample_ = ( next_sample_ + 1 ) % samples_.size();
+        if ( sample_count_ < samples_.size() )
+        {
+            ++sample_count_;
+        }
+        last_sample_time_ = last_read;
+        fit( best_source, best_wall );
+    }
+
+    //! convert a source clock timestamp to wall clock time
+    wall_time_point to_wall( source_time_point t ) const
+    {
+        parameters p = current_parameters();
+        return p.convert( t );
+    }
+
+    //! convert a range of source clock timestamps to wall clock time
+    //! @param first  beginning of the source timestamp range
+    //! @param last   end of the source timestamp range
+    //! @param out    beginning of the destination range
+    //! @returns  end of the destination range
+    template< class InputIt, class OutputIt >
+    OutputIt to_wall( InputIt first, InputIt last, OutputIt out ) const
+    {
+        parameters p = current_parameters();
+        for ( ; first != last; ++first, ++out )
+        {
+            *out = p.convert( *first );
+        }
+        return out;
+    }
+
+    //! fitted wall clock ticks per source clock tick
+    double rate( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return rate_;
+    }
+
+    //! fitted drift of the wall clock relative to the source clock
+    //! @returns  drift in parts per million; positive when the wall clock runs fast
+    double drift_ppm( ) const
+    {
+        return ( rate() - 1.0 ) * 1e6;
+    }
+
+    //! largest distance of a sample in the window from the fitted line
+    std::chrono::nanoseconds residual( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return std::chrono::nanoseconds( residual_ );
+    }
+
+    //! number of samples in the fit window
+    std::size_t sample_count( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return sample_count_;
+    }
+
+private:
+    struct sample_pair
+    {
+        std::int64_t source;
+        std::int64_t wall;
+    };
+
+    struct parameters
+    {
+        std::int64_t base_source;
+        std::int64_t base_wall;
+        double base_correction;
+        double rate;
+
+        wall_time_point convert( source_time_point t ) const
+        {
+            double delta = static_cast<double>( to_ns( t.time_since_epoch() ) - base_source );
+            auto wall = base_wall + std::llround( base_correction + delta * rate );
+            return wall_time_point(
+                std::chrono::duration_cast<typename wall_time_point::duration>(
+                    std::chrono::nanoseconds( wall ) ) );
+        }
+    };
+
+    mutable std::mutex lock_;
+    const source_duration interval_;
+    std::vector<sample_pair> samples_;
+    std::size_t sample_count_;
+    std::size_t next_sample_;
+    source_time_point last_sample_time_;
+    std::int64_t base_source_;
+    std::int64_t base_wall_;
+    double base_correction_;
+    double rate_;
+    std::int64_t residual_;
+
+    template< class Rep, class Period >
+    static std::int64_t to_ns( std::chrono::duration<Rep, Period> d )
+    {
+        return static_cast<std::int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count() );
+    }
+
+    parameters current_parameters( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return parameters{ base_source_, base_wall_, base_correction_, rate_ };
+    }
+
+    //! least squares fit around the newest sample; caller holds `lock_`
+    void fit( std::int64_t newest_source, std::int64_t newest_wall )
+    {
+        double n = static_cast<double>( sample_count_ );
+        double mean_dx = 0.0;
+        double mean_dy = 0.0;
+        for ( std::size_t k = 0; k < sample_count_; ++k )
+        {
+            mean_dx += static_cast<double>( samples_[k].source - newest_source );
+            mean_dy += static_cast<double>( samples_[k].wall - newest_wall );
+        }
+        mean_dx /= n;
+        mean_dy /= n;
+
+        double sxx = 0.0;
+        double sxy = 0.0;
+        for ( std::size_t k = 0; k < sample_count_; ++k )
+        {
+            double dx = static_cast<double>( samples_[k].source - newest_source ) - mean_dx;
+            double dy = static_cast<double>( samples_[k].wall - newest_wall ) - mean_dy;
+            sxx += dx * dx;
+            sxy += dx * dy;
+        }
+        if ( sxx > 0.0 )
+        {
+            rate_ = sxy / sxx;
+        }
+
+        base_source_ = newest_source;
+        base_wall_ = newest_wall;
+        base_correction_ = mean_dy - rate_ * mean_dx;
+
+        double worst = 0.0;
+        for ( std::size_t k = 0; k < sample_count_; ++k )
+        {
+            double dx = static_cast<double>( samples_[k].source - newest_source );
+            double dy = static_cast<double>( samples_[k].wall - newest_wall );
+            double r = std::fabs( dy - ( base_correction_ + rate_ * dx ) );
+            if ( r > worst )
+            {
+                worst = r;
+            }
+        }
+        residual_ = static_cast<std::int64_t>( worst + 0.5 );
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+//
+//  deadline.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef deadline_h
+#define deadline_h
+
+#include <chrono>
+#include <cstdint>
+
+namespace uteki
+{
+
+//! deadline class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Point in time by which a piece of work must finish, passed down a
+//! call chain so each layer can ask how much time is left instead of
+//! recomputing it from a timer and a constant. A child deadline for a nested
+//! call is the earlier of the caller's deadline and a local budget. A default
+//! constructed deadline never expires. The class is a small value type; copy
+//! it freely between threads.
+//!
+//!  \snippet test_deadline.cpp child deadline example
+template< class ClockType = std::chrono::steady_clock >
+class deadline
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! scalar type for duration tick count
+    using rep = typename ClockType::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename ClockType::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! constructor, a deadline that never expires
+    deadline( )
+        : expiry_( time_point::max() )
+    {}
+
+    //! constructor
+    //! @param expiry  time at which the deadline expires
+    explicit deadline( time_point expiry )
+        : expiry_( expiry )
+    {}
+
+    //! a deadline that never expires
+    static deadline never( )
+    {
+        return deadline();
+    }
+
+    //! a deadline a budget from now
+    //! @param budget  time allowed from now; a budget past the clock's range never expires
+    template< class Rep, class Period >
+    static deadline from_now( std::chrono::duration<Rep, Period> budget )
+    {
+        return deadline().child( budget );
+    }
+
+    //! time at which the deadline expires
+    time_point expiry( ) const
+    {
+        return expiry_;
+    }
+
+    //! does the deadline never expire
+    bool is_never( ) const
+    {
+        return expiry_ == time_point::max();
+    }
+
+    //! time left before the deadline
+    //! @returns  time left, zero once expired, or `T::max()` if the deadline never expires
+    template< typename T = duration >
+    T remaining( ) const
+    {
+        if ( is_never() )
+        {
+            return T::max();
+        }
+        auto now = ClockType::now();
+        return ( now >= expiry_ ) ? T::zero() : std::chrono::duration_cast<T>( expiry_ - now );
+    }
+
+    //! has the deadline expired
+    bool expired( ) const
+    {
+        return ! is_never() && ClockType::now() >= expiry_;
+    }
+
+    //! had the deadline expired at a given time
+    //! @param now  time to compare with, usually a clock reading the caller already has
+    bool expired( time_point now ) const
+    {
+        return now >= expiry_;
+    }
+
+    //! deadline for a nested call with a local budget
+    //! @param budget  time allowed for the nested call from now
+    //! @returns  the earlier of this deadline and now plus `budget`
+    template< class Rep, class Period >
+    deadline child( std::chrono::duration<Rep, Period> budget ) const
+    {
+        auto now = ClockType::now();
+        if ( budget <= std::chrono::duration<Rep, Period>::zero() )
+        {
+            return earlier( now );
+        }
+        if ( std::chrono::duration_cast<std::chrono::duration<double, period>>( budget ).count() >=
+             static_cast<double>( ( time_point::max() - now ).count() ) )
+        {
+            return *this;
+        }
+        return earlier( now + std::chrono::duration_cast<duration>( budget ) );
+    }
+
+    //! deadline for a nested call that must also meet another deadline
+    //! @returns  the earlier of the two deadlines
+    deadline child( const deadline& other ) const
+    {
+        return earlier( other.expiry_ );
+    }
+
+private:
+    time_point expiry_;
+
+    deadline earlier( time_point t ) const
+    {
+        return deadline( ( t < expiry_ ) ? t : expiry_ );
+    }
+};
+
+//! deadline checker class
+//! @tparam ClockType  `std::chrono` clock type of the deadline
+//! @details Checks a deadline from a tight loop while reading the clock only
+//! once every N checks, so the clock read cost is amortized over N
+//! iterations. Expiry may be noticed up to N - 1 checks late. Once expired
+//! the checker stays expired. A checker is used by one thread.
+//!
+//!  \snippet test_deadline.cpp deadline_checker deadline example
+template< class ClockType = std::chrono::steady_clock >
+class deadline_checker
+{
+public:
+    //! constructor
+    //! @param limit           deadline to check
+    //! @param check_interval  number of checks per clock read, at least 1
+    explicit deadline_checker( const deadline<ClockType>& limit, std::uint32_t check_interval = 64 )
+        : limit_( limit )
+        , interval_( check_interval > 0 ? check_interval : 1 )
+        , countdown_( 1 )
+        , clock_reads_( 0 )
+        , expired_( false )
+    {}
+
+    //! has the deadline expired, reading the clock every `check_interval` calls
+    bool expired( )
+    {
+        if ( --countdown_ != 0 || expired_ )
+        {
+            return expired_;
+        }
+        countdown_ = interval_;
+        ++clock_reads_;
+        expired_ = limit_.expired();
+        return expired_;
+    }
+
+    //! deadline being checked
+    const deadline<ClockType>& limit( ) const
+    {
+        return limit_;
+    }
+
+    //! number of clock reads so far
+    std::uint64_t clock_reads( ) const
+    {
+        return clock_reads_;
+    }
+
+private:
+    deadline<ClockType> limit_;
+    const std::uint32_t interval_;
+    std::uint32_t countdown_;
+    std::uint64_t clock_reads_;
+    bool expired_;
+};
+
+}
+
+#endif
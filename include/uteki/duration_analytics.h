@@ -0,0 +1,662 @@
+//
+//  duration_analytics.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef duration_analytics_h
+#define duration_analytics_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define UTEKI_ANALYTICS_X86 1
+#include <immintrin.h>
+#elif defined( __aarch64__ ) && defined( __ARM_NEON )
+#define UTEKI_ANALYTICS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace uteki
+{
+
+//! instruction set used by the duration analytics kernels
+enum class simd_kernel
+{
+    //! portable loops
+    scalar,
+    //! x86 AVX2
+    avx2,
+    //! x86 AVX-512 Foundation
+    avx512,
+    //! ARM Advanced SIMD, AArch64 only
+    neon
+};
+
+//! summary statistics of a duration array
+//! @tparam Rep  tick count type of the durations
+template< class Rep >
+struct duration_summary
+{
+    //! number of values
+    std::size_t count;
+    //! smallest value
+    Rep min;
+    //! largest value
+    Rep max;
+    //! sum of the values
+    Rep sum;
+    //! arithmetic mean
+    double mean;
+    //! population variance
+    double variance;
+};
+
+namespace detail
+{
+
+// values whose range fits in a double mantissa are converted to double with
+// an integer or and a floating subtraction, which AVX2 and AVX-512F lack
+// an instruction for
+constexpr std::int64_t exact_double_range = std::int64_t( 1 ) << 52;
+constexpr std::uint64_t exact_double_bits = 0x4330000000000000ULL;
+
+template< class Rep >
+void summary_scalar( const Rep* data, std::size_t n, Rep& min, Rep& max, Rep& sum )
+{
+    Rep lo = data[0];
+    Rep hi = data[0];
+    Rep total = 0;
+    for ( std::size_t k = 0; k < n; ++k )
+    {
+        lo = std::min( lo, data[k] );
+        hi = std::max( hi, data[k] );
+        total += data[k];
+    }
+    min = lo;
+    max = hi;
+    sum = total;
+}
+
+template< class Rep >
+double squared_deviation_scalar( const Rep* data, std::size_t n, double mean )
+{
+    double total = 0.0;
+    for ( std::size_t k = 0; k < n; ++k )
+    {
+        double deviation = static_cast<double>( data[k] ) - mean;
+        total += deviation * deviation;
+    }
+    return total;
+}
+
+template< class Rep >
+std::size_t count_above_scalar( const Rep* data, std::size_t n, Rep threshold )
+{
+    std::size_t count = 0;
+    for ( std::size_t k = 0; k < n; ++k )
+    {
+        count += ( data[k] > threshold ) ? 1 : 0;
+    }
+    return count;
+}
+
+#if defined( UTEKI_ANALYTICS_X86 )
+
+__attribute__(( target( "avx2" ) ))
+inline void summary_avx2( const std::int64_t* data, std::size_t n, std::int64_t& min, std::int64_t& max, std::int64_t& sum )
+{
+    std::size_t k = 0;
+    std::int64_t lo = data[0];
+    std::int64_t hi = data[0];
+    std::int64_t total = 0;
+    if ( n >= 4 )
+    {
+        __m256i vmin = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+        __m256i vmax = vmin;
+        __m256i vsum = _mm256_setzero_si256();
+        for ( ; k + 4 <= n; k += 4 )
+        {
+            __m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + k ) );
+            vmin = _mm256_blendv_epi8( vmin, x, _mm256_cmpgt_epi64( vmin, x ) );
+            vmax = _mm256_blendv_epi8( vmax, x, _mm256_cmpgt_epi64( x, vmax ) );
+            vsum = _mm256_add_epi64( vsum, x );
+        }
+        alignas( 32 ) std::int64_t lanes[3][4];
+        _mm256_store_si256( reinterpret_cast<__m256i*>( lanes[0] ), vmin );
+        _mm256_store_si256( reinterpret_cast<__m256i*>( lanes[1] ), vmax );
+        _mm256_store_si256( reinterpret_cast<__m256i*>( lanes[2] ), vsum );
+        for ( int l = 0; l < 4; ++l )
+        {
+            lo = std::min( lo, lanes[0][l] );
+            hi = std::max( hi, lanes[1][l] );
+            total += lanes[2][l];
+        }
+    }
+    for ( ; k < n; ++k )
+    {
+        lo = std::min( lo, data[k] );
+        hi = std::max( hi, data[k] );
+        total += data[k];
+    }
+    min = lo;
+    max = hi;
+    sum = total;
+}
+
+__attribute__(( target( "avx2" ) ))
+inline double squared_deviation_avx2( const std::int64_t* data, std::size_t n, std::int64_t offset, double mean )
+{
+    std::size_t k = 0;
+    double total = 0.0;
+    if ( n >= 4 )
+    {
+        const __m256i voffset = _mm256_set1_epi64x( offset );
+        const __m256i vbits = _mm256_set1_epi64x( static_cast<long long>( exact_double_bits ) );
+        const __m256d vbias = _mm256_set1_pd( static_cast<double>( exact_double_range ) );
+        const __m256d vmean = _mm256_set1_pd( mean - static_cast<double>( offset ) );
+        __m256d vtotal = _mm256_setzero_pd();
+        for ( ; k + 4 <= n; k += 4 )
+        {
+            __m256i x = _mm256_sub_epi64( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + k ) ), voffset );
+            __m256d value = _mm256_sub_pd( _mm256_castsi256_pd( _mm256_or_si256( x, vbits ) ), vbias );
+            __m256d deviation = _mm256_sub_pd( value, vmean );
+            vtotal = _mm256_add_pd( vtotal, _mm256_mul_pd( deviation, deviation ) );
+        }
+        alignas( 32 ) double lanes[4];
+        _mm256_store_pd( lanes, vtotal );
+        total = ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+    }
+    return total + squared_deviation_scalar( data + k, n - k, mean );
+}
+
+__attribute__(( target( "avx2" ) ))
+inline std::size_t count_above_avx2( const std::int64_t* data, std::size_t n, std::int64_t threshold )
+{
+    std::size_t k = 0;
+    std::size_t count = 0;
+    if ( n >= 4 )
+    {
+        const __m256i vthreshold = _mm256_set1_epi64x( threshold );
+        __m256i vcount = _mm256_setzero_si256();
+        for ( ; k + 4 <= n; k += 4 )
+        {
+            __m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + k ) );
+            // a true comparison is all ones, that is minus one
+            vcount = _mm256_sub_epi64( vcount, _mm256_cmpgt_epi64( x, vthreshold ) );
+        }
+        alignas( 32 ) std::int64_t lanes[4];
+        _mm256_store_si256( reinterpret_cast<__m256i*>( lanes ), vcount );
+        count = static_cast<std::size_t>( lanes[0] + lanes[1] + lanes[2] + lanes[3] );
+    }
+    return count + count_above_scalar( data + k, n - k, threshold );
+}
+
+__attribute__(( target( "avx512f" ) ))
+inline void summary_avx512( const std::int64_t* data, std::size_t n, std::int64_t& min, std::int64_t& max, std::int64_t& sum )
+{
+    std::size_t k = 0;
+    std::int64_t lo = data[0];
+    std::int64_t hi = data[0];
+    std::int64_t total = 0;
+    if ( n >= 8 )
+    {
+        __m512i vmin = _mm512_loadu_si512( data );
+        __m512i vmax = vmin;
+        __m512i vsum = _mm512_setzero_si512();
+        for ( ; k + 8 <= n; k += 8 )
+        {
+            __m512i x = _mm512_loadu_si512( data + k );
+            vmin = _mm512_mask_mov_epi64( vmin, _mm512_cmpgt_epi64_mask( vmin, x ), x );
+            vmax = _mm512_mask_mov_epi64( vmax, _mm512_cmpgt_epi64_mask( x, vmax ), x );
+            vsum = _mm512_add_epi64( vsum, x );
+        }
+        alignas( 64 ) std::int64_t lanes[3][8];
+        _mm512_store_si512( lanes[0], vmin );
+        _mm512_store_si512( lanes[1], vmax );
+        _mm512_store_si512( lanes[2], vsum );
+        for ( int l = 0; l < 8; ++l )
+        {
+            lo = std::min( lo, lanes[0][l] );
+            hi = std::max( hi, lanes[1][l] );
+            total += lanes[2][l];
+        }
+    }
+    for ( ; k < n; ++k )
+    {
+        lo = std::min( lo, data[k] );
+        hi = std::max( hi, data[k] );
+        total += data[k];
+    }
+    min = lo;
+    max = hi;
+    sum = total;
+}
+
+__attribute__(( target( "avx512f" ) ))
+inline double squared_deviation_avx512( const std::int64_t* data, std::size_t n, std::int64_t offset, double mean )
+{
+    std::size_t k = 0;
+    double total = 0.0;
+    if ( n >= 8 )
+    {
+        const __m512i voffset = _mm512_set1_epi64( offset );
+        const __m512i vbits = _mm512_set1_epi64( static_cast<long long>( exact_double_bits ) );
+        const __m512d vbias = _mm512_set1_pd( static_cast<double>( exact_double_range ) );
+        const __m512d vmean = _mm512_set1_pd( mean - static_cast<double>( offset ) );
+        __m512d vtotal = _mm512_setzero_pd();
+        for ( ; k + 8 <= n; k += 8 )
+        {
+            __m512i x = _mm512_sub_epi64( _mm512_loadu_si512( data + k ), voffset );
+            __m512d value = _mm512_sub_pd( _mm512_castsi512_pd( _mm512_or_si512( x, vbits ) ), vbias );
+            __m512d deviation = _mm512_sub_pd( value, vmean );
+            vtotal = _mm512_add_pd( vtotal, _mm512_mul_pd( deviation, deviation ) );
+        }
+        alignas( 64 ) double lanes[8];
+        _mm512_store_pd( lanes, vtotal );
+        total = ( ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] ) ) + ( ( lanes[4] + lanes[5] ) + ( lanes[6] + lanes[7] ) );
+    }
+    return total + squared_deviation_scalar( data + k, n - k, mean );
+}
+
+__attribute__(( target( "avx512f" ) ))
+inline std::size_t count_above_avx512( const std::int64_t* data, std::size_t n, std::int64_t threshold )
+{
+    std::size_t k = 0;
+    std::size_t count = 0;
+    const __m512i vthreshold = _mm512_set1_epi64( threshold );
+    for ( ; k + 8 <= n; k += 8 )
+    {
+        __mmask8 above = _mm512_cmpgt_epi64_mask( _mm512_loadu_si512( data + k ), vthreshold );
+        count += static_cast<std::size_t>( __builtin_popcount( above ) );
+    }
+    return count + count_above_scalar( data + k, n - k, threshold );
+}
+
+#endif
+
+#if defined( UTEKI_ANALYTICS_NEON )
+
+inline void summary_neon( const std::int64_t* data, std::size_t n, std::int64_t& min, std::int64_t& max, std::int64_t& sum )
+{
+    std::size_t k = 0;
+    std::int64_t lo = data[0];
+    std::int64_t hi = data[0];
+    std::int64_t total = 0;
+    if ( n >= 2 )
+    {
+        int64x2_t vmin = vld1q_s64( data );
+        int64x2_t vmax = vmin;
+        int64x2_t vsum = vdupq_n_s64( 0 );
+        for ( ; k + 2 <= n; k += 2 )
+        {
+            int64x2_t x = vld1q_s64( data + k );
+            vmin = vbslq_s64( vcgtq_s64( vmin, x ), x, vmin );
+            vmax = vbslq_s64( vcgtq_s64( x, vmax ), x, vmax );
+            vsum = vaddq_s64( vsum, x );
+        }
+        lo = std::min( vgetq_lane_s64( vmin, 0 ), vgetq_lane_s64( vmin, 1 ) );
+        hi = std::max( vgetq_lane_s64( vmax, 0 ), vgetq_lane_s64( vmax, 1 ) );
+        total = vaddvq_s64( vsum );
+    }
+    for ( ; k < n; ++k )
+    {
+        lo = std::min( lo, data[k] );
+        hi = std::max( hi, data[k] );
+        total += data[k];
+    }
+    min = lo;
+    max = hi;
+    sum = total;
+}
+
+inline double squared_deviation_neon( const std::int64_t* data, std::size_t n, std::int64_t offset, double mean )
+{
+    std::size_t k = 0;
+    double total = 0.0;
+    if ( n >= 2 )
+    {
+        const int64x2_t voffset = vdupq_n_s64( offset );
+        const float64x2_t vmean = vdupq_n_f64( mean - static_cast<double>( offset ) );
+        float64x2_t vtotal = vdupq_n_f64( 0.0 );
+        for ( ; k + 2 <= n; k += 2 )
+        {
+            float64x2_t value = vcvtq_f64_s64( vsubq_s64( vld1q_s64( data + k ), voffset ) );
+            float64x2_t deviation = vsubq_f64( value, vmean );
+            vtotal = vaddq_f64( vtotal, vmulq_f64( deviation, deviation ) );
+        }
+        total = vaddvq_f64( vtotal );
+    }
+    return total + squared_deviation_scalar( data + k, n - k, mean );
+}
+
+inline std::size_t count_above_neon( const std::int64_t* data, std::size_t n, std::int64_t threshold )
+{
+    std::size_t k = 0;
+    const int64x2_t vthreshold = vdupq_n_s64( threshold );
+    int64x2_t vcount = vdupq_n_s64( 0 );
+    for ( ; k + 2 <= n; k += 2 )
+    {
+        uint64x2_t above = vcgtq_s64( vld1q_s64( data + k ), vthreshold );
+        vcount = vsubq_s64( vcount, vreinterpretq_s64_u64( above ) );
+    }
+    return static_cast<std::size_t>( vaddvq_s64( vcount ) ) + count_above_scalar( data + k, n - k, threshold );
+}
+
+#endif
+
+inline simd_kernel detect_simd_kernel( )
+{
+#if defined( UTEKI_ANALYTICS_X86 )
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx512f" ) )
+    {
+        return simd_kernel::avx512;
+    }
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        return simd_kernel::avx2;
+    }
+    return simd_kernel::scalar;
+#elif defined( UTEKI_ANALYTICS_NEON )
+    return simd_kernel::neon;
+#else
+    return simd_kernel::scalar;
+#endif
+}
+
+template< class Rep >
+using int64_rep = std::is_same< Rep, std::int64_t >;
+
+}
+
+//! fastest kernel supported by the running CPU
+//! @details Detected once, on first use.
+inline simd_kernel detected_simd_kernel( )
+{
+    static const simd_kernel kernel = detail::detect_simd_kernel();
+    return kernel;
+}
+
+//! can a kernel run on this CPU and build
+inline bool simd_kernel_supported( simd_kernel kernel )
+{
+    simd_kernel best = detected_simd_kernel();
+    switch ( kernel )
+    {
+    case simd_kernel::scalar:
+        return true;
+    case simd_kernel::avx2:
+        return best == simd_kernel::avx2 || best == simd_kernel::avx512;
+    case simd_kernel::avx512:
+        return best == simd_kernel::avx512;
+    case simd_kernel::neon:
+        return best == simd_kernel::neon;
+    }
+    return false;
+}
+
+//! summary statistics of a duration array
+//! @param data    tick counts, as returned by `duration::count()`
+//! @param n       number of values
+//! @param kernel  kernel to use; the scalar loops are used if it is not supported
+//! @details Two passes over the data: minimum, maximum and sum, then the sum
+//! of squared deviations from the mean. With `std::int64_t` tick counts, the
+//! representation of the standard clocks, both passes use the vector kernel;
+//! the second only when the value range is below 2^52, which holds for any
+//! captured latencies. Other representations use the scalar loops. The sum
+//! must not overflow `Rep`.
+//! @returns  the summary, all zero for an empty array
+//!
+//!  \snippet test_duration_analytics.cpp summarize duration_analytics example
+template< class Rep >
+duration_summary<Rep> summarize_durations( const Rep* data, std::size_t n,
+                                           simd_kernel kernel = detected_simd_kernel() )
+{
+    duration_summary<Rep> summary{ 0, 0, 0, 0, 0.0, 0.0 };
+    if ( n == 0 )
+    {
+        return summary;
+    }
+    if ( ! simd_kernel_supported( kernel ) || ! detail::int64_rep<Rep>::value )
+    {
+        kernel = simd_kernel::scalar;
+    }
+    summary.count = n;
+
+    const std::int64_t* values = reinterpret_cast<const std::int64_t*>( data );
+    std::int64_t min = 0;
+    std::int64_t max = 0;
+    std::int64_t sum = 0;
+    switch ( kernel )
+    {
+#if defined( UTEKI_ANALYTICS_X86 )
+    case simd_kernel::avx2:
+        detail::summary_avx2( values, n, min, max, sum );
+        break;
+    case simd_kernel::avx512:
+        detail::summary_avx512( values, n, min, max, sum );
+        break;
+#endif
+#if defined( UTEKI_ANALYTICS_NEON )
+    case simd_kernel::neon:
+        detail::summary_neon( values, n, min, max, sum );
+        break;
+#endif
+    default:
+        break;
+    }
+    if ( kernel == simd_kernel::scalar )
+    {
+        detail::summary_scalar( data, n, summary.min, summary.max, summary.sum );
+    }
+    else
+    {
+        summary.min = static_cast<Rep>( min );
+        summary.max = static_cast<Rep>( max );
+        summary.sum = static_cast<Rep>( sum );
+    }
+    summary.mean = static_cast<double>( summary.sum ) / static_cast<double>( n );
+
+    double range = static_cast<double>( summary.max ) - static_cast<double>( summary.min );
+    if ( range >= static_cast<double>( detail::exact_double_range ) )
+    {
+        kernel = simd_kernel::scalar;
+    }
+    double squares = 0.0;
+    std::int64_t offset = static_cast<std::int64_t>( summary.min );
+    switch ( kernel )
+    {
+#if defined( UTEKI_ANALYTICS_X86 )
+    case simd_kernel::avx2:
+        squares = detail::squared_deviation_avx2( values, n, offset, summary.mean );
+        break;
+    case simd_kernel::avx512:
+        squares = detail::squared_deviation_avx512( values, n, offset, summary.mean );
+        break;
+#endif
+#if defined( UTEKI_ANALYTICS_NEON )
+    case simd_kernel::neon:
+        squares = detail::squared_deviation_neon( values, n, offset, summary.mean );
+        break;
+#endif
+    default:
+        squares = detail::squared_deviation_scalar( data, n, summary.mean );
+        break;
+    }
+    summary.variance = squares / static_cast<double>( n );
+    return summary;
+}
+
+//! number of durations above a threshold
+//! @param data       tick counts
+//! @param n          number of values
+//! @param threshold  tick count the values are compared with
+//! @param kernel     kernel to use; the scalar loop is used if it is not supported
+//! @returns  number of values strictly greater than `threshold`
+template< class Rep >
+std::size_t count_above( const Rep* data, std::size_t n, Rep threshold,
+                         simd_kernel kernel = detected_simd_kernel() )
+{
+    if ( ! simd_kernel_supported( kernel ) || ! detail::int64_rep<Rep>::value )
+    {
+        kernel = simd_kernel::scalar;
+    }
+    const std::int64_t* values = reinterpret_cast<const std::int64_t*>( data );
+    const std::int64_t limit = static_cast<std::int64_t>( threshold );
+    switch ( kernel )
+    {
+#if defined( UTEKI_ANALYTICS_X86 )
+    case simd_kernel::avx2:
+        return detail::count_above_avx2( values, n, limit );
+    case simd_kernel::avx512:
+        return detail::count_above_avx512( values, n, limit );
+#endif
+#if defined( UTEKI_ANALYTICS_NEON )
+    case simd_kernel::neon:
+        return detail::count_above_neon( values, n, limit );
+#endif
+    default:
+        return detail::count_above_scalar( data, n, threshold );
+    }
+}
+
+//! count durations into equal-width bins
+//! @param data    tick counts
+//! @param n       number of values
+//! @param low     lower edge of the first bin
+//! @param width   width of each bin, in ticks; must be positive
+//! @param counts  bin counts, incremented; values below `low` are counted in
+//!  the first bin and values past the last bin in the last bin
+//! @param bins    number of bins
+//! @details The bin index is computed with a multiplication by the reciprocal
+//! width and an exact correction instead of a division, and increments go to
+//! four interleaved count arrays so that runs of equal values do not
+//! serialise on one counter.
+template< class Rep >
+void bin_durations( const Rep* data, std::size_t n, Rep low, Rep width,
+                    std::uint64_t* counts, std::size_t bins )
+{
+    if ( bins == 0 || width <= 0 )
+    {
+        return;
+    }
+    const double reciprocal = 1.0 / static_cast<double>( width );
+    const double last = static_cast<double>( bins - 1 );
+    auto bin_of = [=]( Rep value ) -> std::size_t {
+        double offset = static_cast<double>( value ) - static_cast<double>( low );
+        if ( offset <= 0.0 )
+        {
+            return 0;
+        }
+        double estimate = std::floor( offset * reciprocal );
+        if ( estimate >= last )
+        {
+            return bins - 1;
+        }
+        // the reciprocal can be off by one at bin edges
+        std::size_t bin = static_cast<std::size_t>( estimate );
+        Rep edge = static_cast<Rep>( low + static_cast<Rep>( bin ) * width );
+        if ( value < edge )
+        {
+            --bin;
+        }
+        else if ( value - edge >= width && bin + 1 < bins )
+        {
+            ++bin;
+        }
+        return bin;
+    };
+
+    std::vector<std::uint64_t> lanes( 4 * bins, 0 );
+    std::size_t k = 0;
+    for ( ; k + 4 <= n; k += 4 )
+    {
+        ++lanes[ bin_of( data[k] ) ];
+        ++lanes[ bins + bin_of( data[k + 1] ) ];
+        ++lanes[ 2 * bins + bin_of( data[k + 2] ) ];
+        ++lanes[ 3 * bins + bin_of( data[k + 3] ) ];
+    }
+    for ( ; k < n; ++k )
+    {
+        ++lanes[ bin_of( data[k] ) ];
+    }
+    for ( std::size_t b = 0; b < bins; ++b )
+    {
+        counts[b] += lanes[b] + lanes[bins + b] + lanes[2 * bins + b] + lanes[3 * bins + b];
+    }
+}
+
+//! percentiles of a duration array by selection
+//! @param data      tick counts; taken by value since selection reorders them
+//! @param percents  percentiles in the range [0, 100], in any order
+//! @details Uses the nearest-rank definition. The percentiles are selected in
+//! ascending order with `std::nth_element`, each on the part of the array
+//! above the previous one, which is linear on average instead of the
+//! `n log n` of sorting.
+//! @returns  one value per requested percentile, in the order requested;
+//!  empty if `data` is empty
+//!
+//!  \snippet test_duration_analytics.cpp percentiles duration_analytics example
+template< class Rep >
+std::vector<Rep> duration_percentiles( std::vector<Rep> data, const std::vector<double>& percents )
+{
+    std::vector<Rep> result;
+    if ( data.empty() )
+    {
+        return result;
+    }
+    std::vector< std::pair<std::size_t, std::size_t> > ranks;
+    ranks.reserve( percents.size() );
+    for ( std::size_t k = 0; k < percents.size(); ++k )
+    {
+        double p = std::min( std::max( percents[k], 0.0 ), 100.0 );
+        double rank = std::ceil( p / 100.0 * static_cast<double>( data.size() ) );
+        std::size_t index = ( rank < 1.0 ) ? 0 : static_cast<std::size_t>( rank ) - 1;
+        ranks.emplace_back( std::min( index, data.size() - 1 ), k );
+    }
+    std::sort( ranks.begin(), ranks.end() );
+
+    result.resize( percents.size() );
+    auto first = data.begin();
+    for ( const auto& r : ranks )
+    {
+        auto nth = data.begin() + static_cast<std::ptrdiff_t>( r.first );
+        if ( nth >= first )
+        {
+            std::nth_element( first, nth, data.end() );
+            first = nth + 1;
+        }
+        result[r.second] = *nth;
+    }
+    return result;
+}
+
+}
+
+#endif
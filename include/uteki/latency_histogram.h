@@ -0,0 +1,352 @@
+//
+//  latency_histogram.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef latency_histogram_h
+#define latency_histogram_h
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace uteki
+{
+
+//! latency histogram
+//! @tparam Duration  `std::chrono::duration` type of recorded values. The
+//! duration's tick count type must be an integral type.
+//! @details Log-linear histogram of non-negative durations. Values below 16
+//! ticks each have their own bucket; every power of two above that is split
+//! into 16 linear sub-buckets, so the bucket width is never more than 1/16 of
+//! the recorded value. Recording is lock-free and thread-safe. Negative
+//! durations are recorded as zero.
+template< class Duration = std::chrono::nanoseconds >
+class latency_histogram
+{
+    static_assert( std::is_integral< typename Duration::rep >::value,
+                   "duration must have an integral tick count type" );
+
+public:
+    //! `std::chrono::duration` type of recorded values
+    using duration = Duration;
+    //! scalar type for duration tick count
+    using rep = typename Duration::rep;
+
+    //! number of linear sub-buckets in each power of two range, as a power of two
+    static constexpr unsigned sub_bucket_bits = 4;
+    //! number of linear sub-buckets in each power of two range
+    static constexpr std::size_t sub_bucket_count = std::size_t( 1 ) << sub_bucket_bits;
+    //! total number of buckets
+    static constexpr std::size_t bucket_count =
+        ( std::numeric_limits<rep>::digits + 1 - sub_bucket_bits ) * sub_bucket_count;
+
+    //! constructor
+    latency_histogram( )
+        : counts_( )
+        , total_count_( 0 )
+        , total_( 0 )
+        , min_( std::numeric_limits<std::uint64_t>::max() )
+        , max_( 0 )
+    {
+        for ( auto& c : counts_ )
+        {
+            c.store( 0, std::memory_order_relaxed );
+        }
+    }
+
+    latency_histogram( const latency_histogram& ) = delete;
+    latency_histogram& operator=( const latency_histogram& ) = delete;
+
+    ~latency_histogram( ) = default;
+
+    //! record a duration
+    //! @param value  duration to record
+    //! @param count  number of occurrences of `value` to record
+    template< class Rep, class Period >
+    void record( std::chrono::duration<Rep, Period> value, std::uint64_t count = 1 )
+    {
+        record_ticks( to_ticks( value ), count );
+    }
+
+    //! record a duration, correcting for coordinated omission
+    //! @param value              duration to record
+    //! @param expected_interval  interval at which measurements were meant to be taken
+    //! @details When a measuring loop is stalled by the operation it measures,
+    //!  the measurements it would have taken during the stall are missing and
+    //!  the histogram under-reports the tail. Besides `value` this records the
+    //!  values those missed measurements would have seen, `value - interval`,
+    //!  `value - 2 * interval` and so on, down to `expected_interval`. Does the
+    //!  same as `record()` if `expected_interval` is not positive.
+    template< class Rep1, class Period1, class Rep2, class Period2 >
+    void record_corrected( std::chrono::duration<Rep1, Period1> value,
+                           std::chrono::duration<Rep2, Period2> expected_interval )
+    {
+        std::uint64_t ticks = to_ticks( value );
+        std::uint64_t interval = to_ticks( expected_interval );
+        record_ticks( ticks, 1 );
+        if ( interval == 0 || ticks <= interval )
+        {
+            return;
+        }
+        for ( std::uint64_t missing = ticks - interval; missing >= interval; missing -= interval )
+        {
+            record_ticks( missing, 1 );
+        }
+    }
+
+    //! number of recorded values
+    std::uint64_t count( ) const
+    {
+        return total_count_.load( std::memory_order_relaxed );
+    }
+
+    //! sum of recorded values
+    duration sum( ) const
+    {
+        return duration( static_cast<rep>( total_.load( std::memory_order_relaxed ) ) );
+    }
+
+    //! smallest recorded value
+    //! @returns  smallest recorded value, or zero if nothing was recorded
+    duration min( ) const
+    {
+        auto v = min_.load( std::memory_order_relaxed );
+        return ( v == std::numeric_limits<std::uint64_t>::max() )
+            ? duration::zero() : duration( static_cast<rep>( v ) );
+    }
+
+    //! largest recorded value
+    duration max( ) const
+    {
+        return duration( static_cast<rep>( max_.load( std::memory_order_relaxed ) ) );
+    }
+
+    //! mean of recorded values
+    //! @returns  arithmetic mean, or zero if nothing was recorded
+    template< typename T = std::chrono::duration<double, typename duration::period> >
+    T mean( ) const
+    {
+        auto n = count();
+        if ( n == 0 )
+        {
+            return T::zero();
+        }
+        using fp_duration = std::chrono::duration<double, typename duration::period>;
+        return std::chrono::duration_cast<T>(
+            fp_duration( static_cast<double>( total_.load( std::memory_order_relaxed ) ) / n ) );
+    }
+
+    //! value at percentile
+    //! @param percent  percentile in the range [0, 100]
+    //! @returns  highest value equivalent to the bucket holding the requested
+    //!  percentile, clamped to the recorded maximum. Returns zero if nothing was
+    //!  recorded.
+    duration percentile( double percent ) const
+    {
+        std::uint64_t n = count();
+        if ( n == 0 )
+        {
+            return duration::zero();
+        }
+        if ( percent <= 0.0 )
+        {
+            return min();
+        }
+        double fraction = ( percent >= 100.0 ) ? 1.0 : percent / 100.0;
+        auto rank = static_cast<std::uint64_t>( fraction * static_cast<double>( n ) + 0.5 );
+        if ( rank == 0 )
+        {
+            rank = 1;
+        }
+
+        std::uint64_t cumulative = 0;
+        for ( std::size_t k = 0; k < bucket_count; ++k )
+        {
+            cumulative += counts_[k].load( std::memory_order_relaxed );
+            if ( cumulative >= rank )
+            {
+                auto highest = bucket_upper_bound( k ) - 1;
+                auto largest = max_.load( std::memory_order_relaxed );
+                return duration( static_cast<rep>( highest < largest ? highest : largest ) );
+            }
+        }
+        return max();
+    }
+
+    //! number of values recorded in a bucket
+    //! @param index  bucket index, less than `bucket_count`
+    std::uint64_t bucket_value( std::size_t index ) const
+    {
+        return counts_[index].load( std::memory_order_relaxed );
+    }
+
+    //! bucket index for a duration
+    template< class Rep, class Period >
+    static std::size_t bucket_index( std::chrono::duration<Rep, Period> value )
+    {
+        return index_of( to_ticks( value ) );
+    }
+
+    //! smallest duration counted in a bucket
+    static duration bucket_lower_bound( std::size_t index )
+    {
+        return duration( static_cast<rep>( lower_bound_of( index ) ) );
+    }
+
+    //! add all values recorded in another histogram to this histogram
+    void merge( const latency_histogram& other )
+    {
+        for ( std::size_t k = 0; k < bucket_count; ++k )
+        {
+            auto c = other.counts_[k].load( std::memory_order_relaxed );
+            if ( c != 0 )
+            {
+                counts_[k].fetch_add( c, std::memory_order_relaxed );
+            }
+        }
+        total_count_.fetch_add( other.total_count_.load( std::memory_order_relaxed ),
+                                std::memory_order_relaxed );
+        total_.fetch_add( other.total_.load( std::memory_order_relaxed ),
+                          std::memory_order_relaxed );
+        update_min( other.min_.load( std::memory_order_relaxed ) );
+        update_max( other.max_.load( std::memory_order_relaxed ) );
+    }
+
+    //! discard all recorded values
+    void reset( )
+    {
+        for ( auto& c : counts_ )
+        {
+            c.store( 0, std::memory_order_relaxed );
+        }
+        total_count_.store( 0, std::memory_order_relaxed );
+        total_.store( 0, std::memory_order_relaxed );
+        min_.store( std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed );
+        max_.store( 0, std::memory_order_relaxed );
+    }
+
+private:
+    std::array< std::atomic<std::uint64_t>, bucket_count > counts_;
+    std::atomic<std::uint64_t> total_count_;
+    std::atomic<std::uint64_t> total_;
+    std::atomic<std::uint64_t> min_;
+    std::atomic<std::uint64_t> max_;
+
+    template< class Rep, class Period >
+    static std::uint64_t to_ticks( std::chrono::duration<Rep, Period> value )
+    {
+        auto ticks = std::chrono::duration_cast<duration>( value ).count();
+        return ( ticks > 0 ) ? static_cast<std::uint64_t>( ticks ) : 0;
+    }
+
+    void record_ticks( std::uint64_t ticks, std::uint64_t count )
+    {
+        if ( count == 0 )
+        {
+            return;
+        }
+        counts_[ index_of( ticks ) ].fetch_add( count, std::memory_order_relaxed );
+        total_count_.fetch_add( count, std::memory_order_relaxed );
+        total_.fetch_add( ticks * count, std::memory_order_relaxed );
+        update_min( ticks );
+        update_max( ticks );
+    }
+
+    void update_min( std::uint64_t ticks )
+    {
+        auto current = min_.load( std::memory_order_relaxed );
+        while ( ticks < current &&
+                ! min_.compare_exchange_weak( current, ticks, std::memory_order_relaxed ) )
+        {
+        }
+    }
+
+    void update_max( std::uint64_t ticks )
+    {
+        auto current = max_.load( std::memory_order_relaxed );
+        while ( ticks > current &&
+                ! max_.compare_exchange_weak( current, ticks, std::memory_order_relaxed ) )
+        {
+        }
+    }
+
+    static unsigned most_significant_bit( std::uint64_t v )
+    {
+#if defined( __GNUC__ ) || defined( __clang__ )
+        return 63u - static_cast<unsigned>( __builtin_clzll( v ) );
+#else
+        unsigned msb = 0;
+        while ( v >>= 1 )
+        {
+            ++msb;
+        }
+        return msb;
+#endif
+    }
+
+    static std::size_t index_of( std::uint64_t ticks )
+    {
+        if ( ticks < sub_bucket_count )
+        {
+            return static_cast<std::size_t>( ticks );
+        }
+        unsigned shift = most_significant_bit( ticks ) - sub_bucket_bits;
+        return ( shift + 1 ) * sub_bucket_count +
+            static_cast<std::size_t>( ( ticks >> shift ) - sub_bucket_count );
+    }
+
+    static std::uint64_t lower_bound_of( std::size_t index )
+    {
+        if ( index < sub_bucket_count )
+        {
+            return index;
+        }
+        std::size_t shift = index / sub_bucket_count - 1;
+        std::uint64_t sub = index % sub_bucket_count + sub_bucket_count;
+        return sub << shift;
+    }
+
+    static std::uint64_t bucket_upper_bound( std::size_t index )
+    {
+        std::size_t shift = ( index < sub_bucket_count ) ? 0 : index / sub_bucket_count - 1;
+        std::uint64_t lower = lower_bound_of( index );
+        std::uint64_t width = std::uint64_t( 1 ) << shift;
+        return ( lower > std::numeric_limits<std::uint64_t>::max() - width )
+            ? std::numeric_limits<std::uint64_t>::max() : lower + width;
+    }
+};
+
+template< class Duration >
+constexpr unsigned latency_histogram<Duration>::sub_bucket_bits;
+template< class Duration >
+constexpr std::size_t latency_histogram<Duration>::sub_bucket_count;
+template< class Duration >
+constexpr std::size_t latency_histogram<Duration>::bucket_count;
+
+}
+
+#endif
@@ -0,0 +1,335 @@
+//
+//  load_generator.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef load_generator_h
+#define load_generator_h
+
+#include "uteki/latency_histogram.h"
+#include "uteki/loop_pacer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+namespace uteki
+{
+
+//! schedule of intended send times
+enum class arrival_process
+{
+    //! one request every interval
+    constant,
+    //! exponentially distributed gaps with the interval as mean
+    poisson
+};
+
+namespace detail
+{
+
+// a request that takes a time point is passed its intended send time
+template< class Request, class TimePoint >
+auto invoke_request( Request& request, TimePoint intended, int ) -> decltype( request( intended ), void() )
+{
+    request( intended );
+}
+
+template< class Request, class TimePoint >
+void invoke_request( Request& request, TimePoint, long )
+{
+    request();
+}
+
+}
+
+//! load generator class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Issues requests on an intended schedule fixed in advance, at
+//! absolute times like `loop_pacer`, and measures each request's latency from
+//! its intended send time rather than from when it was actually sent. A
+//! closed loop that times each call hides queueing: when one call stalls,
+//! the calls that should have been sent meanwhile are sent late and timed
+//! from their late start, so the stall is counted once. Timing from the
+//! intended send time charges that wait to every delayed request, as an open
+//! loop client would see it.
+//!
+//! Three histograms are kept: `latency()` from the intended send time,
+//! `service_time()` from the actual send time as a closed loop measures it,
+//! and `corrected_service_time()`, the service time recorded with
+//! `latency_histogram::record_corrected()` for comparison with tools that
+//! correct afterwards. Requests are issued by the calling thread, one at a
+//! time; statistics may be read from any thread.
+//!
+//!  \snippet test_load_generator.cpp run load_generator example
+template< class ClockType = std::chrono::steady_clock >
+class load_generator
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+    //! histogram type of the measured latencies
+    using histogram = latency_histogram<std::chrono::nanoseconds>;
+
+    //! constructor
+    //! @param interval    time between intended sends, or its mean for a Poisson
+    //!  process; a non-positive interval is taken as one clock tick
+    //! @param process     schedule of intended sends
+    //! @param seed        seed of the Poisson gap generator, for reproducible schedules
+    //! @param spin_slice  final part of each wait spent spinning instead of sleeping
+    template< class Rep1, class Period1, class Rep2 = std::int64_t, class Period2 = std::micro >
+    explicit load_generator( std::chrono::duration<Rep1, Period1> interval,
+                             arrival_process process = arrival_process::constant,
+                             std::uint64_t seed = 0x5eed,
+                             std::chrono::duration<Rep2, Period2> spin_slice = std::chrono::microseconds( 100 ) )
+        : interval_( at_least_one_tick( std::chrono::duration_cast<duration>( interval ) ) )
+        , spin_slice_( std::chrono::duration_cast<duration>( spin_slice ) )
+        , process_( process )
+        , random_( seed )
+        , gaps_( 1.0 / static_cast<double>( interval_.count() ) )
+        , latency_( )
+        , service_time_( )
+        , corrected_service_time_( )
+        , late_sends_( 0 )
+        , max_send_lag_( 0 )
+    {}
+
+    load_generator( const load_generator& ) = delete;
+    load_generator& operator=( const load_generator& ) = delete;
+
+    ~load_generator( ) = default;
+
+    //! issue a number of requests
+    //! @param request  callable invoked as `request()` for each request, or as
+    //!  `request( intended )` with the intended send time if it accepts one;
+    //!  it returns when the request completed
+    //! @param count    number of requests
+    //! @details the first request is due at once
+    template< class Request >
+    void run( Request&& request, std::size_t count )
+    {
+        issue( request, [count]( time_point, std::size_t issued ) { return issued < count; } );
+    }
+
+    //! issue requests for a length of time
+    //! @param request  callable invoked like for `run()`
+    //! @param length   time from now during which requests are due
+    //! @returns  number of requests issued
+    template< class Request, class Rep, class Period >
+    std::size_t run_for( Request&& request, std::chrono::duration<Rep, Period> length )
+    {
+        time_point end = ClockType::now() + std::chrono::duration_cast<duration>( length );
+        return issue( request, [end]( time_point intended, std::size_t ) { return intended < end; } );
+    }
+
+    //! time between intended sends, or its mean
+    duration interval( ) const
+    {
+        return interval_;
+    }
+
+    //! schedule of intended sends
+    arrival_process process( ) const
+    {
+        return process_;
+    }
+
+    //! latencies measured from the intended send times
+    const histogram& latency( ) const
+    {
+        return latency_;
+    }
+
+    //! latencies measured from the actual send times
+    const histogram& service_time( ) const
+    {
+        return service_time_;
+    }
+
+    //! service times corrected for coordinated omission with the interval
+    const histogram& corrected_service_time( ) const
+    {
+        return corrected_service_time_;
+    }
+
+    //! number of requests issued
+    std::uint64_t requests( ) const
+    {
+        return latency_.count();
+    }
+
+    //! number of requests sent one interval or more after their intended time
+    std::uint64_t late_sends( ) const
+    {
+        return late_sends_.load( std::memory_order_relaxed );
+    }
+
+    //! largest delay of a send after its intended time
+    duration max_send_lag( ) const
+    {
+        return duration( max_send_lag_.load( std::memory_order_relaxed ) );
+    }
+
+    //! discard all statistics
+    void reset_statistics( )
+    {
+        latency_.reset();
+        service_time_.reset();
+        corrected_service_time_.reset();
+        late_sends_.store( 0, std::memory_order_relaxed );
+        max_send_lag_.store( 0, std::memory_order_relaxed );
+    }
+
+private:
+    using rep = typename duration::rep;
+
+    const duration interval_;
+    const duration spin_slice_;
+    const arrival_process process_;
+    std::mt19937_64 random_;
+    std::exponential_distribution<double> gaps_;
+    histogram latency_;
+    histogram service_time_;
+    histogram corrected_service_time_;
+    std::atomic<std::uint64_t> late_sends_;
+    std::atomic<rep> max_send_lag_;
+
+    template< class Request, class Continue >
+    std::size_t issue( Request& request, Continue keep_going )
+    {
+        std::size_t issued = 0;
+        time_point intended = ClockType::now();
+        while ( keep_going( intended, issued ) )
+        {
+            time_point sent = loop_pacer<ClockType>::wait_until( intended, spin_slice_ );
+            detail::invoke_request( request, intended, 0 );
+            time_point finished = ClockType::now();
+
+            latency_.record( finished - intended );
+            service_time_.record( finished - sent );
+            corrected_service_time_.record_corrected( finished - sent, interval_ );
+            duration lag = sent - intended;
+            if ( lag >= interval_ )
+            {
+                late_sends_.fetch_add( 1, std::memory_order_relaxed );
+            }
+            if ( lag.count() > max_send_lag_.load( std::memory_order_relaxed ) )
+            {
+                max_send_lag_.store( lag.count(), std::memory_order_relaxed );
+            }
+
+            ++issued;
+            intended += next_gap();
+        }
+        return issued;
+    }
+
+    //! the Poisson gap rate is the inverse of the interval
+    static duration at_least_one_tick( duration interval )
+    {
+        return ( interval > duration::zero() ) ? interval : duration( 1 );
+    }
+
+    duration next_gap( )
+    {
+        if ( process_ == arrival_process::constant )
+        {
+            return interval_;
+        }
+        using ticks = std::chrono::duration<double, typename duration::period>;
+        return std::chrono::duration_cast<duration>( ticks( gaps_( random_ ) ) );
+    }
+};
+
+//! simulated service class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details In-process stand-in for a service under test, for exercising a
+//! `load_generator` anywhere. Each call occupies the service for the service
+//! time, and every `stall_every`-th call for the stall time on top, by
+//! sleeping and spinning until the end time. Calls are served one at a time,
+//! as by a single-threaded server, so concurrent callers queue.
+template< class ClockType = std::chrono::steady_clock >
+class simulated_service
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+
+    //! constructor
+    //! @param service_time  time each call takes
+    //! @param stall_time    extra time taken by every `stall_every`-th call
+    //! @param stall_every   period of the stalls in calls; zero for no stalls
+    template< class Rep1, class Period1, class Rep2 = std::int64_t, class Period2 = std::micro >
+    explicit simulated_service( std::chrono::duration<Rep1, Period1> service_time,
+                                std::chrono::duration<Rep2, Period2> stall_time = std::chrono::microseconds( 0 ),
+                                std::size_t stall_every = 0 )
+        : service_time_( std::chrono::duration_cast<duration>( service_time ) )
+        , stall_time_( std::chrono::duration_cast<duration>( stall_time ) )
+        , stall_every_( stall_every )
+        , calls_( 0 )
+        , mutex_( )
+    {}
+
+    simulated_service( const simulated_service& ) = delete;
+    simulated_service& operator=( const simulated_service& ) = delete;
+
+    ~simulated_service( ) = default;
+
+    //! serve one request
+    void operator()( )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        std::uint64_t call = calls_.fetch_add( 1, std::memory_order_relaxed ) + 1;
+        duration busy = service_time_;
+        if ( stall_every_ != 0 && call % stall_every_ == 0 )
+        {
+            busy += stall_time_;
+        }
+        loop_pacer<ClockType>::wait_until( ClockType::now() + busy, std::chrono::microseconds( 50 ) );
+    }
+
+    //! number of requests served
+    std::uint64_t calls( ) const
+    {
+        return calls_.load( std::memory_order_relaxed );
+    }
+
+private:
+    const duration service_time_;
+    const duration stall_time_;
+    const std::size_t stall_every_;
+    std::atomic<std::uint64_t> calls_;
+    std::mutex mutex_;
+};
+
+}
+
+#endif
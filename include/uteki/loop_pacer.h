@@ -0,0 +1,232 @@
+//
+//  loop_pacer.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef loop_pacer_h
+#define loop_pacer_h
+
+#include "uteki/cpu_relax.h"
+#include "uteki/latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace uteki
+{
+
+//! loop pacer class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Runs a loop at a fixed rate. Ticks are scheduled on absolute
+//! targets, `start + n * interval`, so time spent in the loop body and late
+//! wake-ups do not accumulate as drift. Each wait sleeps for the bulk of the
+//! time to the target and spins with a pause instruction for the last slice,
+//! because a sleep can overshoot by tens of microseconds. `calibrate()` sets
+//! the spin slice from the measured sleep overshoot of the current machine.
+//!
+//! A tick whose target has already passed when `wait()` is called is an
+//! overrun and returns at once. When a whole interval or more has been lost,
+//! the missed ticks are skipped rather than run back to back, and counted.
+//! The lateness of every tick, the wake time minus its target, is recorded in
+//! a histogram. The pacer is driven by one thread; its statistics may be read
+//! from any thread.
+//!
+//!  \snippet test_loop_pacer.cpp wait loop_pacer example
+template< class ClockType = std::chrono::steady_clock >
+class loop_pacer
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! constructor
+    //! @details the first tick is due one interval from now
+    //! @param interval    time between ticks; an interval shorter than one
+    //!  clock tick, including zero, is raised to one tick
+    //! @param spin_slice  final part of each wait spent spinning instead of sleeping
+    template< class Rep1, class Period1, class Rep2 = std::int64_t, class Period2 = std::micro >
+    explicit loop_pacer( std::chrono::duration<Rep1, Period1> interval,
+                         std::chrono::duration<Rep2, Period2> spin_slice = std::chrono::microseconds( 100 ) )
+        : interval_( at_least_one_tick( std::chrono::duration_cast<duration>( interval ) ) )
+        , spin_slice_( std::chrono::duration_cast<duration>( spin_slice ) )
+        , next_target_( ClockType::now() + interval_ )
+        , ticks_( 0 )
+        , overruns_( 0 )
+        , missed_( 0 )
+        , lateness_( )
+    {}
+
+    loop_pacer( const loop_pacer& ) = delete;
+    loop_pacer& operator=( const loop_pacer& ) = delete;
+
+    ~loop_pacer( ) = default;
+
+    //! wait for the next tick
+    //! @returns  the target time of the tick
+    time_point wait( )
+    {
+        auto now = ClockType::now();
+        if ( now > next_target_ )
+        {
+            overruns_.fetch_add( 1, std::memory_order_relaxed );
+            auto behind = ( now - next_target_ ) / interval_;
+            if ( behind > 0 )
+            {
+                next_target_ += behind * interval_;
+                missed_.fetch_add( static_cast<std::uint64_t>( behind ), std::memory_order_relaxed );
+            }
+        }
+        time_point target = next_target_;
+        time_point woke = wait_until( target, spin_slice_ );
+        lateness_.record( woke - target );
+        ticks_.fetch_add( 1, std::memory_order_relaxed );
+        next_target_ = target + interval_;
+        return target;
+    }
+
+    //! restart the schedule with the first tick one interval from now
+    void restart( )
+    {
+        next_target_ = ClockType::now() + interval_;
+    }
+
+    //! wait until a time, sleeping first and spinning for the final slice
+    //! @param target      time to wait for
+    //! @param spin_slice  final part of the wait spent spinning
+    //! @returns  the clock reading at which the wait ended
+    static time_point wait_until( time_point target, duration spin_slice )
+    {
+        auto now = ClockType::now();
+        if ( target - now > spin_slice )
+        {
+            std::this_thread::sleep_for( target - now - spin_slice );
+            now = ClockType::now();
+        }
+        while ( now < target )
+        {
+            cpu_relax();
+            now = ClockType::now();
+        }
+        return now;
+    }
+
+    //! set the spin slice from the measured sleep overshoot
+    //! @details sleeps `samples` times and sets the spin slice to the largest
+    //!  overshoot seen, so that a wait rarely wakes after its target, then
+    //!  restarts the schedule
+    //! @param samples  number of trial sleeps
+    //! @returns  the new spin slice
+    duration calibrate( int samples = 100 )
+    {
+        const auto request = std::chrono::microseconds( 50 );
+        duration worst = duration::zero();
+        for ( int k = 0; k < samples; ++k )
+        {
+            auto before = ClockType::now();
+            std::this_thread::sleep_for( request );
+            auto overshoot = ( ClockType::now() - before ) - request;
+            if ( overshoot > worst )
+            {
+                worst = std::chrono::duration_cast<duration>( overshoot );
+            }
+        }
+        spin_slice_ = worst;
+        restart();
+        return spin_slice_;
+    }
+
+    //! time between ticks
+    duration interval( ) const
+    {
+        return interval_;
+    }
+
+    //! final part of each wait spent spinning
+    duration spin_slice( ) const
+    {
+        return spin_slice_;
+    }
+
+    //! target time of the next tick
+    time_point next_target( ) const
+    {
+        return next_target_;
+    }
+
+    //! number of ticks
+    std::uint64_t tick_count( ) const
+    {
+        return ticks_.load( std::memory_order_relaxed );
+    }
+
+    //! number of ticks whose target had passed when `wait()` was called
+    std::uint64_t overrun_count( ) const
+    {
+        return overruns_.load( std::memory_order_relaxed );
+    }
+
+    //! number of ticks skipped after overruns of a whole interval or more
+    std::uint64_t missed_count( ) const
+    {
+        return missed_.load( std::memory_order_relaxed );
+    }
+
+    //! histogram of wake time minus target time of each tick
+    const latency_histogram<std::chrono::nanoseconds>& lateness( ) const
+    {
+        return lateness_;
+    }
+
+    //! discard the statistics
+    void reset_statistics( )
+    {
+        ticks_.store( 0, std::memory_order_relaxed );
+        overruns_.store( 0, std::memory_order_relaxed );
+        missed_.store( 0, std::memory_order_relaxed );
+        lateness_.reset();
+    }
+
+private:
+    const duration interval_;
+    duration spin_slice_;
+    time_point next_target_;
+    std::atomic<std::uint64_t> ticks_;
+    std::atomic<std::uint64_t> overruns_;
+    std::atomic<std::uint64_t> missed_;
+    latency_histogram<std::chrono::nanoseconds> lateness_;
+
+    //! the interval divides the time behind schedule in `wait()`
+    static duration at_least_one_tick( duration interval )
+    {
+        return ( interval > duration::zero() ) ? interval : duration( 1 );
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,113 @@
+//
+//  manual_clock.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef manual_clock_h
+#define manual_clock_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ratio>
+
+namespace uteki
+{
+
+//! manual clock class
+//! @tparam Tag  any type; each distinct tag is an independent clock
+//! @details A steady clock that only moves when it is advanced explicitly.
+//! It satisfies the `std::chrono` clock requirements and can be used as the
+//! `ClockType` of the timer classes, so timing code can be tested and
+//! simulations replayed deterministically at CPU speed. The clock's state is
+//! shared by all threads; use a distinct `Tag` per test or simulation to keep
+//! their clocks apart. The clock never moves backwards except by `reset()`.
+//!
+//!  \snippet test_manual_clock.cpp advance manual_clock example
+template< class Tag = void >
+class manual_clock
+{
+public:
+    //! scalar type for duration tick count
+    using rep = std::int64_t;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = std::nano;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = std::chrono::duration<rep, period>;
+    //! `time_point` type, represents a point in time
+    using time_point = std::chrono::time_point<manual_clock>;
+
+    //! the clock never moves backwards
+    static constexpr bool is_steady = true;
+
+    //! current time
+    static time_point now( ) noexcept
+    {
+        return time_point( duration( ticks().load( std::memory_order_acquire ) ) );
+    }
+
+    //! move the clock forward
+    //! @param step  amount to advance; negative steps are ignored
+    template< class Rep, class Period >
+    static void advance( std::chrono::duration<Rep, Period> step ) noexcept
+    {
+        auto d = std::chrono::duration_cast<duration>( step ).count();
+        if ( d > 0 )
+        {
+            ticks().fetch_add( d, std::memory_order_acq_rel );
+        }
+    }
+
+    //! move the clock forward to a point in time
+    //! @param target  new time; the clock is unchanged if `target` is in the past
+    static void advance_to( time_point target ) noexcept
+    {
+        auto t = target.time_since_epoch().count();
+        auto current = ticks().load( std::memory_order_relaxed );
+        while ( t > current &&
+                ! ticks().compare_exchange_weak( current, t, std::memory_order_acq_rel ) )
+        {
+        }
+    }
+
+    //! set the clock back to its epoch
+    //! @details Breaks the steady guarantee for timers that are still in use;
+    //! intended for use between independent tests or simulation runs.
+    static void reset( ) noexcept
+    {
+        ticks().store( 0, std::memory_order_release );
+    }
+
+private:
+    static std::atomic<rep>& ticks( ) noexcept
+    {
+        static std::atomic<rep> current_ticks( 0 );
+        return current_ticks;
+    }
+};
+
+template< class Tag >
+constexpr bool manual_clock<Tag>::is_steady;
+
+}
+
+#endif
@@ -0,0 +1,351 @@
+//
+//  parallel_region.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef parallel_region_h
+#define parallel_region_h
+
+#include "uteki/stopwatch_timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace uteki
+{
+
+//! parallel region class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Measures load imbalance of a fork-join section: a parallel loop
+//! or a batch of tasks handed to a thread pool, followed by a wait for all of
+//! them. Each worker gets its own `stopwatch_timer` slot, padded so that no
+//! two slots share a cache line, and runs it only while executing tasks of
+//! the region. At the join the busy times are compared: the busiest worker
+//! is the critical path, the ratio of its busy time to the mean is the
+//! imbalance, and `wait` is the time the other workers spent idle until it
+//! finished. A ratio near one means the work was split evenly; a large one
+//! calls for smaller chunks or finer work stealing. The mean and the wait
+//! count every slot, since a worker that got no task was idle for the whole
+//! critical path; the same figures over the participating slots alone are
+//! reported too, for pools sized larger than the work.
+//!
+//! Workers pass their slot index explicitly, or call `this_worker()`, which
+//! hands each thread a slot of its own the first time it asks during a
+//! fork. The cache behind `this_worker()` holds one region per thread, so a
+//! thread working for two regions at once should pass explicit indices.
+//! Tasks that find no free slot are counted by `untimed()`.
+//!
+//!  \snippet test_parallel_region.cpp join parallel_region example
+template< class ClockType = std::chrono::steady_clock >
+class parallel_region
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! worker index returned when all slots are taken
+    static constexpr std::size_t no_worker = static_cast<std::size_t>( -1 );
+
+    //! load balance of the workers of a region
+    struct report
+    {
+        //! time from the fork to the join, or to now before the join
+        duration wall;
+        //! busy time of each slot
+        std::vector<duration> busy;
+        //! number of tasks run by each slot
+        std::vector<std::uint64_t> tasks;
+        //! number of slots that ran at least one task
+        std::size_t participants;
+        //! sum of the busy times
+        duration total_busy;
+        //! mean busy time of all slots, idle ones included
+        duration mean_busy;
+        //! busy time of the critical worker
+        duration max_busy;
+        //! slot with the largest busy time, `no_worker` if no task ran
+        std::size_t critical_worker;
+        //! `max_busy` divided by `mean_busy`; one for a perfect balance, zero if no task ran
+        double imbalance;
+        //! time the other slots were idle while the critical worker was
+        //! still busy, summed over the slots
+        duration wait;
+        //! mean busy time of the participating slots
+        duration participant_mean_busy;
+        //! `max_busy` divided by `participant_mean_busy`
+        double participant_imbalance;
+        //! `wait` counting only the participating slots
+        duration participant_wait;
+    };
+
+    //! task scope class
+    //! @details runs a worker's slot from construction to destruction
+    class task
+    {
+    public:
+        //! constructor
+        //! @param region  region the task belongs to
+        //! @param worker  slot index of the executing worker
+        task( parallel_region& region, std::size_t worker )
+            : region_( region )
+            , worker_( worker )
+        {
+            region_.start( worker_ );
+        }
+
+        //! constructor
+        //! @details uses the calling thread's slot from `this_worker()`
+        //! @param region  region the task belongs to
+        explicit task( parallel_region& region )
+            : task( region, region.this_worker() )
+        {}
+
+        task( const task& ) = delete;
+        task& operator=( const task& ) = delete;
+
+        ~task( )
+        {
+            region_.stop( worker_ );
+        }
+
+    private:
+        parallel_region& region_;
+        const std::size_t worker_;
+    };
+
+    //! constructor
+    //! @details forks the region now
+    //! @param worker_count  number of worker slots
+    explicit parallel_region( std::size_t worker_count )
+        : slots_( worker_count )
+        , next_worker_( 0 )
+        , untimed_( 0 )
+        , id_( 0 )
+        , fork_time_( )
+        , join_time_( )
+        , joined_( false )
+    {
+        fork();
+    }
+
+    parallel_region( const parallel_region& ) = delete;
+    parallel_region& operator=( const parallel_region& ) = delete;
+
+    ~parallel_region( ) = default;
+
+    //! start a new fork-join section
+    //! @details clears all slots and releases the slots handed out by
+    //! `this_worker()`; no task of the region may be running
+    void fork( )
+    {
+        for ( auto& s : slots_ )
+        {
+            s.timer.reset();
+            s.tasks.store( 0, std::memory_order_relaxed );
+        }
+        next_worker_.store( 0, std::memory_order_relaxed );
+        untimed_.store( 0, std::memory_order_relaxed );
+        id_ = next_id().fetch_add( 1, std::memory_order_relaxed ) + 1;
+        joined_ = false;
+        fork_time_ = ClockType::now();
+    }
+
+    //! slot index of the calling thread
+    //! @returns  the slot claimed by this thread since the last fork, a newly
+    //!  claimed slot, or `no_worker` if all slots are taken
+    std::size_t this_worker( )
+    {
+        thread_local claim cached = { 0, no_worker };
+        if ( cached.region != id_ )
+        {
+            std::size_t index = next_worker_.fetch_add( 1, std::memory_order_relaxed );
+            cached.region = id_;
+            cached.worker = ( index < slots_.size() ) ? index : no_worker;
+        }
+        return cached.worker;
+    }
+
+    //! a worker begins a task
+    //! @param worker  slot index; `no_worker` or an index out of range counts the task as untimed
+    void start( std::size_t worker )
+    {
+        if ( worker >= slots_.size() )
+        {
+            untimed_.fetch_add( 1, std::memory_order_relaxed );
+            return;
+        }
+        slots_[worker].timer.start();
+    }
+
+    //! a worker ends a task
+    //! @param worker  slot index passed to `start()`
+    void stop( std::size_t worker )
+    {
+        if ( worker >= slots_.size() )
+        {
+            return;
+        }
+        slots_[worker].timer.stop();
+        slots_[worker].tasks.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //! end the fork-join section
+    //! @details stops slots still running and fixes the wall time; call
+    //! after all workers have finished
+    //! @returns  load balance of the section
+    report join( )
+    {
+        for ( auto& s : slots_ )
+        {
+            s.timer.stop();
+        }
+        join_time_ = ClockType::now();
+        joined_ = true;
+        return current();
+    }
+
+    //! load balance so far
+    //! @details may be called while workers run; running tasks count up to now
+    report current( )
+    {
+        report result;
+        result.wall = ( joined_ ? join_time_ : ClockType::now() ) - fork_time_;
+        result.busy.reserve( slots_.size() );
+        result.tasks.reserve( slots_.size() );
+        result.participants = 0;
+        result.total_busy = duration::zero();
+        result.max_busy = duration::zero();
+        result.critical_worker = no_worker;
+        for ( std::size_t k = 0; k < slots_.size(); ++k )
+        {
+            duration busy = slots_[k].timer.value();
+            std::uint64_t tasks = slots_[k].tasks.load( std::memory_order_relaxed );
+            result.busy.push_back( busy );
+            result.tasks.push_back( tasks );
+            if ( tasks == 0 && busy == duration::zero() )
+            {
+                continue;
+            }
+            ++result.participants;
+            result.total_busy += busy;
+            if ( result.critical_worker == no_worker || busy > result.max_busy )
+            {
+                result.max_busy = busy;
+                result.critical_worker = k;
+            }
+        }
+        balance( result, slots_.size(), result.mean_busy, result.imbalance, result.wait );
+        balance( result, result.participants, result.participant_mean_busy,
+                 result.participant_imbalance, result.participant_wait );
+        return result;
+    }
+
+    //! number of worker slots
+    std::size_t size( ) const
+    {
+        return slots_.size();
+    }
+
+    //! number of tasks since the fork that found no slot
+    std::uint64_t untimed( ) const
+    {
+        return untimed_.load( std::memory_order_relaxed );
+    }
+
+private:
+    static constexpr std::size_t cache_line_size = 64;
+    static constexpr std::size_t slot_payload = sizeof( stopwatch_timer<ClockType> ) + sizeof( std::atomic<std::uint64_t> );
+
+    //! per-worker timer; padded to a whole number of cache lines with at
+    //! least one line to spare, so that neighbouring timers never share a
+    //! line whatever the array alignment
+    struct slot
+    {
+        stopwatch_timer<ClockType> timer;
+        std::atomic<std::uint64_t> tasks;
+        char padding[ 2 * cache_line_size - slot_payload % cache_line_size ];
+
+        slot( )
+            : timer( false )
+            , tasks( 0 )
+        {}
+    };
+
+    //! region and slot last handed to a thread by `this_worker()`
+    struct claim
+    {
+        std::uint64_t region;
+        std::size_t worker;
+    };
+
+    std::vector<slot> slots_;
+    std::atomic<std::size_t> next_worker_;
+    std::atomic<std::uint64_t> untimed_;
+    std::uint64_t id_;
+    time_point fork_time_;
+    time_point join_time_;
+    bool joined_;
+
+    //! mean, imbalance and wait of `result` over `count` slots
+    static void balance( const report& result, std::size_t count,
+                         duration& mean_busy, double& imbalance, duration& wait )
+    {
+        if ( result.participants == 0 )
+        {
+            mean_busy = duration::zero();
+            imbalance = 0.0;
+            wait = duration::zero();
+            return;
+        }
+        auto n = static_cast<typename duration::rep>( count );
+        mean_busy = result.total_busy / n;
+        imbalance = ( result.total_busy == duration::zero() ) ? 1.0
+            : static_cast<double>( result.max_busy.count() ) * static_cast<double>( n )
+                / static_cast<double>( result.total_busy.count() );
+        wait = result.max_busy * n - result.total_busy;
+    }
+
+    //! source of region identifiers, unique across all regions of this clock type
+    static std::atomic<std::uint64_t>& next_id( )
+    {
+        static std::atomic<std::uint64_t> counter( 0 );
+        return counter;
+    }
+};
+
+template< class ClockType >
+constexpr std::size_t parallel_region<ClockType>::no_worker;
+template< class ClockType >
+constexpr std::size_t parallel_region<ClockType>::cache_line_size;
+template< class ClockType >
+constexpr std::size_t parallel_region<ClockType>::slot_payload;
+
+}
+
+#endif
@@ -0,0 +1,279 @@
+//
+//  per_core_stats.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef per_core_stats_h
+#define per_core_stats_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined( __linux__ )
+#include <sched.h>
+#endif
+
+namespace uteki
+{
+
+//! per-core timing statistics class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Aggregates recorded durations (count, total, min and max) in one
+//! shard per CPU. A recording thread updates the shard of the CPU it is
+//! running on, found with `sched_getcpu()` on Linux. Elsewhere, or when that
+//! call fails, a stable per-thread index is used instead. Shards are padded so
+//! that no two share a cache line, and memory grows with the number of CPUs
+//! rather than the number of threads. A background thread folds the shards
+//! into a global snapshot at a configurable interval; `latest()` returns the
+//! most recent snapshot without touching the shards. Recording is lock-free
+//! and thread-safe. A thread that migrates between CPUs during a `record()`
+//! call stays correct but may write to another CPU's shard.
+//!
+//!  \snippet test_per_core_stats.cpp record per_core_stats example
+template< class ClockType = std::chrono::steady_clock >
+class per_core_stats
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! merged statistics of all shards
+    struct snapshot
+    {
+        //! number of recorded durations
+        std::uint64_t count;
+        //! sum of recorded durations
+        duration total;
+        //! smallest recorded duration, zero if `count` is zero
+        duration min;
+        //! largest recorded duration
+        duration max;
+        //! time the snapshot was merged
+        time_point time;
+
+        //! mean recorded duration, zero if `count` is zero
+        template< typename T = std::chrono::duration<double, typename duration::period> >
+        T mean( ) const
+        {
+            using fp_duration = std::chrono::duration<double, typename duration::period>;
+            return ( count == 0 ) ? T::zero()
+                : std::chrono::duration_cast<T>( fp_duration( total ) / static_cast<double>( count ) );
+        }
+    };
+
+    //! constructor
+    //! @details starts the merge thread unless `merge_interval` is zero
+    //! @param merge_interval  time between background merges
+    //! @param shard_count     number of shards; zero for one per hardware thread
+    template< class Rep = std::int64_t, class Period = std::milli >
+    explicit per_core_stats(
+        std::chrono::duration<Rep, Period> merge_interval = std::chrono::milliseconds( 100 ),
+        std::size_t shard_count = 0 )
+        : shards_( shard_count != 0 ? shard_count : default_shard_count() )
+        , interval_( std::chrono::duration_cast<duration>( merge_interval ) )
+        , lock_( )
+        , wakeup_( )
+        , stopping_( false )
+        , latest_( )
+        , merger_( )
+    {
+        latest_ = merge();
+        if ( interval_ > duration::zero() )
+        {
+            merger_ = std::thread( [this]() { merge_loop(); } );
+        }
+    }
+
+    per_core_stats( const per_core_stats& ) = delete;
+    per_core_stats& operator=( const per_core_stats& ) = delete;
+
+    //! destructor, stops the merge thread
+    ~per_core_stats( )
+    {
+        {
+            std::lock_guard<std::mutex> guard( lock_ );
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+        if ( merger_.joinable() )
+        {
+            merger_.join();
+        }
+    }
+
+    //! record a duration in the current CPU's shard
+    template< class Rep, class Period >
+    void record( std::chrono::duration<Rep, Period> value )
+    {
+        auto ticks = std::chrono::duration_cast<duration>( value ).count();
+        std::uint64_t v = ( ticks > 0 ) ? static_cast<std::uint64_t>( ticks ) : 0;
+
+        shard& s = shards_[ current_cpu() % shards_.size() ];
+        s.count.fetch_add( 1, std::memory_order_relaxed );
+        s.total.fetch_add( v, std::memory_order_relaxed );
+        auto current_min = s.min.load( std::memory_order_relaxed );
+        while ( v < current_min &&
+                ! s.min.compare_exchange_weak( current_min, v, std::memory_order_relaxed ) )
+        {
+        }
+        auto current_max = s.max.load( std::memory_order_relaxed );
+        while ( v > current_max &&
+                ! s.max.compare_exchange_weak( current_max, v, std::memory_order_relaxed ) )
+        {
+        }
+    }
+
+    //! most recent snapshot merged by the background thread
+    snapshot latest( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return latest_;
+    }
+
+    //! merge the shards now
+    //! @returns  the new snapshot, which also becomes `latest()`
+    snapshot merge_now( )
+    {
+        snapshot result = merge();
+        std::lock_guard<std::mutex> guard( lock_ );
+        latest_ = result;
+        return result;
+    }
+
+    //! number of shards
+    std::size_t shard_count( ) const
+    {
+        return shards_.size();
+    }
+
+    //! index of the CPU the calling thread is running on
+    //! @returns  CPU number from the operating system, or a stable per-thread
+    //!  index where the CPU number is not available
+    static std::size_t current_cpu( )
+    {
+#if defined( __linux__ )
+        int cpu = sched_getcpu();
+        if ( cpu >= 0 )
+        {
+            return static_cast<std::size_t>( cpu );
+        }
+#endif
+        static std::atomic<std::size_t> next_index( 0 );
+        thread_local std::size_t index = next_index.fetch_add( 1, std::memory_order_relaxed );
+        return index;
+    }
+
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    //! per-CPU aggregates; padded to two cache lines so that the counters of
+    //! neighbouring shards never share a line, whatever the array alignment
+    struct shard
+    {
+        std::atomic<std::uint64_t> count;
+        std::atomic<std::uint64_t> total;
+        std::atomic<std::uint64_t> min;
+        std::atomic<std::uint64_t> max;
+        char padding[ 2 * cache_line_size - 4 * sizeof( std::atomic<std::uint64_t> ) ];
+
+        shard( )
+            : count( 0 )
+            , total( 0 )
+            , min( std::numeric_limits<std::uint64_t>::max() )
+            , max( 0 )
+        {}
+    };
+
+    std::vector<shard> shards_;
+    const duration interval_;
+    mutable std::mutex lock_;
+    std::condition_variable wakeup_;
+    bool stopping_;
+    snapshot latest_;
+    std::thread merger_;
+
+    static std::size_t default_shard_count( )
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return ( n != 0 ) ? n : 1;
+    }
+
+    snapshot merge( ) const
+    {
+        std::uint64_t count = 0;
+        std::uint64_t total = 0;
+        std::uint64_t min = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t max = 0;
+        for ( const auto& s : shards_ )
+        {
+            count += s.count.load( std::memory_order_relaxed );
+            total += s.total.load( std::memory_order_relaxed );
+            auto shard_min = s.min.load( std::memory_order_relaxed );
+            auto shard_max = s.max.load( std::memory_order_relaxed );
+            min = ( shard_min < min ) ? shard_min : min;
+            max = ( shard_max > max ) ? shard_max : max;
+        }
+        snapshot result;
+        result.count = count;
+        result.total = duration( static_cast<typename duration::rep>( total ) );
+        result.min = ( count == 0 ) ? duration::zero()
+            : duration( static_cast<typename duration::rep>( min ) );
+        result.max = duration( static_cast<typename duration::rep>( max ) );
+        result.time = ClockType::now();
+        return result;
+    }
+
+    void merge_loop( )
+    {
+        std::unique_lock<std::mutex> guard( lock_ );
+        while ( ! stopping_ )
+        {
+            wakeup_.wait_for( guard, interval_ );
+            if ( stopping_ )
+            {
+                break;
+            }
+            guard.unlock();
+            snapshot result = merge();
+            guard.lock();
+            latest_ = result;
+        }
+    }
+};
+
+template< class ClockType >
+constexpr std::size_t per_core_stats<ClockType>::cache_line_size;
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+//
+//  phase_timer.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef phase_timer_h
+#define phase_timer_h
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace uteki
+{
+
+//! phase timer class
+//! @tparam Phase      enumeration type of the phases; enumerators must be
+//!  consecutive from zero
+//! @tparam N          number of phases, by default the value of the `count`
+//!  enumerator that follows the last phase
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Splits the time of a sequential process, such as one request
+//! going through a pipeline, between a fixed set of phases. The timer is
+//! always in exactly one phase; `transition()` reads the clock once,
+//! attributes the time since the previous transition to the outgoing phase
+//! and enters the next one. Accumulators live in an array indexed by the
+//! enumerator, so there is no lookup and no lock. A phase timer belongs to
+//! one thread; use one per request or per thread and `merge()` them for
+//! totals.
+//!
+//!  \snippet test_phase_timer.cpp transition phase_timer example
+template< class Phase, std::size_t N = static_cast<std::size_t>( Phase::count ),
+          class ClockType = std::chrono::steady_clock >
+class phase_timer
+{
+    static_assert( std::is_enum<Phase>::value, "phase type must be an enumeration" );
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! enumeration type of the phases
+    using phase_type = Phase;
+    //! scalar type for duration tick count
+    using rep = typename ClockType::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename ClockType::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! number of phases
+    static constexpr std::size_t phase_count = N;
+
+    //! constructor
+    //! @details enters the initial phase now
+    //! @param initial  initial phase
+    explicit phase_timer( Phase initial )
+        : totals_( )
+        , entries_( )
+        , current_( initial )
+        , running_( true )
+        , last_( ClockType::now() )
+    {
+        entries_[ index( initial ) ] = 1;
+    }
+
+    //! leave the current phase and enter another
+    //! @param next  phase to enter; may be the current phase
+    //! @returns  time spent in the phase that was left, zero if the timer was stopped
+    duration transition( Phase next )
+    {
+        time_point now = ClockType::now();
+        duration slice = running_ ? now - last_ : duration::zero();
+        totals_[ index( current_ ) ] += slice;
+        ++entries_[ index( next ) ];
+        current_ = next;
+        running_ = true;
+        last_ = now;
+        return slice;
+    }
+
+    //! leave the current phase without entering another
+    //! @details the next `transition()` restarts the timer
+    //! @returns  time spent in the phase that was left, zero if the timer was stopped
+    duration stop( )
+    {
+        if ( ! running_ )
+        {
+            return duration::zero();
+        }
+        time_point now = ClockType::now();
+        duration slice = now - last_;
+        totals_[ index( current_ ) ] += slice;
+        running_ = false;
+        last_ = now;
+        return slice;
+    }
+
+    //! is the timer in a phase
+    bool is_running( ) const
+    {
+        return running_;
+    }
+
+    //! current phase, or the last phase if the timer is stopped
+    Phase current( ) const
+    {
+        return current_;
+    }
+
+    //! time spent in a phase
+    //! @details excludes the slice of the current phase still in progress
+    template< typename T = duration >
+    T value( Phase phase ) const
+    {
+        return std::chrono::duration_cast<T>( totals_[ index( phase ) ] );
+    }
+
+    //! time spent in all phases
+    //! @details excludes the slice of the current phase still in progress
+    template< typename T = duration >
+    T total( ) const
+    {
+        duration sum = duration::zero();
+        for ( const auto& t : totals_ )
+        {
+            sum += t;
+        }
+        return std::chrono::duration_cast<T>( sum );
+    }
+
+    //! number of times a phase was entered
+    std::uint64_t entries( Phase phase ) const
+    {
+        return entries_[ index( phase ) ];
+    }
+
+    //! add the accumulated times and entry counts of another timer
+    void merge( const phase_timer& other )
+    {
+        for ( std::size_t k = 0; k < N; ++k )
+        {
+            totals_[k] += other.totals_[k];
+            entries_[k] += other.entries_[k];
+        }
+    }
+
+    //! discard the accumulated times and enter a phase now
+    void reset( Phase initial )
+    {
+        totals_.fill( duration::zero() );
+        entries_.fill( 0 );
+        entries_[ index( initial ) ] = 1;
+        current_ = initial;
+        running_ = true;
+        last_ = ClockType::now();
+    }
+
+private:
+    std::array<duration, N> totals_;
+    std::array<std::uint64_t, N> entries_;
+    Phase current_;
+    bool running_;
+    time_point last_;
+
+    static std::size_t index( Phase phase )
+    {
+        return static_cast<std::size_t>( phase );
+    }
+};
+
+template< class Phase, std::size_t N, class ClockType >
+constexpr std::size_t phase_timer<Phase, N, ClockType>::phase_count;
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+//
+//  record_channel.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef record_channel_h
+#define record_channel_h
+
+#include "uteki/cpu_relax.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace uteki
+{
+
+//! timing record
+//! @tparam ClockType  `std::chrono` clock type the record was measured with
+//! @details Fixed-size record of one measurement, suitable for `record_channel`.
+template< class ClockType = std::chrono::steady_clock >
+struct timing_record
+{
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! caller defined identifier of what was measured
+    std::uint64_t id;
+    //! time the measurement started
+    time_point start;
+    //! measured duration
+    duration elapsed;
+};
+
+//! what `record_channel::push()` does when the channel is full
+enum class overflow_policy
+{
+    //! discard the record and count it as dropped
+    drop,
+    //! spin until the consumer makes room
+    block
+};
+
+//! record channel class
+//! @tparam Record  trivially copyable record type
+//! @details Bounded multi-producer single-consumer queue for shipping timing
+//! records from the measuring threads to a consumer thread, so that sinks
+//! doing I/O never run on the measured path. Producers claim a slot with one
+//! compare-and-swap and publish it with a release store; the consumer drains
+//! records in batches. The producer and consumer positions are kept on
+//! separate cache lines. When the channel is full a producer either drops the
+//! record and counts it, or spins until room is available, as chosen by the
+//! `overflow_policy`. `push()` may be called from any thread; `drain()` must
+//! only be called from one thread at a time.
+//!
+//!  \snippet test_record_channel.cpp push record_channel example
+template< class Record = timing_record<> >
+class record_channel
+{
+    static_assert( std::is_trivially_copyable<Record>::value,
+                   "record type must be trivially copyable" );
+
+public:
+    //! record type
+    using record_type = Record;
+
+    //! constructor
+    //! @param capacity  minimum number of records the channel holds; rounded
+    //!  up to a power of two
+    //! @param policy    what `push()` does when the channel is full
+    explicit record_channel( std::size_t capacity,
+                             overflow_policy policy = overflow_policy::drop )
+        : cells_( round_up_pow2( capacity ) )
+        , mask_( cells_.size() - 1 )
+        , policy_( policy )
+        , dropped_( 0 )
+        , tail_( 0 )
+        , head_( 0 )
+    {
+        for ( std::size_t k = 0; k < cells_.size(); ++k )
+        {
+            cells_[k].sequence.store( k, std::memory_order_relaxed );
+        }
+    }
+
+    record_channel( const record_channel& ) = delete;
+    record_channel& operator=( const record_channel& ) = delete;
+
+    ~record_channel( ) = default;
+
+    //! add a record
+    //! @returns  `false` if the channel was full and the record was dropped
+    bool push( const Record& record )
+    {
+        std::size_t pos = tail_.load( std::memory_order_relaxed );
+        cell* c;
+        for ( ;; )
+        {
+            c = &cells_[pos & mask_];
+            std::size_t sequence = c->sequence.load( std::memory_order_acquire );
+            auto diff = static_cast<std::ptrdiff_t>( sequence - pos );
+            if ( diff == 0 )
+            {
+                if ( tail_.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+                {
+                    break;
+                }
+            }
+            else if ( diff < 0 )
+            {
+                if ( policy_ == overflow_policy::drop )
+                {
+                    dropped_.fetch_add( 1, std::memory_order_relaxed );
+                    return false;
+                }
+                cpu_relax();
+                pos = tail_.load( std::memory_order_relaxed );
+            }
+            else
+            {
+                pos = tail_.load( std::memory_order_relaxed );
+            }
+        }
+        c->data = record;
+        c->sequence.store( pos + 1, std::memory_order_release );
+        return true;
+    }
+
+    //! remove records and pass them to a sink
+    //! @param sink       callable invoked as `sink( const Record& )` for each record
+    //! @param max_batch  maximum number of records to remove
+    //! @returns  number of records removed
+    template< class Sink >
+    std::size_t drain( Sink&& sink, std::size_t max_batch = static_cast<std::size_t>( -1 ) )
+    {
+        std::size_t pos = head_.load( std::memory_order_relaxed );
+        std::size_t count = 0;
+        while ( count < max_batch )
+        {
+            cell& c = cells_[pos & mask_];
+            if ( c.sequence.load( std::memory_order_acquire ) != pos + 1 )
+            {
+                break;
+            }
+            Record record = c.data;
+            c.sequence.store( pos + cells_.size(), std::memory_order_release );
+            ++pos;
+            ++count;
+            sink( record );
+        }
+        head_.store( pos, std::memory_order_relaxed );
+        return count;
+    }
+
+    //! number of records the channel holds
+    std::size_t capacity( ) const
+    {
+        return cells_.size();
+    }
+
+    //! approximate number of records waiting to be drained
+    std::size_t size( ) const
+    {
+        std::size_t tail = tail_.load( std::memory_order_relaxed );
+        std::size_t head = head_.load( std::memory_order_relaxed );
+        return ( tail > head ) ? tail - head : 0;
+    }
+
+    //! number of records dropped because the channel was full
+    std::uint64_t dropped( ) const
+    {
+        return dropped_.load( std::memory_order_relaxed );
+    }
+
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        Record data;
+    };
+
+    std::vector<cell> cells_;
+    const std::size_t mask_;
+    const overflow_policy policy_;
+    std::atomic<std::uint64_t> dropped_;
+    char tail_padding_[cache_line_size];
+    std::atomic<std::size_t> tail_;
+    char head_padding_[cache_line_size];
+    std::atomic<std::size_t> head_;
+    char end_padding_[cache_line_size];
+
+    static std::size_t round_up_pow2( std::size_t n )
+    {
+        std::size_t result = 2;
+        while ( result < n )
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+};
+
+template< class Record >
+constexpr std::size_t record_channel<Record>::cache_line_size;
+
+//! record channel consumer class
+//! @tparam Record  record type of the channel
+//! @details Runs a thread that drains a `record_channel` into a sink, such as
+//! a histogram, a file writer or an exporter. When the channel is empty the
+//! thread sleeps for the idle interval. Records still in the channel are
+//! drained when the consumer is stopped or destroyed.
+template< class Record = timing_record<> >
+class channel_consumer
+{
+public:
+    //! sink type
+    using sink_type = std::function< void( const Record& ) >;
+
+    //! constructor, starts the consumer thread
+    //! @param channel        channel to drain
+    //! @param sink           callable invoked for each record
+    //! @param idle_interval  sleep time when the channel is empty
+    //! @param max_batch      maximum records drained between idle checks
+    template< class Rep = std::int64_t, class Period = std::micro >
+    channel_consumer( record_channel<Record>& channel,
+                      sink_type sink,
+                      std::chrono::duration<Rep, Period> idle_interval = std::chrono::microseconds( 100 ),
+                      std::size_t max_batch = 256 )
+        : channel_( channel )
+        , sink_( std::move( sink ) )
+        , idle_interval_( std::chrono::duration_cast<std::chrono::nanoseconds>( idle_interval ) )
+        , max_batch_( max_batch )
+        , stopping_( false )
+        , consumed_( 0 )
+        , thread_( [this]() { run(); } )
+    {}
+
+    channel_consumer( const channel_consumer& ) = delete;
+    channel_consumer& operator=( const channel_consumer& ) = delete;
+
+    //! destructor, stops the consumer thread
+    ~channel_consumer( )
+    {
+        stop();
+    }
+
+    //! drain the remaining records and stop the consumer thread
+    void stop( )
+    {
+        stopping_.store( true, std::memory_order_release );
+        if ( thread_.joinable() )
+        {
+            thread_.join();
+        }
+    }
+
+    //! number of records passed to the sink
+    std::uint64_t consumed( ) const
+    {
+        return consumed_.load( std::memory_order_relaxed );
+    }
+
+private:
+    record_channel<Record>& channel_;
+    sink_type sink_;
+    const std::chrono::nanoseconds idle_interval_;
+    const std::size_t max_batch_;
+    std::atomic<bool> stopping_;
+    std::atomic<std::uint64_t> consumed_;
+    std::thread thread_;
+
+    void run( )
+    {
+        for ( ;; )
+        {
+            bool stopping = stopping_.load( std::memory_order_acquire );
+            std::size_t n = channel_.drain( sink_, max_batch_ );
+            consumed_.fetch_add( n, std::memory_order_relaxed );
+            if ( n == 0 )
+            {
+                if ( stopping )
+                {
+                    break;
+                }
+                std::this_thread::sleep_for( idle_interval_ );
+            }
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,284 @@
+//
+//  sampled_timer.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef sampled_timer_h
+#define sampled_timer_h
+
+#include "uteki/latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace uteki
+{
+
+//! sampled timer class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Times only a random subset of invocations of a hot code path.
+//! Each invocation is sampled independently with probability 1/`interval`.
+//! The gap to the next sampled invocation is drawn from a geometric
+//! distribution and counted down in thread-local state, so an invocation that
+//! is not sampled costs one thread-local decrement and a well predicted
+//! branch, and no clock read. Each thread keeps the countdowns in a small
+//! table with one entry per timer, assigned round robin at construction, so
+//! up to `local_slots` timers interleaved on one thread keep their own
+//! countdowns. Timers sharing an entry still sample correctly, because the
+//! skip is memoryless, but each switch between them redraws the skip at the
+//! cost of a `log()`.
+//! Aggregates are scaled by `interval` to give unbiased estimates of the
+//! total invocation count, total time and invocation rate.
+//!
+//!  \snippet test_sampled_timer.cpp measure sampled_timer example
+template< class ClockType = std::chrono::steady_clock >
+class sampled_timer
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! scalar type for duration tick count
+    using rep = typename ClockType::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename ClockType::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+    //! histogram type for sampled durations
+    using histogram = latency_histogram<duration>;
+
+    //! number of per-thread countdown entries
+    static constexpr std::size_t local_slots = 16;
+
+    //! timing scope of one invocation
+    //! @details Reads the clock on construction and destruction only when the
+    //! invocation is sampled.
+    class scope
+    {
+    public:
+        //! move constructor
+        scope( scope&& other ) noexcept
+            : owner_( other.owner_ )
+            , start_time_( other.start_time_ )
+        {
+            other.owner_ = nullptr;
+        }
+
+        scope( const scope& ) = delete;
+        scope& operator=( const scope& ) = delete;
+
+        //! destructor, records the invocation's duration if sampled
+        ~scope( )
+        {
+            if ( owner_ != nullptr )
+            {
+                owner_->samples_.record( ClockType::now() - start_time_ );
+            }
+        }
+
+        //! is this invocation being timed
+        bool is_sampled( ) const
+        {
+            return owner_ != nullptr;
+        }
+
+    private:
+        friend class sampled_timer;
+
+        explicit scope( sampled_timer* owner )
+            : owner_( owner )
+            , start_time_( owner != nullptr ? ClockType::now() : time_point() )
+        {}
+
+        sampled_timer* owner_;
+        time_point start_time_;
+    };
+
+    //! constructor
+    //! @param interval  mean number of invocations per sampled invocation
+    explicit sampled_timer( std::uint64_t interval )
+        : interval_( interval > 0 ? interval : 1 )
+        , slot_( next_slot().fetch_add( 1, std::memory_order_relaxed ) % local_slots )
+        , skip_scale_( interval_ > 1
+                       ? 1.0 / std::log1p( -1.0 / static_cast<double>( interval_ ) ) : 0.0 )
+        , samples_( )
+        , start_time_( ClockType::now() )
+    {}
+
+    sampled_timer( const sampled_timer& ) = delete;
+    sampled_timer& operator=( const sampled_timer& ) = delete;
+
+    ~sampled_timer( ) = default;
+
+    //! mean number of invocations per sampled invocation
+    std::uint64_t interval( ) const
+    {
+        return interval_;
+    }
+
+    //! decide whether the current invocation is sampled
+    //! @returns  `true` for about one in `interval()` calls
+    bool should_sample( )
+    {
+        countdown& entry = local_state_.entries[slot_];
+        if ( entry.owner == this && --entry.remaining != 0 )
+        {
+            return false;
+        }
+        return should_sample_slow( entry );
+    }
+
+    //! time the current invocation if it is sampled
+    //! @returns  scope that times the invocation until it is destroyed
+    //!
+    //!  \snippet test_sampled_timer.cpp measure sampled_timer example
+    scope measure( )
+    {
+        return scope( should_sample() ? this : nullptr );
+    }
+
+    //! record the duration of a sampled invocation timed by the caller
+    template< class Rep, class Period >
+    void record_sample( std::chrono::duration<Rep, Period> elapsed )
+    {
+        samples_.record( elapsed );
+    }
+
+    //! histogram of sampled durations
+    const histogram& samples( ) const
+    {
+        return samples_;
+    }
+
+    //! number of sampled invocations
+    std::uint64_t sample_count( ) const
+    {
+        return samples_.count();
+    }
+
+    //! estimated number of invocations
+    std::uint64_t estimated_count( ) const
+    {
+        return samples_.count() * interval_;
+    }
+
+    //! estimated total time of all invocations
+    template< typename T = duration >
+    T estimated_total( ) const
+    {
+        return std::chrono::duration_cast<T>( samples_.sum() * interval_ );
+    }
+
+    //! estimated invocations per second since construction or `reset()`
+    double estimated_rate( ) const
+    {
+        std::chrono::duration<double> elapsed = ClockType::now() - start_time_.load();
+        return ( elapsed.count() > 0.0 )
+            ? static_cast<double>( estimated_count() ) / elapsed.count() : 0.0;
+    }
+
+    //! discard all samples and restart the rate measurement
+    void reset( )
+    {
+        samples_.reset();
+        start_time_ = ClockType::now();
+    }
+
+private:
+    struct countdown
+    {
+        const sampled_timer* owner;
+        std::uint64_t remaining;
+    };
+
+    struct sampler_state
+    {
+        countdown entries[local_slots];
+        std::uint64_t random;
+    };
+
+    static thread_local sampler_state local_state_;
+
+    const std::uint64_t interval_;
+    const std::size_t slot_;
+    const double skip_scale_;
+    histogram samples_;
+    std::atomic<time_point> start_time_;
+
+    bool should_sample_slow( countdown& entry )
+    {
+        if ( entry.owner != this )
+        {
+            // the skip is memoryless, so a fresh draw for this timer is unbiased
+            entry.owner = this;
+            entry.remaining = draw_skip();
+            if ( --entry.remaining != 0 )
+            {
+                return false;
+            }
+        }
+        entry.remaining = draw_skip();
+        return true;
+    }
+
+    static std::atomic<std::size_t>& next_slot( )
+    {
+        static std::atomic<std::size_t> counter( 0 );
+        return counter;
+    }
+
+    //! number of invocations up to and including the next sampled one
+    std::uint64_t draw_skip( ) const
+    {
+        sampler_state& state = local_state_;
+        if ( interval_ <= 1 )
+        {
+            return 1;
+        }
+        if ( state.random == 0 )
+        {
+            state.random = reinterpret_cast<std::uintptr_t>( &state ) ^
+                static_cast<std::uint64_t>( ClockType::now().time_since_epoch().count() ) ^
+                0x9e3779b97f4a7c15ull;
+        }
+        // xorshift64*
+        state.random ^= state.random >> 12;
+        state.random ^= state.random << 25;
+        state.random ^= state.random >> 27;
+        std::uint64_t bits = state.random * 0x2545f4914f6cdd1dull;
+        double u = ( static_cast<double>( bits >> 11 ) + 1.0 ) * ( 1.0 / 9007199254740992.0 );
+        return 1 + static_cast<std::uint64_t>( std::log( u ) * skip_scale_ );
+    }
+};
+
+template< class ClockType >
+constexpr std::size_t sampled_timer<ClockType>::local_slots;
+template< class ClockType >
+thread_local typename sampled_timer<ClockType>::sampler_state sampled_timer<ClockType>::local_state_;
+
+}
+
+#endif
@@ -0,0 +1,851 @@
+//
+//  scope_profiler.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef scope_profiler_h
+#define scope_profiler_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace uteki
+{
+
+//! scope profiler class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Aggregates the wall time of nested, named timing scopes by stack
+//! path, for flame graphs built from instrumentation rather than sampling.
+//! Each thread accumulates into its own prefix tree in which every distinct
+//! path from the root is one node, found by hashing the parent node and the
+//! scope name, so repeated paths share a node and cost no memory. Each node
+//! keeps the call count, the inclusive time and the time spent in child
+//! scopes, from which the self time follows.
+//!
+//! Trees have a fixed node capacity per thread, so memory stays bounded when
+//! the profiler runs continuously; scopes on paths that do not fit are not
+//! recorded and are counted as dropped. A tree is created on the thread's
+//! first scope and grows in small chunks as paths are added. When a thread
+//! exits, its tree is merged into the totals of exited threads and freed, so
+//! short-lived threads do not accumulate. Each thread caches its trees of up
+//! to `local_slots` profilers. `folded()` can be called at any time
+//! from any thread and writes Brendan Gregg's folded stack format, one
+//! `outer;inner;leaf self_time` line per path, summed over threads and sorted
+//! by descending self time. Scope names are compared by pointer first, so
+//! string literals are the intended names; equal strings at different
+//! addresses still map to the same node.
+//!
+//! Every scope adds the cost of its own clock reads and bookkeeping to the
+//! measured times. The part between its two clock readings, the window
+//! overhead, inflates the scope's own time; the rest, spent before its first
+//! reading and after its second, inflates its enclosing scopes, which in
+//! deeply nested code makes parents look expensive. The profiler measures
+//! both parts on construction, or on `calibrate()`, and counts for every
+//! path the scopes nested below it. `report()` gives raw and
+//! overhead-corrected inclusive and exclusive times per path, and
+//! `thread_overhead()` the total overhead per thread, which shows whether
+//! profiling distorts what it measures.
+//!
+//!  \snippet test_scope_profiler.cpp scope scope_profiler example
+//!
+//!  \snippet test_scope_profiler.cpp report scope_profiler example
+template< class ClockType = std::chrono::steady_clock >
+class scope_profiler
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! scalar type for duration tick count
+    using rep = typename ClockType::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename ClockType::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! profilers whose tree a thread finds without locking
+    static constexpr std::size_t local_slots = 8;
+
+    //! times of one path, summed over threads
+    struct path_report
+    {
+        //! scope names from the outermost, separated by ';'
+        std::string path;
+        //! number of completed scopes
+        std::uint64_t calls;
+        //! number of scopes completed while nested below this path
+        std::uint64_t descendants;
+        //! measured time from entry to exit
+        duration inclusive;
+        //! measured time not spent in nested scopes
+        duration exclusive;
+        //! corrected exclusive time plus the corrected inclusive times of the
+        //! directly nested paths: the inclusive time less the window overhead
+        //! of this path's scopes and the whole overhead of the scopes nested
+        //! below it, but never less than any nested path
+        duration corrected_inclusive;
+        //! exclusive time less the window overhead of this path's scopes and
+        //! the overhead outside the windows of the directly nested scopes
+        duration corrected_exclusive;
+    };
+
+    //! instrumentation overhead of one thread
+    struct thread_report
+    {
+        //! thread identifier; a default-constructed id for the exited threads together
+        std::thread::id thread;
+        //! number of scopes completed, including dropped ones
+        std::uint64_t scopes;
+        //! measured time in the thread's outermost scopes
+        duration instrumented;
+        //! estimated time spent in the profiler, `scopes` times the scope overhead
+        duration overhead;
+    };
+
+    //! timing scope
+    //! @details Enters a named scope below the calling thread's current scope
+    //! on construction and leaves it on destruction. Scopes must be destroyed
+    //! in reverse order of construction on the thread that created them.
+    class scope
+    {
+    public:
+        //! constructor
+        //! @param profiler  profiler to record into
+        //! @param name      scope name; must outlive the profiler
+        scope( scope_profiler& profiler, const char* name )
+            : tree_( profiler.local_tree() )
+            , node_( tree_->enter( name ) )
+            , completed_at_start_( tree_->completed.load( std::memory_order_relaxed ) )
+            , start_time_( ClockType::now() )
+        {}
+
+        scope( const scope& ) = delete;
+        scope& operator=( const scope& ) = delete;
+
+        //! destructor, adds the scope's time to its path
+        ~scope( )
+        {
+            auto elapsed = ClockType::now() - start_time_;
+            tree_->leave( node_, static_cast<std::uint64_t>( elapsed.count() ), completed_at_start_ );
+        }
+
+    private:
+        typename scope_profiler::thread_tree* tree_;
+        std::uint32_t node_;
+        std::uint64_t completed_at_start_;
+        time_point start_time_;
+    };
+
+    //! constructor
+    //! @param max_nodes               maximum number of distinct paths recorded per thread
+    //! @param calibration_iterations  empty scopes timed to measure the scope
+    //!  overhead; zero leaves the overhead at zero
+    explicit scope_profiler( std::size_t max_nodes = 4096, std::size_t calibration_iterations = 1000 )
+        : id_( next_id() )
+        , slot_( id_ % local_slots )
+        , max_nodes_( max_nodes > 0 ? max_nodes : 1 )
+        , overhead_( 0 )
+        , window_overhead_( 0 )
+        , lock_( )
+        , trees_( )
+        , exited_( )
+    {
+        {
+            std::lock_guard<std::mutex> guard( registry_lock() );
+            registry()[id_] = this;
+        }
+        if ( calibration_iterations > 0 )
+        {
+            calibrate( calibration_iterations );
+        }
+    }
+
+    scope_profiler( const scope_profiler& ) = delete;
+    scope_profiler& operator=( const scope_profiler& ) = delete;
+
+    ~scope_profiler( )
+    {
+        // waits for a thread merging its tree at exit
+        std::lock_guard<std::mutex> guard( registry_lock() );
+        registry().erase( id_ );
+    }
+
+    //! write the folded stacks
+    //! @tparam T  duration type of the written self times
+    //! @param out        stream to write to
+    //! @param corrected  write overhead-corrected instead of measured self times
+    template< typename T = std::chrono::microseconds >
+    void write_folded( std::ostream& out, bool corrected = false ) const
+    {
+        std::vector<path_report> paths = report();
+        std::stable_sort( paths.begin(), paths.end(),
+            [corrected]( const path_report& a, const path_report& b ) {
+                return corrected ? a.corrected_exclusive > b.corrected_exclusive : a.exclusive > b.exclusive;
+            } );
+        for ( const auto& path : paths )
+        {
+            auto self = std::chrono::duration_cast<T>( corrected ? path.corrected_exclusive : path.exclusive );
+            out << path.path << ' ' << self.count() << '\n';
+        }
+    }
+
+    //! folded stacks
+    //! @tparam T  duration type of the written self times
+    //! @param corrected  write overhead-corrected instead of measured self times
+    template< typename T = std::chrono::microseconds >
+    std::string folded( bool corrected = false ) const
+    {
+        std::ostringstream out;
+        write_folded<T>( out, corrected );
+        return out.str();
+    }
+
+    //! raw and overhead-corrected times of every recorded path
+    //! @details Each scope of a path adds the window overhead to the path's
+    //!  inclusive and exclusive times. A scope nested any depth below a path
+    //!  adds its whole overhead to the path's inclusive time. A directly
+    //!  nested scope adds to the path's exclusive time only the overhead
+    //!  outside its window, since its measured time, window overhead included,
+    //!  is already subtracted. Corrected exclusive times subtract those
+    //!  overheads, clamped at zero, and corrected inclusive times are summed
+    //!  from them bottom up, so that a path is never reported as costing more
+    //!  than the path enclosing it.
+    //! @returns  one entry per path, summed over threads, in path order
+    std::vector<path_report> report( ) const
+    {
+        std::map<std::string, path_totals> paths;
+        {
+            std::lock_guard<std::mutex> guard( lock_ );
+            for ( const auto& tree : trees_ )
+            {
+                tree.second->collect( paths );
+            }
+            for ( const auto& p : exited_.paths )
+            {
+                add( paths[p.first], p.second );
+            }
+        }
+        const std::uint64_t overhead = overhead_.load( std::memory_order_relaxed );
+        const std::uint64_t window = window_overhead_.load( std::memory_order_relaxed );
+        const std::uint64_t outside = saturating_sub( overhead, window );
+        std::vector<path_report> result;
+        result.reserve( paths.size() );
+        for ( const auto& p : paths )
+        {
+            const path_totals& t = p.second;
+            std::uint64_t exclusive = saturating_sub( t.inclusive, t.children );
+            path_report r;
+            r.path = p.first;
+            r.calls = t.calls;
+            r.descendants = t.descendants;
+            r.inclusive = to_duration( t.inclusive );
+            r.exclusive = to_duration( exclusive );
+            r.corrected_exclusive = to_duration(
+                saturating_sub( exclusive, t.calls * window + t.child_calls * outside ) );
+            r.corrected_inclusive = r.corrected_exclusive;
+            result.push_back( std::move( r ) );
+        }
+        // in reverse path order every nested path comes before its parent
+        std::map<std::string, std::size_t> index;
+        for ( std::size_t k = 0; k < result.size(); ++k )
+        {
+            index.emplace( result[k].path, k );
+        }
+        for ( std::size_t k = result.size(); k-- > 0; )
+        {
+            std::size_t separator = result[k].path.rfind( ';' );
+            if ( separator == std::string::npos )
+            {
+                continue;
+            }
+            auto parent = index.find( result[k].path.substr( 0, separator ) );
+            if ( parent != index.end() )
+            {
+                result[parent->second].corrected_inclusive += result[k].corrected_inclusive;
+            }
+        }
+        return result;
+    }
+
+    //! instrumentation overhead of every thread that entered a scope
+    //! @details exited threads are reported together in one entry
+    std::vector<thread_report> thread_overhead( ) const
+    {
+        const std::uint64_t overhead = overhead_.load( std::memory_order_relaxed );
+        std::vector<thread_report> result;
+        std::lock_guard<std::mutex> guard( lock_ );
+        for ( const auto& tree : trees_ )
+        {
+            std::uint64_t scopes = tree.second->scopes();
+            thread_report r;
+            r.thread = tree.first;
+            r.scopes = scopes;
+            r.instrumented = to_duration( tree.second->at( root ).children.load( std::memory_order_relaxed ) );
+            r.overhead = to_duration( scopes * overhead );
+            result.push_back( r );
+        }
+        if ( exited_.threads > 0 )
+        {
+            thread_report r;
+            r.thread = std::thread::id();
+            r.scopes = exited_.scopes;
+            r.instrumented = to_duration( exited_.instrumented );
+            r.overhead = to_duration( exited_.scopes * overhead );
+            result.push_back( r );
+        }
+        return result;
+    }
+
+    //! measure the scope overhead
+    //! @details Times `iterations` empty scopes of a separate profiler on the
+    //!  calling thread, in ten batches. The time per scope seen from outside
+    //!  is the whole overhead; the time an empty scope records for itself is
+    //!  the window overhead. The lowest batch mean of each is kept, so that
+    //!  interruptions and cold caches do not inflate them.
+    void calibrate( std::size_t iterations = 1000 )
+    {
+        if ( iterations == 0 )
+        {
+            return;
+        }
+        const std::size_t batches = 10;
+        const std::size_t batch_size = ( iterations + batches - 1 ) / batches;
+        scope_profiler probe( 1, 0 );
+        {
+            scope warm_up( probe, "calibration" );
+        }
+        std::uint64_t best = static_cast<std::uint64_t>( -1 );
+        std::uint64_t best_window = static_cast<std::uint64_t>( -1 );
+        for ( std::size_t b = 0; b < batches; ++b )
+        {
+            probe.reset();
+            time_point start = ClockType::now();
+            for ( std::size_t k = 0; k < batch_size; ++k )
+            {
+                scope empty( probe, "calibration" );
+            }
+            auto elapsed = ( ClockType::now() - start ).count();
+            best = std::min( best, static_cast<std::uint64_t>( elapsed > 0 ? elapsed : 0 ) / batch_size );
+            std::uint64_t recorded = static_cast<std::uint64_t>( probe.report().front().inclusive.count() );
+            best_window = std::min( best_window, recorded / batch_size );
+        }
+        overhead_.store( best, std::memory_order_relaxed );
+        window_overhead_.store( std::min( best_window, best ), std::memory_order_relaxed );
+    }
+
+    //! estimated time one scope adds to the measured times, its own and its
+    //! enclosing scopes' together
+    duration scope_overhead( ) const
+    {
+        return to_duration( overhead_.load( std::memory_order_relaxed ) );
+    }
+
+    //! estimated part of the scope overhead between a scope's own clock
+    //! readings, which inflates the scope's own time
+    duration window_overhead( ) const
+    {
+        return to_duration( window_overhead_.load( std::memory_order_relaxed ) );
+    }
+
+    //! set the scope overhead, instead of measuring it
+    //! @param overhead  time one scope adds to the measured times
+    //! @param window    part of `overhead` between the scope's own clock
+    //!  readings; clamped to `overhead`
+    template< class Rep, class Period, class Rep2 = rep, class Period2 = period >
+    void set_scope_overhead( std::chrono::duration<Rep, Period> overhead,
+                             std::chrono::duration<Rep2, Period2> window = std::chrono::duration<Rep2, Period2>::zero() )
+    {
+        auto ticks = std::chrono::duration_cast<duration>( overhead ).count();
+        auto window_ticks = std::chrono::duration_cast<duration>( window ).count();
+        std::uint64_t total = static_cast<std::uint64_t>( ticks > 0 ? ticks : 0 );
+        std::uint64_t inside = static_cast<std::uint64_t>( window_ticks > 0 ? window_ticks : 0 );
+        overhead_.store( total, std::memory_order_relaxed );
+        window_overhead_.store( std::min( inside, total ), std::memory_order_relaxed );
+    }
+
+    //! number of scopes not recorded because a thread's tree was full
+    std::uint64_t dropped( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        std::uint64_t result = exited_.dropped;
+        for ( const auto& tree : trees_ )
+        {
+            result += tree.second->dropped.load( std::memory_order_relaxed );
+        }
+        return result;
+    }
+
+    //! maximum number of distinct paths recorded per thread
+    std::size_t max_nodes( ) const
+    {
+        return max_nodes_;
+    }
+
+    //! discard the recorded times; the recorded paths of running threads are kept
+    void reset( )
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        for ( const auto& tree : trees_ )
+        {
+            tree.second->reset();
+        }
+        exited_ = exited_totals();
+    }
+
+private:
+    static constexpr std::uint32_t root = 0;
+    static constexpr std::uint32_t no_node = static_cast<std::uint32_t>( -1 );
+
+    struct node
+    {
+        const char* name;
+        std::uint32_t parent;
+        std::atomic<std::uint64_t> calls;
+        std::atomic<std::uint64_t> inclusive;
+        std::atomic<std::uint64_t> children;
+        //! completed scopes directly nested in this path
+        std::atomic<std::uint64_t> child_calls;
+        //! completed scopes nested any depth below this path
+        std::atomic<std::uint64_t> descendants;
+
+        node( )
+            : name( nullptr )
+            , parent( no_node )
+            , calls( 0 )
+            , inclusive( 0 )
+            , children( 0 )
+            , child_calls( 0 )
+            , descendants( 0 )
+        {}
+    };
+
+    struct path_totals
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t inclusive = 0;
+        std::uint64_t children = 0;
+        std::uint64_t child_calls = 0;
+        std::uint64_t descendants = 0;
+    };
+
+    //! totals of the threads whose trees were merged at thread exit
+    struct exited_totals
+    {
+        std::map<std::string, path_totals> paths;
+        std::uint64_t threads = 0;
+        std::uint64_t scopes = 0;
+        std::uint64_t instrumented = 0;
+        std::uint64_t dropped = 0;
+    };
+
+    //! one thread's prefix tree; only the owning thread adds nodes or moves
+    //! `current`, other threads only read published nodes
+    struct thread_tree
+    {
+        static constexpr std::uint32_t chunk_size = 64;
+
+        //! nodes in chunks of `chunk_size`, allocated as the tree grows so
+        //! that published nodes never move
+        std::unique_ptr< std::atomic<node*>[] > chunks;
+        std::atomic<std::uint32_t> node_count;
+        const std::uint32_t capacity;
+        //! open addressing table of node indexes keyed by (parent, name),
+        //! doubled whenever it gets half full
+        std::vector<std::uint32_t> table;
+        std::uint32_t current;
+        //! depth of nested scopes below a scope that could not be recorded
+        std::uint32_t dropped_depth;
+        std::atomic<std::uint64_t> dropped;
+        //! scopes completed on the thread, including dropped ones; never reset
+        //! since open scopes count their descendants from it
+        std::atomic<std::uint64_t> completed;
+
+        explicit thread_tree( std::size_t max_nodes )
+            : chunks( new std::atomic<node*>[ ( max_nodes + chunk_size - 1 ) / chunk_size ] )
+            , node_count( 1 )
+            , capacity( static_cast<std::uint32_t>( max_nodes ) )
+            , table( 16, no_node )
+            , current( root )
+            , dropped_depth( 0 )
+            , dropped( 0 )
+            , completed( 0 )
+        {
+            for ( std::uint32_t c = 0; c < chunk_count(); ++c )
+            {
+                chunks[c].store( nullptr, std::memory_order_relaxed );
+            }
+            chunks[0].store( new node[chunk_size], std::memory_order_relaxed );
+        }
+
+        thread_tree( const thread_tree& ) = delete;
+        thread_tree& operator=( const thread_tree& ) = delete;
+
+        ~thread_tree( )
+        {
+            for ( std::uint32_t c = 0; c < chunk_count(); ++c )
+            {
+                delete[] chunks[c].load( std::memory_order_relaxed );
+            }
+        }
+
+        std::uint32_t chunk_count( ) const
+        {
+            return ( capacity + chunk_size - 1 ) / chunk_size;
+        }
+
+        //! published node `index`
+        node& at( std::uint32_t index ) const
+        {
+            return chunks[index / chunk_size].load( std::memory_order_acquire )[index % chunk_size];
+        }
+
+        //! enter a scope below the current one
+        //! @returns  the scope's node, or `no_node` if it could not be recorded
+        std::uint32_t enter( const char* name )
+        {
+            std::uint32_t child = ( dropped_depth == 0 ) ? find_or_add( current, name ) : no_node;
+            if ( child == no_node )
+            {
+                // scopes nested in a dropped scope are dropped too
+                ++dropped_depth;
+                dropped.fetch_add( 1, std::memory_order_relaxed );
+                return no_node;
+            }
+            current = child;
+            return child;
+        }
+
+        //! leave the scope entered as `index`
+        //! @param completed_at_start  value of `completed` when the scope was entered
+        void leave( std::uint32_t index, std::uint64_t elapsed, std::uint64_t completed_at_start )
+        {
+            std::uint64_t done = completed.load( std::memory_order_relaxed );
+            completed.store( done + 1, std::memory_order_relaxed );
+            if ( index == no_node )
+            {
+                --dropped_depth;
+                return;
+            }
+            node& n = at( index );
+            n.calls.fetch_add( 1, std::memory_order_relaxed );
+            n.inclusive.fetch_add( elapsed, std::memory_order_relaxed );
+            n.descendants.fetch_add( done - completed_at_start, std::memory_order_relaxed );
+            node& parent = at( n.parent );
+            parent.children.fetch_add( elapsed, std::memory_order_relaxed );
+            parent.child_calls.fetch_add( 1, std::memory_order_relaxed );
+            current = n.parent;
+        }
+
+        std::uint32_t find_or_add( std::uint32_t parent, const char* name )
+        {
+            std::size_t slot = 0;
+            std::uint32_t index = find( parent, name, slot );
+            if ( index != no_node )
+            {
+                return index;
+            }
+            index = node_count.load( std::memory_order_relaxed );
+            if ( index >= capacity )
+            {
+                return no_node;
+            }
+            if ( index % chunk_size == 0 )
+            {
+                chunks[index / chunk_size].store( new node[chunk_size], std::memory_order_release );
+            }
+            node& n = at( index );
+            n.name = name;
+            n.parent = parent;
+            table[slot] = index;
+            node_count.store( index + 1, std::memory_order_release );
+            if ( 2 * ( index + 1 ) > table.size() )
+            {
+                grow_table();
+            }
+            return index;
+        }
+
+        //! @param slot  set to the table slot of the node, or to the free slot it would take
+        //! @returns  the node of `name` below `parent`, or `no_node`
+        std::uint32_t find( std::uint32_t parent, const char* name, std::size_t& slot ) const
+        {
+            std::size_t mask = table.size() - 1;
+            slot = hash( parent, name ) & mask;
+            for ( ;; )
+            {
+                std::uint32_t index = table[slot];
+                if ( index == no_node )
+                {
+                    return no_node;
+                }
+                const node& n = at( index );
+                if ( n.parent == parent && ( n.name == name || std::strcmp( n.name, name ) == 0 ) )
+                {
+                    return index;
+                }
+                slot = ( slot + 1 ) & mask;
+            }
+        }
+
+        void grow_table( )
+        {
+            table.assign( 2 * table.size(), no_node );
+            std::uint32_t count = node_count.load( std::memory_order_relaxed );
+            for ( std::uint32_t k = 1; k < count; ++k )
+            {
+                const node& n = at( k );
+                std::size_t slot = 0;
+                find( n.parent, n.name, slot );
+                table[slot] = k;
+            }
+        }
+
+        static std::size_t hash( std::uint32_t parent, const char* name )
+        {
+            // FNV-1a over the name, so equal names at different addresses collide
+            std::uint64_t h = 0xcbf29ce484222325ull ^ parent;
+            for ( const char* c = name; *c != '\0'; ++c )
+            {
+                h = ( h ^ static_cast<unsigned char>( *c ) ) * 0x100000001b3ull;
+            }
+            return static_cast<std::size_t>( h ^ ( h >> 32 ) );
+        }
+
+        //! add the totals of every path to `paths`
+        void collect( std::map<std::string, path_totals>& paths ) const
+        {
+            std::uint32_t count = node_count.load( std::memory_order_acquire );
+            std::vector<std::string> names( count );
+            for ( std::uint32_t k = 1; k < count; ++k )
+            {
+                const node& n = at( k );
+                // parents are always added before their children
+                names[k] = ( n.parent == root ) ? std::string( n.name ) : names[n.parent] + ';' + n.name;
+                std::uint64_t calls = n.calls.load( std::memory_order_relaxed );
+                if ( calls != 0 )
+                {
+                    path_totals& t = paths[names[k]];
+                    t.calls += calls;
+                    t.inclusive += n.inclusive.load( std::memory_order_relaxed );
+                    t.children += n.children.load( std::memory_order_relaxed );
+                    t.child_calls += n.child_calls.load( std::memory_order_relaxed );
+                    t.descendants += n.descendants.load( std::memory_order_relaxed );
+                }
+            }
+        }
+
+        //! number of completed scopes since the last reset, including dropped ones
+        std::uint64_t scopes( ) const
+        {
+            std::uint64_t result = dropped.load( std::memory_order_relaxed );
+            std::uint32_t count = node_count.load( std::memory_order_acquire );
+            for ( std::uint32_t k = 1; k < count; ++k )
+            {
+                result += at( k ).calls.load( std::memory_order_relaxed );
+            }
+            return result;
+        }
+
+        void reset( )
+        {
+            std::uint32_t count = node_count.load( std::memory_order_acquire );
+            for ( std::uint32_t k = 0; k < count; ++k )
+            {
+                node& n = at( k );
+                n.calls.store( 0, std::memory_order_relaxed );
+                n.inclusive.store( 0, std::memory_order_relaxed );
+                n.children.store( 0, std::memory_order_relaxed );
+                n.child_calls.store( 0, std::memory_order_relaxed );
+                n.descendants.store( 0, std::memory_order_relaxed );
+            }
+            dropped.store( 0, std::memory_order_relaxed );
+        }
+    };
+
+    //! tree of a profiler cached by a thread
+    struct cache_entry
+    {
+        std::uint64_t owner_id;
+        thread_tree* tree;
+    };
+
+    struct local_cache
+    {
+        cache_entry entries[local_slots];
+    };
+
+    //! profilers a thread has a tree in; merges the trees into their
+    //! profilers' exited totals when the thread exits
+    struct exit_hook
+    {
+        std::vector<std::uint64_t> profilers;
+
+        ~exit_hook( )
+        {
+            for ( auto& entry : local_cache_.entries )
+            {
+                entry = cache_entry{ 0, nullptr };
+            }
+            std::lock_guard<std::mutex> guard( registry_lock() );
+            for ( std::uint64_t id : profilers )
+            {
+                auto found = registry().find( id );
+                if ( found != registry().end() )
+                {
+                    found->second->retire( std::this_thread::get_id() );
+                }
+            }
+        }
+    };
+
+    static thread_local local_cache local_cache_;
+    static thread_local exit_hook exit_hook_;
+
+    const std::uint64_t id_;
+    const std::size_t slot_;
+    const std::size_t max_nodes_;
+    std::atomic<std::uint64_t> overhead_;
+    std::atomic<std::uint64_t> window_overhead_;
+    mutable std::mutex lock_;
+    std::map< std::thread::id, std::unique_ptr<thread_tree> > trees_;
+    exited_totals exited_;
+
+    static std::uint64_t saturating_sub( std::uint64_t a, std::uint64_t b )
+    {
+        return ( a > b ) ? a - b : 0;
+    }
+
+    static duration to_duration( std::uint64_t ticks )
+    {
+        return duration( static_cast<rep>( ticks ) );
+    }
+
+    static void add( path_totals& to, const path_totals& from )
+    {
+        to.calls += from.calls;
+        to.inclusive += from.inclusive;
+        to.children += from.children;
+        to.child_calls += from.child_calls;
+        to.descendants += from.descendants;
+    }
+
+    static std::uint64_t next_id( )
+    {
+        static std::atomic<std::uint64_t> counter( 0 );
+        return counter.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    }
+
+    //! live profilers by identifier, so that a thread exit never touches a destroyed one
+    static std::map<std::uint64_t, scope_profiler*>& registry( )
+    {
+        static std::map<std::uint64_t, scope_profiler*> profilers;
+        return profilers;
+    }
+
+    static std::mutex& registry_lock( )
+    {
+        static std::mutex lock;
+        return lock;
+    }
+
+    thread_tree* local_tree( )
+    {
+        cache_entry& cached = local_cache_.entries[slot_];
+        if ( cached.owner_id == id_ )
+        {
+            return cached.tree;
+        }
+        bool created = false;
+        {
+            std::lock_guard<std::mutex> guard( lock_ );
+            auto& tree = trees_[ std::this_thread::get_id() ];
+            if ( ! tree )
+            {
+                // one more node for the root
+                tree.reset( new thread_tree( max_nodes_ + 1 ) );
+                created = true;
+            }
+            cached.owner_id = id_;
+            cached.tree = tree.get();
+        }
+        if ( created )
+        {
+            // not under `lock_`, since the exit hook locks the registry first
+            std::lock_guard<std::mutex> guard( registry_lock() );
+            auto& profilers = exit_hook_.profilers;
+            profilers.erase( std::remove_if( profilers.begin(), profilers.end(),
+                                 []( std::uint64_t id ) { return registry().count( id ) == 0; } ),
+                             profilers.end() );
+            profilers.push_back( id_ );
+        }
+        return cached.tree;
+    }
+
+    //! merge the tree of an exiting thread into the exited totals and free it
+    void retire( std::thread::id thread )
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        auto found = trees_.find( thread );
+        if ( found == trees_.end() )
+        {
+            return;
+        }
+        const thread_tree& tree = *found->second;
+        tree.collect( exited_.paths );
+        ++exited_.threads;
+        exited_.scopes += tree.scopes();
+        exited_.instrumented += tree.at( root ).children.load( std::memory_order_relaxed );
+        exited_.dropped += tree.dropped.load( std::memory_order_relaxed );
+        trees_.erase( found );
+    }
+};
+
+template< class ClockType >
+constexpr std::size_t scope_profiler<ClockType>::local_slots;
+template< class ClockType >
+constexpr std::uint32_t scope_profiler<ClockType>::root;
+template< class ClockType >
+constexpr std::uint32_t scope_profiler<ClockType>::no_node;
+template< class ClockType >
+constexpr std::uint32_t scope_profiler<ClockType>::thread_tree::chunk_size;
+template< class ClockType >
+thread_local typename scope_profiler<ClockType>::local_cache scope_profiler<ClockType>::local_cache_;
+template< class ClockType >
+thread_local typename scope_profiler<ClockType>::exit_hook scope_profiler<ClockType>::exit_hook_;
+
+}
+
+#endif
@@ -0,0 +1,582 @@
+//
+//  shm_export.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef shm_export_h
+#define shm_export_h
+
+#include "uteki/cpu_relax.h"
+#include "uteki/latency_histogram.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace uteki
+{
+
+//! timer aggregates of one shared memory record, in nanoseconds
+struct shm_stats
+{
+    //! number of measurements
+    std::uint64_t count;
+    //! sum of the measurements
+    std::uint64_t total_ns;
+    //! smallest measurement
+    std::uint64_t min_ns;
+    //! largest measurement
+    std::uint64_t max_ns;
+    //! median
+    std::uint64_t p50_ns;
+    //! 90th percentile
+    std::uint64_t p90_ns;
+    //! 99th percentile
+    std::uint64_t p99_ns;
+    //! 99.9th percentile
+    std::uint64_t p999_ns;
+};
+
+//! consistent copy of one shared memory record
+struct shm_snapshot
+{
+    //! maximum name length, including the terminating null
+    static constexpr std::size_t name_size = 48;
+
+    //! record name, null terminated
+    char name[name_size];
+    //! number of times the record was published
+    std::uint64_t generation;
+    //! aggregates as of the last publication
+    shm_stats stats;
+};
+
+namespace detail
+{
+
+// Layout of the segment: one header followed by `capacity` records. Every
+// field is a lock-free atomic so that both processes access it without data
+// races; the atomics used are address-free on all supported platforms.
+struct shm_header
+{
+    static constexpr std::uint64_t magic_value = 0x7574656b69736d31ULL; // "utekism1"
+    static constexpr std::uint32_t layout_version = 1;
+
+    std::atomic<std::uint64_t> magic;
+    std::atomic<std::uint32_t> version;
+    std::atomic<std::uint32_t> record_size;
+    std::atomic<std::uint32_t> capacity;
+    std::atomic<std::uint32_t> record_count;
+    std::atomic<std::uint32_t> writer_pid;
+    std::atomic<std::uint32_t> reserved;
+    char padding[32];
+};
+
+struct shm_record
+{
+    // seqlock: odd while the record is being written
+    std::atomic<std::uint32_t> sequence;
+    std::atomic<std::uint32_t> reserved;
+    std::atomic<char> name[shm_snapshot::name_size];
+    std::atomic<std::uint64_t> stats[sizeof( shm_stats ) / sizeof( std::uint64_t )];
+    std::atomic<std::uint64_t> padding[1];
+};
+
+static_assert( sizeof( shm_stats ) == 8 * sizeof( std::uint64_t ), "shm_stats must be eight unpadded fields" );
+static_assert( sizeof( shm_header ) == 64, "unexpected shared memory header size" );
+static_assert( sizeof( shm_record ) == 128, "unexpected shared memory record size" );
+
+inline std::string shm_object_name( const std::string& name )
+{
+    return ( ! name.empty() && name[0] == '/' ) ? name : "/" + name;
+}
+
+inline bool shm_fail( std::string* error, const std::string& what )
+{
+    if ( error != nullptr )
+    {
+        *error = what + ": " + std::strerror( errno );
+    }
+    return false;
+}
+
+}
+
+//! shared memory exporter class
+//! @details Publishes timer aggregates into a named POSIX shared memory
+//! segment, so that another process can read them with `shm_reader` or the
+//! `uteki_shm_reader` tool without the measured process doing any I/O or
+//! system call. The segment holds a versioned header and a fixed number of
+//! named records. Each record is protected by a seqlock: `publish()` is a
+//! handful of stores, never blocks, and a reader retries when it observes a
+//! record being written. Records are added with `add()` before or during
+//! measurement; each record must be published by one thread at a time.
+//! The segment is removed when the exporter is closed or destroyed.
+//!
+//!  \snippet test_shm_export.cpp publish shm_export example
+class shm_exporter
+{
+public:
+    //! index returned by `add()` when the segment is full
+    static constexpr std::size_t no_record = static_cast<std::size_t>( -1 );
+
+    //! constructor, no segment is open
+    shm_exporter( )
+        : header_( nullptr )
+        , records_( nullptr )
+        , size_( 0 )
+        , name_( )
+        , identity_( )
+    {}
+
+    shm_exporter( const shm_exporter& ) = delete;
+    shm_exporter& operator=( const shm_exporter& ) = delete;
+
+    //! destructor, removes the segment
+    ~shm_exporter( )
+    {
+        close();
+    }
+
+    //! create the segment, unlinking any existing segment of the same name; readers
+    //! still attached to the old segment keep reading it until they reopen
+    //! @param name      segment name, with or without the leading '/'
+    //! @param capacity  maximum number of records
+    //! @param error     receives a description of the problem if creation fails
+    //! @returns  `true` on success
+    bool open( const std::string& name, std::size_t capacity, std::string* error = nullptr )
+    {
+        close();
+        std::string object = detail::shm_object_name( name );
+        std::size_t size = sizeof( detail::shm_header ) + capacity * sizeof( detail::shm_record );
+        // unlink rather than truncate: processes that still map an existing
+        // segment of this name keep it intact until they unmap it
+        ::shm_unlink( object.c_str() );
+        int fd = ::shm_open( object.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600 );
+        if ( fd < 0 )
+        {
+            return detail::shm_fail( error, object + ": shm_open" );
+        }
+        if ( ::fstat( fd, &identity_ ) != 0 )
+        {
+            detail::shm_fail( error, object + ": fstat" );
+            ::close( fd );
+            ::shm_unlink( object.c_str() );
+            return false;
+        }
+        if ( ::ftruncate( fd, static_cast<off_t>( size ) ) != 0 )
+        {
+            detail::shm_fail( error, object + ": ftruncate" );
+            ::close( fd );
+            ::shm_unlink( object.c_str() );
+            return false;
+        }
+        void* memory = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        ::close( fd );
+        if ( memory == MAP_FAILED )
+        {
+            detail::shm_fail( error, object + ": mmap" );
+            ::shm_unlink( object.c_str() );
+            return false;
+        }
+
+        // the segment is zero filled; the magic is stored last so that a
+        // reader never accepts a partly initialised header
+        header_ = new ( memory ) detail::shm_header();
+        records_ = reinterpret_cast<detail::shm_record*>( static_cast<char*>( memory ) + sizeof( detail::shm_header ) );
+        for ( std::size_t k = 0; k < capacity; ++k )
+        {
+            new ( &records_[k] ) detail::shm_record();
+        }
+        size_ = size;
+        name_ = object;
+        header_->version.store( detail::shm_header::layout_version, std::memory_order_relaxed );
+        header_->record_size.store( sizeof( detail::shm_record ), std::memory_order_relaxed );
+        header_->capacity.store( static_cast<std::uint32_t>( capacity ), std::memory_order_relaxed );
+        header_->record_count.store( 0, std::memory_order_relaxed );
+        header_->writer_pid.store( static_cast<std::uint32_t>( ::getpid() ), std::memory_order_relaxed );
+        header_->magic.store( detail::shm_header::magic_value, std::memory_order_release );
+        return true;
+    }
+
+    //! unmap and remove the segment
+    void close( )
+    {
+        if ( header_ != nullptr )
+        {
+            ::munmap( header_, size_ );
+            // leave the name alone if a newer writer has replaced the segment
+            int fd = ::shm_open( name_.c_str(), O_RDONLY, 0 );
+            if ( fd >= 0 )
+            {
+                struct stat current;
+                bool same = ::fstat( fd, &current ) == 0 &&
+                    current.st_dev == identity_.st_dev && current.st_ino == identity_.st_ino;
+                ::close( fd );
+                if ( same )
+                {
+                    ::shm_unlink( name_.c_str() );
+                }
+            }
+            header_ = nullptr;
+            records_ = nullptr;
+            size_ = 0;
+            name_.clear();
+        }
+    }
+
+    //! is a segment open
+    bool is_open( ) const
+    {
+        return header_ != nullptr;
+    }
+
+    //! shared memory object name, with the leading '/'
+    const std::string& name( ) const
+    {
+        return name_;
+    }
+
+    //! maximum number of records
+    std::size_t capacity( ) const
+    {
+        return ( header_ != nullptr ) ? header_->capacity.load( std::memory_order_relaxed ) : 0;
+    }
+
+    //! number of records added
+    std::size_t size( ) const
+    {
+        return ( header_ != nullptr ) ? header_->record_count.load( std::memory_order_relaxed ) : 0;
+    }
+
+    //! add a record
+    //! @param name  record name, truncated to `shm_snapshot::name_size - 1` characters
+    //! @returns  record index for `publish()`, or `no_record` if the segment is full or not open
+    std::size_t add( const char* name )
+    {
+        if ( header_ == nullptr )
+        {
+            return no_record;
+        }
+        std::uint32_t index = header_->record_count.load( std::memory_order_relaxed );
+        do
+        {
+            if ( index >= header_->capacity.load( std::memory_order_relaxed ) )
+            {
+                return no_record;
+            }
+        }
+        while ( ! header_->record_count.compare_exchange_weak( index, index + 1, std::memory_order_relaxed ) );
+
+        detail::shm_record& r = records_[index];
+        begin_write( r );
+        std::size_t k = 0;
+        for ( ; k + 1 < shm_snapshot::name_size && name[k] != '\0'; ++k )
+        {
+            r.name[k].store( name[k], std::memory_order_relaxed );
+        }
+        r.name[k].store( '\0', std::memory_order_relaxed );
+        end_write( r );
+        return index;
+    }
+
+    //! publish the aggregates of a record
+    //! @param index  record index returned by `add()`; `no_record` or an
+    //!  index out of range publishes nothing
+    void publish( std::size_t index, const shm_stats& stats )
+    {
+        if ( index >= capacity() )
+        {
+            return;
+        }
+        detail::shm_record& r = records_[index];
+        std::uint64_t values[stat_count];
+        std::memcpy( values, &stats, sizeof( values ) );
+        begin_write( r );
+        for ( std::size_t k = 0; k < stat_count; ++k )
+        {
+            r.stats[k].store( values[k], std::memory_order_relaxed );
+        }
+        end_write( r );
+    }
+
+    //! publish the aggregates of a latency histogram
+    //! @param index      record index returned by `add()`
+    //! @param histogram  histogram to summarise
+    template< class Duration >
+    void publish( std::size_t index, const latency_histogram<Duration>& histogram )
+    {
+        publish( index, summarize( histogram ) );
+    }
+
+    //! aggregates of a latency histogram
+    template< class Duration >
+    static shm_stats summarize( const latency_histogram<Duration>& histogram )
+    {
+        auto ns = []( Duration d ) {
+            return static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( d ).count() );
+        };
+        shm_stats stats;
+        stats.count = histogram.count();
+        stats.total_ns = ns( histogram.sum() );
+        stats.min_ns = ns( histogram.min() );
+        stats.max_ns = ns( histogram.max() );
+        stats.p50_ns = ns( histogram.percentile( 50.0 ) );
+        stats.p90_ns = ns( histogram.percentile( 90.0 ) );
+        stats.p99_ns = ns( histogram.percentile( 99.0 ) );
+        stats.p999_ns = ns( histogram.percentile( 99.9 ) );
+        return stats;
+    }
+
+private:
+    static constexpr std::size_t stat_count = sizeof( shm_stats ) / sizeof( std::uint64_t );
+
+    detail::shm_header* header_;
+    detail::shm_record* records_;
+    std::size_t size_;
+    std::string name_;
+    struct stat identity_;
+
+    static void begin_write( detail::shm_record& r )
+    {
+        r.sequence.store( r.sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+    }
+
+    static void end_write( detail::shm_record& r )
+    {
+        r.sequence.store( r.sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+};
+
+//! shared memory reader class
+//! @details Attaches read-only to a segment created by `shm_exporter`,
+//! possibly in another process, and takes consistent snapshots of its
+//! records. Reading never writes to the segment, so any number of readers
+//! can attach without disturbing the writer.
+class shm_reader
+{
+public:
+    //! constructor, no segment is attached
+    shm_reader( )
+        : header_( nullptr )
+        , records_( nullptr )
+        , size_( 0 )
+        , name_( )
+        , identity_( )
+    {}
+
+    shm_reader( const shm_reader& ) = delete;
+    shm_reader& operator=( const shm_reader& ) = delete;
+
+    //! destructor, detaches from the segment
+    ~shm_reader( )
+    {
+        close();
+    }
+
+    //! attach to a segment
+    //! @param name   segment name, with or without the leading '/'
+    //! @param error  receives a description of the problem if attaching fails
+    //! @returns  `true` on success
+    bool open( const std::string& name, std::string* error = nullptr )
+    {
+        close();
+        std::string object = detail::shm_object_name( name );
+        int fd = ::shm_open( object.c_str(), O_RDONLY, 0 );
+        if ( fd < 0 )
+        {
+            return detail::shm_fail( error, object + ": shm_open" );
+        }
+        struct stat status;
+        if ( ::fstat( fd, &status ) != 0 )
+        {
+            detail::shm_fail( error, object + ": fstat" );
+            ::close( fd );
+            return false;
+        }
+        std::size_t size = static_cast<std::size_t>( status.st_size );
+        if ( size < sizeof( detail::shm_header ) )
+        {
+            ::close( fd );
+            return invalid( error, object + ": segment too small" );
+        }
+        void* memory = ::mmap( nullptr, size, PROT_READ, MAP_SHARED, fd, 0 );
+        ::close( fd );
+        if ( memory == MAP_FAILED )
+        {
+            return detail::shm_fail( error, object + ": mmap" );
+        }
+        header_ = static_cast<const detail::shm_header*>( memory );
+        records_ = reinterpret_cast<const detail::shm_record*>( static_cast<const char*>( memory ) + sizeof( detail::shm_header ) );
+        size_ = size;
+        name_ = object;
+        identity_ = status;
+
+        if ( header_->magic.load( std::memory_order_acquire ) != detail::shm_header::magic_value )
+        {
+            close();
+            return invalid( error, object + ": not a uteki shared memory segment" );
+        }
+        std::uint32_t version = header_->version.load( std::memory_order_relaxed );
+        if ( version != detail::shm_header::layout_version
+             || header_->record_size.load( std::memory_order_relaxed ) != sizeof( detail::shm_record ) )
+        {
+            close();
+            return invalid( error, object + ": unsupported layout version " + std::to_string( version ) );
+        }
+        if ( sizeof( detail::shm_header ) + capacity() * sizeof( detail::shm_record ) > size_ )
+        {
+            close();
+            return invalid( error, object + ": segment truncated" );
+        }
+        return true;
+    }
+
+    //! detach from the segment
+    void close( )
+    {
+        if ( header_ != nullptr )
+        {
+            ::munmap( const_cast<detail::shm_header*>( header_ ), size_ );
+            header_ = nullptr;
+            records_ = nullptr;
+            size_ = 0;
+            name_.clear();
+        }
+    }
+
+    //! has the attached segment been removed or replaced by a newer writer
+    //! @details a replaced segment keeps its last values; open the name
+    //!  again to follow the new writer
+    bool replaced( ) const
+    {
+        if ( header_ == nullptr )
+        {
+            return false;
+        }
+        int fd = ::shm_open( name_.c_str(), O_RDONLY, 0 );
+        if ( fd < 0 )
+        {
+            return true;
+        }
+        struct stat current;
+        bool same = ::fstat( fd, &current ) == 0 &&
+            current.st_dev == identity_.st_dev && current.st_ino == identity_.st_ino;
+        ::close( fd );
+        return ! same;
+    }
+
+    //! is a segment attached
+    bool is_open( ) const
+    {
+        return header_ != nullptr;
+    }
+
+    //! process id of the writer
+    std::uint32_t writer_pid( ) const
+    {
+        return header_->writer_pid.load( std::memory_order_relaxed );
+    }
+
+    //! maximum number of records
+    std::size_t capacity( ) const
+    {
+        return header_->capacity.load( std::memory_order_relaxed );
+    }
+
+    //! number of records added by the writer
+    std::size_t size( ) const
+    {
+        std::size_t n = header_->record_count.load( std::memory_order_relaxed );
+        return ( n < capacity() ) ? n : capacity();
+    }
+
+    //! take a consistent snapshot of a record
+    //! @param index     record index, less than `size()`
+    //! @param snapshot  receives the record
+    //! @param retries   maximum number of attempts while the record is being written
+    //! @returns  `false` if no consistent snapshot was obtained
+    bool read( std::size_t index, shm_snapshot& snapshot, unsigned retries = 1000 ) const
+    {
+        const detail::shm_record& r = records_[index];
+        for ( unsigned attempt = 0; attempt < retries; ++attempt )
+        {
+            std::uint32_t before = r.sequence.load( std::memory_order_acquire );
+            if ( before % 2 != 0 )
+            {
+                cpu_relax();
+                continue;
+            }
+            for ( std::size_t k = 0; k < shm_snapshot::name_size; ++k )
+            {
+                snapshot.name[k] = r.name[k].load( std::memory_order_relaxed );
+            }
+            std::uint64_t values[stat_count];
+            for ( std::size_t k = 0; k < stat_count; ++k )
+            {
+                values[k] = r.stats[k].load( std::memory_order_relaxed );
+            }
+            std::memcpy( &snapshot.stats, values, sizeof( values ) );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( r.sequence.load( std::memory_order_relaxed ) == before )
+            {
+                snapshot.name[shm_snapshot::name_size - 1] = '\0';
+                snapshot.generation = ( before > 2 ) ? ( before - 2 ) / 2 : 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static constexpr std::size_t stat_count = sizeof( shm_stats ) / sizeof( std::uint64_t );
+
+    const detail::shm_header* header_;
+    const detail::shm_record* records_;
+    std::size_t size_;
+    std::string name_;
+    struct stat identity_;
+
+    static bool invalid( std::string* error, const std::string& message )
+    {
+        if ( error != nullptr )
+        {
+            *error = message;
+        }
+        return false;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+//
+//  span_context.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef span_context_h
+#define span_context_h
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace uteki
+{
+
+//! span context class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @tparam MaxStages  maximum number of stage stamps carried by the span
+//! @details Timing context of one request as it moves through a pipeline of
+//! threads. The span holds its start stamp, a parent span id and the stamps of
+//! the stages it has passed. It is a trivially copyable value without locks or
+//! atomics: each stage appends its stamp with `mark()` and hands the span on by
+//! copying it into the next queue. Per-stage and end-to-end durations are
+//! computed from the span alone, with no shared state. A span must not be
+//! modified by two threads at once. Spans are created with `begin()` or
+//! `child()`; a default constructed span is uninitialized.
+//!
+//!  \snippet test_span_context.cpp mark span_context example
+template< class ClockType = std::chrono::steady_clock, std::size_t MaxStages = 8 >
+class span_context
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+    static_assert( MaxStages > 0, "span must hold at least one stage" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+    //! span identifier type
+    using id_type = std::uint64_t;
+    //! stage identifier type
+    using stage_type = std::uint16_t;
+
+    //! maximum number of stage stamps
+    static constexpr std::size_t max_stages = MaxStages;
+
+    //! start a span
+    //! @param id         identifier of the new span
+    //! @param parent_id  identifier of the parent span, or 0 for a root span
+    //! @returns  span started at the current time
+    static span_context begin( id_type id, id_type parent_id = 0 )
+    {
+        span_context span;
+        span.id_ = id;
+        span.parent_id_ = parent_id;
+        span.start_time_ = ClockType::now();
+        span.stage_count_ = 0;
+        return span;
+    }
+
+    //! start a child span of this span
+    //! @param id  identifier of the child span
+    span_context child( id_type id ) const
+    {
+        return begin( id, id_ );
+    }
+
+    //! stamp the end of a stage at the current time
+    //! @param stage  identifier of the stage
+    //! @returns  `false` if the span already holds `max_stages` stamps
+    bool mark( stage_type stage )
+    {
+        return mark( stage, ClockType::now() );
+    }
+
+    //! stamp the end of a stage at a given time
+    //! @param stage  identifier of the stage
+    //! @param when   time the stage ended
+    //! @returns  `false` if the span already holds `max_stages` stamps
+    bool mark( stage_type stage, time_point when )
+    {
+        if ( stage_count_ >= MaxStages )
+        {
+            return false;
+        }
+        stages_[stage_count_] = stage;
+        stamps_[stage_count_] = when;
+        ++stage_count_;
+        return true;
+    }
+
+    //! span identifier
+    id_type id( ) const
+    {
+        return id_;
+    }
+
+    //! parent span identifier, 0 for a root span
+    id_type parent_id( ) const
+    {
+        return parent_id_;
+    }
+
+    //! time the span started
+    time_point start_time( ) const
+    {
+        return start_time_;
+    }
+
+    //! number of stage stamps
+    std::size_t stage_count( ) const
+    {
+        return stage_count_;
+    }
+
+    //! identifier of a stamped stage
+    //! @param index  stamp index, less than `stage_count()`
+    stage_type stage( std::size_t index ) const
+    {
+        return stages_[index];
+    }
+
+    //! time a stage ended
+    //! @param index  stamp index, less than `stage_count()`
+    time_point stage_time( std::size_t index ) const
+    {
+        return stamps_[index];
+    }
+
+    //! duration of a stage
+    //! @param index  stamp index, less than `stage_count()`
+    //! @returns  time from the previous stamp, or from the span start for the
+    //!  first stage, to the stage's stamp
+    template< typename T = duration >
+    T stage_duration( std::size_t index ) const
+    {
+        time_point begin_time = ( index == 0 ) ? start_time_ : stamps_[index - 1];
+        return std::chrono::duration_cast<T>( stamps_[index] - begin_time );
+    }
+
+    //! end-to-end duration up to the last stamp
+    //! @returns  time from the span start to the last stamp, or zero if no
+    //!  stage has been stamped
+    template< typename T = duration >
+    T elapsed( ) const
+    {
+        return ( stage_count_ == 0 )
+            ? T::zero() : std::chrono::duration_cast<T>( stamps_[stage_count_ - 1] - start_time_ );
+    }
+
+    //! get span value
+    //! @returns  time from the span start to now
+    template< typename T = duration >
+    T value( ) const
+    {
+        return std::chrono::duration_cast<T>( ClockType::now() - start_time_ );
+    }
+
+private:
+    id_type id_;
+    id_type parent_id_;
+    time_point start_time_;
+    std::uint32_t stage_count_;
+    stage_type stages_[MaxStages];
+    time_point stamps_[MaxStages];
+};
+
+template< class ClockType, std::size_t MaxStages >
+constexpr std::size_t span_context<ClockType, MaxStages>::max_stages;
+
+}
+
+#endif
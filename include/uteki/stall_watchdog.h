@@ -0,0 +1,571 @@
+//
+//  stall_watchdog.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef stall_watchdog_h
+#define stall_watchdog_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <cerrno>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#define UTEKI_STALL_WATCHDOG_BACKTRACE 1
+#else
+#define UTEKI_STALL_WATCHDOG_BACKTRACE 0
+#endif
+
+namespace uteki
+{
+
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+namespace detail
+{
+
+//! stack capture handshake between a watchdog scanner and the signal handler
+//! @details One request exists per process, in static storage, so a handler
+//! that runs late never touches memory of a finished capture. The scanner
+//! owning the request sets `armed`; the handler records only in the target
+//! thread and only if it is the first to clear `armed`. `in_handler` lets the
+//! scanner wait for a handler that is still recording before it disarms and
+//! reads the frames.
+struct backtrace_request
+{
+    std::atomic<bool> busy;
+    std::atomic<bool> armed;
+    std::atomic<int> in_handler;
+    std::atomic<bool> done;
+    pthread_t target;
+    void** frames;
+    int capacity;
+    int frame_count;
+};
+
+//! the process wide request; zero initialized before any code runs, so the
+//! handler never runs a dynamic initializer
+inline backtrace_request& pending_backtrace( )
+{
+    static backtrace_request request;
+    return request;
+}
+
+inline void backtrace_handler( int )
+{
+    int saved_errno = errno;
+    backtrace_request& request = pending_backtrace();
+    request.in_handler.fetch_add( 1, std::memory_order_seq_cst );
+    if ( request.armed.load( std::memory_order_seq_cst ) &&
+         pthread_equal( request.target, pthread_self() ) &&
+         request.armed.exchange( false, std::memory_order_acq_rel ) )
+    {
+        request.frame_count = ::backtrace( request.frames, request.capacity );
+        request.done.store( true, std::memory_order_release );
+    }
+    request.in_handler.fetch_sub( 1, std::memory_order_seq_cst );
+    errno = saved_errno;
+}
+
+//! install the handler for a signal, once per signal number
+//! @returns  false if the handler cannot be installed for the signal
+inline bool install_backtrace_handler( int signal_number )
+{
+    static std::mutex lock;
+    static std::uint64_t installed = 0;
+    if ( signal_number <= 0 || signal_number >= 64 )
+    {
+        return false;
+    }
+    const std::uint64_t bit = std::uint64_t( 1 ) << signal_number;
+    std::lock_guard<std::mutex> guard( lock );
+    if ( ( installed & bit ) != 0 )
+    {
+        return true;
+    }
+    void* warm_up[1];
+    ::backtrace( warm_up, 1 );
+
+    struct sigaction action;
+    action.sa_handler = &backtrace_handler;
+    sigemptyset( &action.sa_mask );
+    action.sa_flags = SA_RESTART;
+    if ( sigaction( signal_number, &action, nullptr ) != 0 )
+    {
+        return false;
+    }
+    installed |= bit;
+    return true;
+}
+
+}
+#endif
+
+//! stall watchdog class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Detects requests or loop iterations that run longer than a
+//! threshold while they are still in progress. In-flight operations register
+//! their start stamp in a fixed-size contiguous array of slots; registration
+//! and deregistration take a slot from and return it to a lock-free free
+//! list in O(1). A background thread scans the slots at a low frequency with
+//! one clock read per scan and calls the stall callback once for each
+//! operation that has been running longer than the threshold.
+//!
+//! On POSIX systems the watchdog can also capture the call stack of the
+//! stalled thread: the scanner signals the thread, whose signal handler
+//! records its frames with `backtrace()`, and the frames are passed to the
+//! callback. The signal (`SIGUSR2` by default) is reserved for this use once
+//! any watchdog enables stack capture. `backtrace()` is called once at
+//! construction so that the handler does not trigger lazy library loading.
+//!
+//!  \snippet test_stall_watchdog.cpp guard stall_watchdog example
+template< class ClockType = std::chrono::steady_clock >
+class stall_watchdog
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! slot index returned when the registry is full
+    static constexpr std::size_t no_slot = static_cast<std::size_t>( -1 );
+    //! maximum number of captured stack frames
+    static constexpr int max_frames = 64;
+
+    //! description of a stalled operation passed to the stall callback
+    struct stall_report
+    {
+        //! caller defined identifier given at registration
+        std::uint64_t tag;
+        //! time the operation started
+        time_point start;
+        //! how long the operation had been running when it was detected
+        duration elapsed;
+        //! number of captured stack frames, zero if none were captured
+        int frame_count;
+        //! captured return addresses, innermost first
+        void* const* frames;
+    };
+
+    //! stall callback type
+    using callback_type = std::function< void( const stall_report& ) >;
+
+    //! registration of one in-flight operation
+    //! @details Registers on construction and deregisters on destruction.
+    class guard
+    {
+    public:
+        //! constructor
+        //! @param watchdog  watchdog to register with
+        //! @param tag       caller defined identifier reported on a stall
+        explicit guard( stall_watchdog& watchdog, std::uint64_t tag = 0 )
+            : watchdog_( &watchdog )
+            , slot_( watchdog.register_start( tag ) )
+        {}
+
+        //! move constructor
+        guard( guard&& other ) noexcept
+            : watchdog_( other.watchdog_ )
+            , slot_( other.slot_ )
+        {
+            other.slot_ = no_slot;
+        }
+
+        guard( const guard& ) = delete;
+        guard& operator=( const guard& ) = delete;
+
+        //! destructor, deregisters the operation
+        ~guard( )
+        {
+            if ( slot_ != no_slot )
+            {
+                watchdog_->deregister( slot_ );
+            }
+        }
+
+        //! is the operation registered
+        //! @returns  `false` if the registry was full
+        bool is_registered( ) const
+        {
+            return slot_ != no_slot;
+        }
+
+    private:
+        stall_watchdog* watchdog_;
+        std::size_t slot_;
+    };
+
+    //! constructor
+    //! @details starts the scan thread unless `scan_interval` is zero
+    //! @param capacity           maximum number of registered operations
+    //! @param threshold          running time after which an operation is reported
+    //! @param scan_interval      time between scans
+    //! @param on_stall           callback invoked from the scan thread for each stall
+    //! @param capture_backtrace  capture the call stack of stalled threads;
+    //!  ignored if no handler can be installed for `backtrace_signal`
+    //! @param backtrace_signal   signal used to capture the call stack
+    template< class Rep1, class Period1, class Rep2, class Period2 >
+    stall_watchdog( std::size_t capacity,
+                    std::chrono::duration<Rep1, Period1> threshold,
+                    std::chrono::duration<Rep2, Period2> scan_interval,
+                    callback_type on_stall,
+                    bool capture_backtrace = false,
+                    int backtrace_signal = default_backtrace_signal )
+        : slots_( new slot[ capacity > 0 ? capacity : 1 ] )
+        , capacity_( capacity > 0 ? capacity : 1 )
+        , free_head_( 0 )
+        , threshold_( std::chrono::duration_cast<duration>( threshold ) )
+        , interval_( std::chrono::duration_cast<duration>( scan_interval ) )
+        , on_stall_( std::move( on_stall ) )
+        , capture_backtrace_( capture_backtrace && install_handler( backtrace_signal ) )
+        , backtrace_signal_( backtrace_signal )
+        , stalls_( 0 )
+        , lock_( )
+        , wakeup_( )
+        , stopping_( false )
+        , scanner_( )
+    {
+        for ( std::size_t k = 0; k < capacity_; ++k )
+        {
+            slots_[k].next_free.store( static_cast<std::uint32_t>( k + 2 ), std::memory_order_relaxed );
+        }
+        slots_[capacity_ - 1].next_free.store( 0, std::memory_order_relaxed );
+        free_head_.store( 1, std::memory_order_relaxed );
+
+        if ( interval_ > duration::zero() )
+        {
+            scanner_ = std::thread( [this]() { scan_loop(); } );
+        }
+    }
+
+    stall_watchdog( const stall_watchdog& ) = delete;
+    stall_watchdog& operator=( const stall_watchdog& ) = delete;
+
+    //! destructor, stops the scan thread
+    ~stall_watchdog( )
+    {
+        {
+            std::lock_guard<std::mutex> lock( lock_ );
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+        if ( scanner_.joinable() )
+        {
+            scanner_.join();
+        }
+    }
+
+    //! register the start of an operation at the current time
+    //! @param tag  caller defined identifier reported on a stall
+    //! @returns  slot index to pass to `deregister()`, or `no_slot` if the
+    //!  registry is full
+    std::size_t register_start( std::uint64_t tag = 0 )
+    {
+        std::size_t index = pop_free();
+        if ( index == no_slot )
+        {
+            return no_slot;
+        }
+        slot& s = slots_[index];
+        // odd sequence while the slot is being written, even while it is active
+        auto sequence = s.sequence.load( std::memory_order_relaxed );
+        s.sequence.store( sequence + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        s.start.store( ClockType::now().time_since_epoch().count(), std::memory_order_relaxed );
+        s.tag.store( tag, std::memory_order_relaxed );
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+        s.thread = pthread_self();
+#endif
+        s.active.store( true, std::memory_order_relaxed );
+        s.sequence.store( sequence + 2, std::memory_order_release );
+        return index;
+    }
+
+    //! deregister a finished operation
+    //! @param index  slot index returned by `register_start()`
+    void deregister( std::size_t index )
+    {
+        slot& s = slots_[index];
+        s.active.store( false, std::memory_order_release );
+        // a new even sequence ends the registration for the scanner
+        auto sequence = s.sequence.load( std::memory_order_relaxed );
+        s.sequence.store( sequence + 2, std::memory_order_seq_cst );
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+        while ( s.capturing.load( std::memory_order_seq_cst ) )
+        {
+            std::this_thread::yield();
+        }
+#endif
+        push_free( index );
+    }
+
+    //! scan the registered operations once and report new stalls
+    //! @details call directly only when constructed with a zero scan interval
+    //! @returns  number of stalls reported by this scan
+    std::size_t scan( )
+    {
+        auto now_ticks = ClockType::now().time_since_epoch().count();
+        std::size_t reported = 0;
+        for ( std::size_t k = 0; k < capacity_; ++k )
+        {
+            slot& s = slots_[k];
+            if ( ! s.active.load( std::memory_order_acquire ) )
+            {
+                continue;
+            }
+            auto sequence = s.sequence.load( std::memory_order_acquire );
+            if ( ( sequence & 1 ) != 0 || sequence == s.reported_sequence )
+            {
+                continue;
+            }
+            auto start_ticks = s.start.load( std::memory_order_relaxed );
+            auto tag = s.tag.load( std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( s.sequence.load( std::memory_order_relaxed ) != sequence )
+            {
+                continue;
+            }
+            duration elapsed = duration( now_ticks - start_ticks );
+            if ( elapsed <= threshold_ )
+            {
+                continue;
+            }
+            s.reported_sequence = sequence;
+
+            stall_report report{ tag, time_point( duration( start_ticks ) ), elapsed, 0, frames_ };
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+            if ( capture_backtrace_ )
+            {
+                report.frame_count = capture_frames( s, sequence );
+            }
+#endif
+            stalls_.fetch_add( 1, std::memory_order_relaxed );
+            ++reported;
+            if ( on_stall_ )
+            {
+                on_stall_( report );
+            }
+        }
+        return reported;
+    }
+
+    //! number of stalls reported since construction
+    std::uint64_t stalls_reported( ) const
+    {
+        return stalls_.load( std::memory_order_relaxed );
+    }
+
+    //! maximum number of registered operations
+    std::size_t capacity( ) const
+    {
+        return capacity_;
+    }
+
+private:
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+    static constexpr int default_backtrace_signal = SIGUSR2;
+#else
+    static constexpr int default_backtrace_signal = 0;
+#endif
+
+    struct slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        std::atomic<bool> active;
+        std::atomic<typename duration::rep> start;
+        std::atomic<std::uint64_t> tag;
+        std::atomic<std::uint32_t> next_free;
+        std::uint64_t reported_sequence;
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+        pthread_t thread;
+        std::atomic<bool> capturing;
+#endif
+
+        slot( )
+            : sequence( 0 )
+            , active( false )
+            , start( 0 )
+            , tag( 0 )
+            , next_free( 0 )
+            , reported_sequence( 0 )
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+            , thread( )
+            , capturing( false )
+#endif
+        {}
+    };
+
+    std::unique_ptr<slot[]> slots_;
+    const std::size_t capacity_;
+    //! free list head: ABA counter in the upper 32 bits, slot index + 1 in the lower
+    std::atomic<std::uint64_t> free_head_;
+    const duration threshold_;
+    const duration interval_;
+    callback_type on_stall_;
+    const bool capture_backtrace_;
+    const int backtrace_signal_;
+    std::atomic<std::uint64_t> stalls_;
+    std::mutex lock_;
+    std::condition_variable wakeup_;
+    bool stopping_;
+    void* frames_[max_frames];
+    std::thread scanner_;
+
+    //! install the backtrace handler for `signal_number`
+    //! @returns  false if stacks cannot be captured with that signal
+    static bool install_handler( int signal_number )
+    {
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+        return detail::install_backtrace_handler( signal_number );
+#else
+        (void)signal_number;
+        return false;
+#endif
+    }
+
+    std::size_t pop_free( )
+    {
+        auto head = free_head_.load( std::memory_order_acquire );
+        for ( ;; )
+        {
+            auto index_plus_one = static_cast<std::uint32_t>( head );
+            if ( index_plus_one == 0 )
+            {
+                return no_slot;
+            }
+            auto next = slots_[index_plus_one - 1].next_free.load( std::memory_order_relaxed );
+            auto new_head = ( ( head >> 32 ) + 1 ) << 32 | next;
+            if ( free_head_.compare_exchange_weak( head, new_head, std::memory_order_acquire,
+                                                   std::memory_order_acquire ) )
+            {
+                return index_plus_one - 1;
+            }
+        }
+    }
+
+    void push_free( std::size_t index )
+    {
+        auto head = free_head_.load( std::memory_order_relaxed );
+        for ( ;; )
+        {
+            slots_[index].next_free.store( static_cast<std::uint32_t>( head ), std::memory_order_relaxed );
+            auto new_head = ( ( head >> 32 ) + 1 ) << 32 | ( index + 1 );
+            if ( free_head_.compare_exchange_weak( head, new_head, std::memory_order_release,
+                                                   std::memory_order_relaxed ) )
+            {
+                return;
+            }
+        }
+    }
+
+    void scan_loop( )
+    {
+        std::unique_lock<std::mutex> lock( lock_ );
+        while ( ! stopping_ )
+        {
+            wakeup_.wait_for( lock, interval_ );
+            if ( stopping_ )
+            {
+                break;
+            }
+            lock.unlock();
+            scan();
+            lock.lock();
+        }
+    }
+
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+    //! capture the stack of the thread registered in a slot
+    int capture_frames( slot& s, std::uint64_t sequence )
+    {
+        detail::backtrace_request& request = detail::pending_backtrace();
+        if ( request.busy.exchange( true, std::memory_order_acquire ) )
+        {
+            return 0;   // another watchdog is capturing a stack
+        }
+        int frame_count = 0;
+        // deregister() waits while this flag is set, so the registered thread
+        // cannot move on or exit while it is being signalled
+        s.capturing.store( true, std::memory_order_seq_cst );
+        if ( s.sequence.load( std::memory_order_seq_cst ) == sequence )
+        {
+            pthread_t thread = s.thread;
+            if ( s.sequence.load( std::memory_order_acquire ) == sequence )
+            {
+                request.target = thread;
+                request.frames = frames_;
+                request.capacity = max_frames;
+                request.frame_count = 0;
+                request.done.store( false, std::memory_order_relaxed );
+                request.armed.store( true, std::memory_order_seq_cst );
+                if ( pthread_kill( thread, backtrace_signal_ ) == 0 )
+                {
+                    auto give_up = std::chrono::steady_clock::now() + std::chrono::milliseconds( 50 );
+                    while ( ! request.done.load( std::memory_order_acquire ) &&
+                            std::chrono::steady_clock::now() < give_up )
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                // a handler that has not started recording by now leaves the
+                // request alone; wait for one that has
+                request.armed.store( false, std::memory_order_seq_cst );
+                while ( request.in_handler.load( std::memory_order_seq_cst ) != 0 )
+                {
+                    std::this_thread::yield();
+                }
+                if ( request.done.load( std::memory_order_acquire ) )
+                {
+                    frame_count = request.frame_count;
+                }
+            }
+        }
+        s.capturing.store( false, std::memory_order_release );
+        request.busy.store( false, std::memory_order_release );
+        return frame_count;
+    }
+#endif
+};
+
+template< class ClockType >
+constexpr std::size_t stall_watchdog<ClockType>::no_slot;
+template< class ClockType >
+constexpr int stall_watchdog<ClockType>::max_frames;
+template< class ClockType >
+constexpr int stall_watchdog<ClockType>::default_backtrace_signal;
+
+}
+
+#endif
@@ -0,0 +1,331 @@
+//
+//  stopwatch_group.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef stopwatch_group_h
+#define stopwatch_group_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+
+namespace uteki
+{
+
+namespace detail
+{
+
+//! running state and time packed into one word: time in the upper 62 bits,
+//! a stop-in-progress flag in bit 1 and the running flag in bit 0
+//! @details A stop marks the word before it reads the time to freeze and
+//! readers wait out a marked word, so a reader that validated its word
+//! before the mark read its time before the stopper did, and no reading can
+//! exceed the frozen value that follows it.
+struct packed_stopwatch_state
+{
+    static constexpr std::uint64_t running_bit = 1;
+    static constexpr std::uint64_t stopping_bit = 2;
+
+    static std::uint64_t pack( std::int64_t ticks, bool running )
+    {
+        return ( static_cast<std::uint64_t>( ticks ) << 2 ) | ( running ? running_bit : 0u );
+    }
+
+    static std::int64_t ticks( std::uint64_t word )
+    {
+        return static_cast<std::int64_t>( word ) >> 2;
+    }
+
+    static bool running( std::uint64_t word )
+    {
+        return ( word & running_bit ) != 0;
+    }
+
+    static bool stopping( std::uint64_t word )
+    {
+        return ( word & stopping_bit ) != 0;
+    }
+
+    //! load a word that no stop is in the middle of updating
+    static std::uint64_t load_settled( const std::atomic<std::uint64_t>& state )
+    {
+        auto word = state.load( std::memory_order_seq_cst );
+        while ( stopping( word ) )
+        {
+            std::this_thread::yield();
+            word = state.load( std::memory_order_seq_cst );
+        }
+        return word;
+    }
+
+    //! current value: `now() - ticks` while running, the frozen ticks while stopped
+    template< class Now >
+    static std::int64_t read( const std::atomic<std::uint64_t>& state, Now now )
+    {
+        for ( ;; )
+        {
+            auto word = load_settled( state );
+            if ( ! running( word ) )
+            {
+                return ticks( word );
+            }
+            auto current = now();
+            // retry if a stop or start landed while the time was read
+            if ( state.load( std::memory_order_seq_cst ) == word )
+            {
+                return current - ticks( word );
+            }
+        }
+    }
+
+    //! resume: the frozen value becomes the running value at `now()`
+    template< class Now >
+    static void start( std::atomic<std::uint64_t>& state, Now now )
+    {
+        auto word = load_settled( state );
+        while ( ! running( word ) &&
+                ! state.compare_exchange_weak( word, pack( now() - ticks( word ), true ),
+                                               std::memory_order_seq_cst, std::memory_order_seq_cst ) )
+        {
+            if ( stopping( word ) )
+            {
+                word = load_settled( state );
+            }
+        }
+    }
+
+    //! pause: mark the word, then read the time to freeze
+    template< class Now >
+    static void stop( std::atomic<std::uint64_t>& state, Now now )
+    {
+        auto word = load_settled( state );
+        while ( running( word ) )
+        {
+            if ( state.compare_exchange_weak( word, word | stopping_bit,
+                                              std::memory_order_seq_cst, std::memory_order_seq_cst ) )
+            {
+                state.store( pack( now() - ticks( word ), false ), std::memory_order_seq_cst );
+                return;
+            }
+            if ( stopping( word ) )
+            {
+                word = load_settled( state );
+            }
+        }
+    }
+
+    //! replace the word once no stop is in the middle of updating it
+    static void set( std::atomic<std::uint64_t>& state, std::uint64_t value )
+    {
+        auto word = load_settled( state );
+        while ( ! state.compare_exchange_weak( word, value,
+                                               std::memory_order_seq_cst, std::memory_order_seq_cst ) )
+        {
+            if ( stopping( word ) )
+            {
+                word = load_settled( state );
+            }
+        }
+    }
+};
+
+}
+
+//! stopwatch group class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a
+//! steady clock type with an integral tick count type.
+//! @details Group time that can be paused and resumed for many stopwatches at
+//! once, for example to exclude stop-the-world maintenance from every
+//! in-flight measurement. Member `grouped_stopwatch` timers measure group time
+//! rather than clock time, so the group's `stop()` freezes all members and its
+//! `start()` resumes them, each with a single atomic update however many
+//! members there are.
+//!
+//! The group state is one atomic word: while running it holds the clock
+//! reading at which group time was zero, and while stopped the frozen group
+//! time, with the running flag in the lowest bit. Readings are monotonic
+//! across a concurrent `stop()`: a reader that races with a stop waits for
+//! it, or retries, rather than return a time beyond the frozen value.
+//! Reading group time is otherwise lock-free. The group must outlive its
+//! members.
+//!
+//!  \snippet test_stopwatch_group.cpp stop stopwatch_group example
+template< class ClockType = std::chrono::steady_clock >
+class stopwatch_group
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+    static_assert( std::is_integral< typename ClockType::rep >::value,
+                   "clock must have an integral tick count type" );
+
+public:
+    //! scalar type for duration tick count
+    using rep = typename ClockType::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename ClockType::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! constructor
+    //!  @param  start    initial running state
+    explicit stopwatch_group( bool start = true )
+        : state_( start ? state::pack( now_ticks(), true ) : state::pack( 0, false ) )
+    {}
+
+    stopwatch_group( const stopwatch_group& ) = delete;
+    stopwatch_group& operator=( const stopwatch_group& ) = delete;
+
+    ~stopwatch_group( ) = default;
+
+    //! is group time running
+    bool is_running( ) const
+    {
+        return state::running( state::load_settled( state_ ) );
+    }
+
+    //! resume group time, and with it every running member
+    void start( )
+    {
+        state::start( state_, &stopwatch_group::now_ticks );
+    }
+
+    //! pause group time, and with it every running member
+    void stop( )
+    {
+        state::stop( state_, &stopwatch_group::now_ticks );
+    }
+
+    //! get group time
+    //! @returns  total time the group has been running
+    template< typename T = duration >
+    T value( ) const
+    {
+        return std::chrono::duration_cast<T>( duration( static_cast<rep>( group_ticks() ) ) );
+    }
+
+private:
+    template< class U >
+    friend class grouped_stopwatch;
+
+    using state = detail::packed_stopwatch_state;
+
+    std::atomic<std::uint64_t> state_;
+
+    static std::int64_t now_ticks( )
+    {
+        return static_cast<std::int64_t>( ClockType::now().time_since_epoch().count() );
+    }
+
+    std::int64_t group_ticks( ) const
+    {
+        return state::read( state_, &stopwatch_group::now_ticks );
+    }
+};
+
+//! grouped stopwatch class
+//! @tparam ClockType  `std::chrono` clock type of the group
+//! @details Stopwatch that measures the group time of a `stopwatch_group`.
+//! It behaves like `stopwatch_timer`, but does not advance while the group is
+//! stopped. Its own state is a single atomic word holding the group time at
+//! which its value was zero while running, or the frozen value while stopped,
+//! so every operation is lock-free.
+//!
+//!  \snippet test_stopwatch_group.cpp stop stopwatch_group example
+template< class ClockType = std::chrono::steady_clock >
+class grouped_stopwatch
+{
+public:
+    //! group type
+    using group_type = stopwatch_group<ClockType>;
+    //! scalar type for duration tick count
+    using rep = typename group_type::rep;
+    //! `std::ratio` type for duration tick period, in seconds
+    using period = typename group_type::period;
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename group_type::duration;
+
+    //! constructor
+    //!  @param  group    group whose time is measured
+    //!  @param  start    initial running state
+    explicit grouped_stopwatch( const group_type& group, bool start = true )
+        : group_( group )
+        , state_( start ? state::pack( group.group_ticks(), true ) : state::pack( 0, false ) )
+    {}
+
+    grouped_stopwatch( const grouped_stopwatch& ) = delete;
+    grouped_stopwatch& operator=( const grouped_stopwatch& ) = delete;
+
+    ~grouped_stopwatch( ) = default;
+
+    //! is timer running
+    bool is_running( ) const
+    {
+        return state::running( state::load_settled( state_ ) );
+    }
+
+    //! start timer
+    void start( )
+    {
+        state::start( state_, [this]() { return group_.group_ticks(); } );
+    }
+
+    //! stop timer
+    void stop( )
+    {
+        state::stop( state_, [this]() { return group_.group_ticks(); } );
+    }
+
+    //! restart timer
+    void restart( )
+    {
+        state::set( state_, state::pack( group_.group_ticks(), true ) );
+    }
+
+    //! reset timer
+    void reset( )
+    {
+        state::set( state_, state::pack( 0, false ) );
+    }
+
+    //! get elapsed group time
+    //! @returns  group time during which the timer was running
+    template< typename T = duration >
+    T value( ) const
+    {
+        auto ticks = state::read( state_, [this]() { return group_.group_ticks(); } );
+        return std::chrono::duration_cast<T>( duration( static_cast<rep>( ticks ) ) );
+    }
+
+private:
+    using state = detail::packed_stopwatch_state;
+
+    const group_type& group_;
+    std::atomic<std::uint64_t> state_;
+};
+
+}
+
+#endif
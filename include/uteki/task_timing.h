@@ -0,0 +1,250 @@
+//
+//  task_timing.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef task_timing_h
+#define task_timing_h
+
+#include "uteki/latency_histogram.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace uteki
+{
+
+//! task timing class
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Splits the latency of tasks submitted to an executor into the time
+//! spent queued and the time spent running. A callable passed through `wrap()`
+//! is stamped when it is wrapped (enqueue), when a worker invokes it (dequeue)
+//! and when it returns (completion). Queue delay, run time and end-to-end time
+//! are recorded into separate histograms. A wrapped callable invoked again
+//! counts as resubmitted when its previous run returned; copies share the
+//! stamps, so only one copy should be invoked. Counts of queued and running
+//! tasks are kept as well, so executor saturation shows up as a growing queue
+//! before it shows up in tail latency. One `task_timing` object is intended
+//! per executor; it is thread-safe and lock-free.
+//!
+//!  \snippet test_task_timing.cpp wrap task_timing example
+template< class ClockType = std::chrono::steady_clock >
+class task_timing
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+    //! histogram type for recorded durations
+    using histogram = latency_histogram<duration>;
+
+    //! callable wrapper that stamps enqueue, dequeue and completion times
+    //! @tparam Function  type of the wrapped callable
+    template< class Function >
+    class timed_task
+    {
+    public:
+        //! constructor
+        //! @param owner  timing object receiving the task's durations
+        //! @param fn     callable to wrap
+        timed_task( task_timing& owner, Function fn )
+            : owner_( &owner )
+            , function_( std::move( fn ) )
+            , enqueue_time_( ClockType::now() )
+            , invoked_( false )
+        {
+            owner_->submitted_.fetch_add( 1, std::memory_order_relaxed );
+        }
+
+        //! invoke the wrapped callable
+        //! @details The dequeue time is stamped before the call and the
+        //! completion time after it, also when the callable throws. Every
+        //! invocation after the first is counted as a new submission, enqueued
+        //! when the previous one returned.
+        template< class... Args >
+        auto operator()( Args&&... args )
+            -> decltype( std::declval<Function&>()( std::forward<Args>( args )... ) )
+        {
+            if ( invoked_ )
+            {
+                owner_->submitted_.fetch_add( 1, std::memory_order_relaxed );
+            }
+            invoked_ = true;
+            completion_guard guard( *owner_, enqueue_time_ );
+            return function_( std::forward<Args>( args )... );
+        }
+
+        //! time the task was wrapped, or its last invocation returned
+        time_point enqueue_time( ) const
+        {
+            return enqueue_time_;
+        }
+
+    private:
+        task_timing* owner_;
+        Function function_;
+        time_point enqueue_time_;
+        bool invoked_;
+    };
+
+    //! constructor
+    task_timing( )
+        : queue_delay_( )
+        , run_time_( )
+        , end_to_end_( )
+        , submitted_( 0 )
+        , started_( 0 )
+        , completed_( 0 )
+    {}
+
+    task_timing( const task_timing& ) = delete;
+    task_timing& operator=( const task_timing& ) = delete;
+
+    ~task_timing( ) = default;
+
+    //! wrap a callable for submission to the executor
+    //! @param fn  callable to wrap
+    //! @returns  callable that records its queue delay and run time when invoked
+    template< class Function >
+    timed_task< typename std::decay<Function>::type > wrap( Function&& fn )
+    {
+        return timed_task< typename std::decay<Function>::type >(
+            *this, std::forward<Function>( fn ) );
+    }
+
+    //! record the durations of a task from externally taken stamps
+    //! @param enqueued   time the task was submitted
+    //! @param dequeued   time a worker started the task
+    //! @param completed  time the task finished
+    void record( time_point enqueued, time_point dequeued, time_point completed )
+    {
+        queue_delay_.record( dequeued - enqueued );
+        run_time_.record( completed - dequeued );
+        end_to_end_.record( completed - enqueued );
+    }
+
+    //! histogram of time between enqueue and dequeue
+    const histogram& queue_delay( ) const
+    {
+        return queue_delay_;
+    }
+
+    //! histogram of time between dequeue and completion
+    const histogram& run_time( ) const
+    {
+        return run_time_;
+    }
+
+    //! histogram of time between enqueue and completion
+    const histogram& end_to_end( ) const
+    {
+        return end_to_end_;
+    }
+
+    //! number of tasks wrapped
+    std::uint64_t submitted( ) const
+    {
+        return submitted_.load( std::memory_order_relaxed );
+    }
+
+    //! number of tasks that finished running
+    std::uint64_t completed( ) const
+    {
+        return completed_.load( std::memory_order_relaxed );
+    }
+
+    //! number of wrapped tasks not yet started
+    //! @details Tasks that are wrapped but destroyed without being invoked
+    //! remain counted as queued.
+    std::uint64_t queued( ) const
+    {
+        auto started = started_.load( std::memory_order_relaxed );
+        auto submitted = submitted_.load( std::memory_order_relaxed );
+        return ( submitted > started ) ? submitted - started : 0;
+    }
+
+    //! number of tasks currently running
+    std::uint64_t running( ) const
+    {
+        auto completed = completed_.load( std::memory_order_relaxed );
+        auto started = started_.load( std::memory_order_relaxed );
+        return ( started > completed ) ? started - completed : 0;
+    }
+
+    //! discard all recorded durations and counts
+    void reset( )
+    {
+        queue_delay_.reset();
+        run_time_.reset();
+        end_to_end_.reset();
+        submitted_.store( 0, std::memory_order_relaxed );
+        started_.store( 0, std::memory_order_relaxed );
+        completed_.store( 0, std::memory_order_relaxed );
+    }
+
+private:
+    histogram queue_delay_;
+    histogram run_time_;
+    histogram end_to_end_;
+    std::atomic<std::uint64_t> submitted_;
+    std::atomic<std::uint64_t> started_;
+    std::atomic<std::uint64_t> completed_;
+
+    //! records a run on destruction and re-stamps `enqueued` with its completion
+    class completion_guard
+    {
+    public:
+        completion_guard( task_timing& owner, time_point& enqueued )
+            : owner_( owner )
+            , enqueued_( enqueued )
+            , dequeued_( ClockType::now() )
+        {
+            owner_.started_.fetch_add( 1, std::memory_order_relaxed );
+        }
+
+        completion_guard( const completion_guard& ) = delete;
+        completion_guard& operator=( const completion_guard& ) = delete;
+
+        ~completion_guard( )
+        {
+            time_point completed = ClockType::now();
+            owner_.record( enqueued_, dequeued_, completed );
+            owner_.completed_.fetch_add( 1, std::memory_order_relaxed );
+            enqueued_ = completed;
+        }
+
+    private:
+        task_timing& owner_;
+        time_point& enqueued_;
+        time_point dequeued_;
+    };
+};
+
+}
+
+#endif
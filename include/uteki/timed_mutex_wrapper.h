@@ -0,0 +1,464 @@
+//
+//  timed_mutex_wrapper.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef timed_mutex_wrapper_h
+#define timed_mutex_wrapper_h
+
+#include "uteki/latency_histogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined( __has_include )
+#if __has_include( <source_location> ) && __cplusplus > 201703L
+#include <source_location>
+#endif
+#endif
+
+namespace uteki
+{
+
+//! source location of a lock acquisition
+struct call_site
+{
+    //! source file name
+    const char* file;
+    //! line number
+    unsigned line;
+    //! function name
+    const char* function;
+
+    //! location of the caller, when used as a default argument
+#if defined( __cpp_lib_source_location )
+    static constexpr call_site current( std::source_location location = std::source_location::current() )
+    {
+        return call_site{ location.file_name(), location.line(), location.function_name() };
+    }
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    static constexpr call_site current( const char* file = __builtin_FILE(),
+                                        unsigned line = __builtin_LINE(),
+                                        const char* function = __builtin_FUNCTION() )
+    {
+        return call_site{ file, line, function };
+    }
+#else
+    static constexpr call_site current( )
+    {
+        return call_site{ "unknown", 0, "unknown" };
+    }
+#endif
+};
+
+//! call site of the expanding source line
+#define UTEKI_CALL_SITE ::uteki::call_site{ __FILE__, __LINE__, __func__ }
+
+//! contention report of one lock
+struct lock_report
+{
+    //! lock name
+    std::string name;
+    //! number of acquisitions
+    std::uint64_t acquisitions;
+    //! number of acquisitions that had to wait
+    std::uint64_t contended;
+    //! total time spent waiting to acquire the lock
+    std::chrono::nanoseconds total_wait;
+    //! longest wait
+    std::chrono::nanoseconds max_wait;
+    //! 99th percentile of waits of contended acquisitions
+    std::chrono::nanoseconds p99_wait;
+    //! number of sampled hold times
+    std::uint64_t hold_samples;
+    //! mean sampled hold time
+    std::chrono::nanoseconds mean_hold;
+    //! longest sampled hold time
+    std::chrono::nanoseconds max_hold;
+    //! call site with the most total wait time, if any acquisition waited
+    call_site worst_site;
+    //! total wait time of `worst_site`
+    std::chrono::nanoseconds worst_site_wait;
+};
+
+//! lock statistics class
+//! @details Clock-independent statistics of one instrumented lock and its
+//! membership in the lock registry; the base of `timed_mutex_wrapper`. All
+//! statistics are updated while the lock is held, so updates never contend,
+//! and are stored in atomics so that reports can be taken at any time.
+class lock_statistics
+{
+public:
+    //! histogram type of wait and hold times
+    using histogram = latency_histogram<std::chrono::nanoseconds>;
+    //! number of call sites tracked per lock
+    static constexpr std::size_t max_call_sites = 8;
+
+    lock_statistics( const lock_statistics& ) = delete;
+    lock_statistics& operator=( const lock_statistics& ) = delete;
+
+    //! lock name
+    const std::string& name( ) const
+    {
+        return name_;
+    }
+
+    //! waits of contended acquisitions
+    const histogram& waits( ) const
+    {
+        return waits_;
+    }
+
+    //! sampled hold times
+    const histogram& holds( ) const
+    {
+        return holds_;
+    }
+
+    //! number of acquisitions
+    std::uint64_t acquisitions( ) const
+    {
+        return acquisitions_.load( std::memory_order_relaxed );
+    }
+
+    //! contention report
+    lock_report report( ) const
+    {
+        lock_report r;
+        r.name = name_;
+        r.acquisitions = acquisitions();
+        r.contended = waits_.count();
+        r.total_wait = waits_.sum();
+        r.max_wait = waits_.max();
+        r.p99_wait = waits_.percentile( 99.0 );
+        r.hold_samples = holds_.count();
+        r.mean_hold = holds_.mean<std::chrono::nanoseconds>();
+        r.max_hold = holds_.max();
+        r.worst_site = call_site{ nullptr, 0, nullptr };
+        r.worst_site_wait = std::chrono::nanoseconds::zero();
+        for ( const auto& s : sites_ )
+        {
+            auto wait = std::chrono::nanoseconds( s.wait.load( std::memory_order_relaxed ) );
+            const char* file = s.file.load( std::memory_order_relaxed );
+            if ( file != nullptr && wait > r.worst_site_wait )
+            {
+                r.worst_site = call_site{ file, s.line.load( std::memory_order_relaxed ),
+                                          s.function.load( std::memory_order_relaxed ) };
+                r.worst_site_wait = wait;
+            }
+        }
+        return r;
+    }
+
+protected:
+    explicit lock_statistics( std::string name );
+    ~lock_statistics( );
+
+    //! record an acquisition; caller holds the lock
+    void record_acquisition( )
+    {
+        acquisitions_.store( acquisitions_.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+
+    //! record the wait of a contended acquisition; caller holds the lock
+    void record_wait( std::chrono::nanoseconds wait, const call_site& site )
+    {
+        waits_.record( wait );
+        site_entry* target = nullptr;
+        for ( auto& s : sites_ )
+        {
+            const char* file = s.file.load( std::memory_order_relaxed );
+            if ( file == site.file && s.line.load( std::memory_order_relaxed ) == site.line )
+            {
+                target = &s;
+                break;
+            }
+            if ( file == nullptr && target == nullptr )
+            {
+                target = &s;
+            }
+        }
+        if ( target == nullptr )
+        {
+            // table full: replace the site with the least wait
+            target = &*std::min_element( std::begin( sites_ ), std::end( sites_ ),
+                []( const site_entry& a, const site_entry& b ) {
+                    return a.wait.load( std::memory_order_relaxed ) < b.wait.load( std::memory_order_relaxed );
+                } );
+            target->file.store( nullptr, std::memory_order_relaxed );
+        }
+        if ( target->file.load( std::memory_order_relaxed ) == nullptr )
+        {
+            target->wait.store( 0, std::memory_order_relaxed );
+            target->line.store( site.line, std::memory_order_relaxed );
+            target->function.store( site.function, std::memory_order_relaxed );
+            target->file.store( site.file, std::memory_order_relaxed );
+        }
+        target->wait.store( target->wait.load( std::memory_order_relaxed ) +
+                            static_cast<std::uint64_t>( wait.count() ), std::memory_order_relaxed );
+    }
+
+    //! record a sampled hold time
+    void record_hold( std::chrono::nanoseconds hold )
+    {
+        holds_.record( hold );
+    }
+
+private:
+    struct site_entry
+    {
+        std::atomic<const char*> file;
+        std::atomic<unsigned> line;
+        std::atomic<const char*> function;
+        std::atomic<std::uint64_t> wait;
+
+        site_entry( )
+            : file( nullptr )
+            , line( 0 )
+            , function( nullptr )
+            , wait( 0 )
+        {}
+    };
+
+    const std::string name_;
+    std::atomic<std::uint64_t> acquisitions_;
+    histogram waits_;
+    histogram holds_;
+    site_entry sites_[max_call_sites];
+};
+
+//! lock registry class
+//! @details Process-wide list of the live instrumented locks, for ranking
+//! them by the total time threads spent waiting for them.
+//!
+//!  \snippet test_timed_mutex_wrapper.cpp ranked_by_wait timed_mutex_wrapper example
+class lock_registry
+{
+public:
+    //! the process-wide registry
+    static lock_registry& instance( )
+    {
+        static lock_registry registry;
+        return registry;
+    }
+
+    //! reports of all live locks, most total wait time first
+    std::vector<lock_report> ranked_by_wait( ) const
+    {
+        std::vector<lock_report> reports;
+        {
+            std::lock_guard<std::mutex> guard( lock_ );
+            reports.reserve( locks_.size() );
+            for ( const lock_statistics* l : locks_ )
+            {
+                reports.push_back( l->report() );
+            }
+        }
+        std::stable_sort( reports.begin(), reports.end(),
+            []( const lock_report& a, const lock_report& b ) { return a.total_wait > b.total_wait; } );
+        return reports;
+    }
+
+    //! number of live locks
+    std::size_t size( ) const
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        return locks_.size();
+    }
+
+private:
+    friend class lock_statistics;
+
+    mutable std::mutex lock_;
+    std::vector<const lock_statistics*> locks_;
+
+    lock_registry( ) = default;
+
+    void add( const lock_statistics* l )
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        locks_.push_back( l );
+    }
+
+    void remove( const lock_statistics* l )
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        locks_.erase( std::remove( locks_.begin(), locks_.end(), l ), locks_.end() );
+    }
+};
+
+inline lock_statistics::lock_statistics( std::string name )
+    : name_( std::move( name ) )
+    , acquisitions_( 0 )
+    , waits_( )
+    , holds_( )
+    , sites_( )
+{
+    lock_registry::instance().add( this );
+}
+
+inline lock_statistics::~lock_statistics( )
+{
+    lock_registry::instance().remove( this );
+}
+
+//! timed mutex wrapper class
+//! @tparam Mutex      wrapped mutex type, satisfying Lockable
+//! @tparam ClockType  `std::chrono` clock type used for timing. This must be a steady clock type.
+//! @details Lockable wrapper of a mutex that records how long threads wait
+//! to acquire it and how long it is held, and registers itself in the
+//! `lock_registry`. An acquisition first tries the lock; when that succeeds
+//! no clock is read. Only acquisitions that have to wait are timed, and their
+//! wait time and call site are recorded. Hold times are sampled, one in every
+//! `hold_sample_interval` acquisitions, so the uncontended cost is a
+//! `try_lock()` and a few non-contended counter updates.
+//!
+//! The call site is taken from a `call_site` argument, which defaults to the
+//! caller's location where the compiler supports it (`std::source_location`
+//! or the equivalent builtins). Acquisitions through `std::lock_guard` and
+//! other standard lock types report the standard library as the caller; use
+//! `guard` or pass `UTEKI_CALL_SITE` to identify the real caller.
+//!
+//!  \snippet test_timed_mutex_wrapper.cpp guard timed_mutex_wrapper example
+template< class Mutex = std::mutex, class ClockType = std::chrono::steady_clock >
+class timed_mutex_wrapper : public lock_statistics
+{
+    static_assert( ClockType::is_steady, "must use steady clock type" );
+
+public:
+    //! wrapped mutex type
+    using mutex_type = Mutex;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! scoped lock recording the caller's location
+    class guard
+    {
+    public:
+        //! constructor, locks the mutex
+        explicit guard( timed_mutex_wrapper& mutex, call_site site = call_site::current() )
+            : mutex_( mutex )
+        {
+            mutex_.lock( site );
+        }
+
+        guard( const guard& ) = delete;
+        guard& operator=( const guard& ) = delete;
+
+        //! destructor, unlocks the mutex
+        ~guard( )
+        {
+            mutex_.unlock();
+        }
+
+    private:
+        timed_mutex_wrapper& mutex_;
+    };
+
+    //! constructor
+    //! @param name                  lock name used in reports
+    //! @param hold_sample_interval  acquisitions per sampled hold time; zero samples none
+    explicit timed_mutex_wrapper( std::string name = "mutex", std::uint32_t hold_sample_interval = 64 )
+        : lock_statistics( std::move( name ) )
+        , mutex_( )
+        , hold_interval_( hold_sample_interval )
+        , hold_countdown_( hold_sample_interval )
+        , hold_start_( )
+        , timing_hold_( false )
+    {}
+
+    ~timed_mutex_wrapper( ) = default;
+
+    //! lock the mutex, waiting if necessary
+    void lock( call_site site = call_site::current() )
+    {
+        if ( ! mutex_.try_lock() )
+        {
+            auto start = ClockType::now();
+            mutex_.lock();
+            auto acquired = ClockType::now();
+            record_wait( std::chrono::duration_cast<std::chrono::nanoseconds>( acquired - start ), site );
+            acquired_locked( &acquired );
+            return;
+        }
+        acquired_locked( nullptr );
+    }
+
+    //! try to lock the mutex without waiting
+    //! @returns  `true` if the mutex was locked
+    bool try_lock( )
+    {
+        if ( ! mutex_.try_lock() )
+        {
+            return false;
+        }
+        acquired_locked( nullptr );
+        return true;
+    }
+
+    //! unlock the mutex
+    void unlock( )
+    {
+        if ( timing_hold_ )
+        {
+            timing_hold_ = false;
+            record_hold( std::chrono::duration_cast<std::chrono::nanoseconds>( ClockType::now() - hold_start_ ) );
+        }
+        mutex_.unlock();
+    }
+
+    //! wrapped mutex
+    mutex_type& native( )
+    {
+        return mutex_;
+    }
+
+private:
+    mutex_type mutex_;
+    const std::uint32_t hold_interval_;
+    std::uint32_t hold_countdown_;
+    time_point hold_start_;
+    bool timing_hold_;
+
+    //! bookkeeping of a successful acquisition; caller holds the lock
+    void acquired_locked( const time_point* now )
+    {
+        record_acquisition();
+        if ( hold_interval_ != 0 && --hold_countdown_ == 0 )
+        {
+            hold_countdown_ = hold_interval_;
+            hold_start_ = ( now != nullptr ) ? *now : ClockType::now();
+            timing_hold_ = true;
+        }
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,294 @@
+//
+//  timestamp_buffer.h
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef timestamp_buffer_h
+#define timestamp_buffer_h
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace uteki
+{
+
+//! timestamp buffer class
+//! @tparam ClockType  `std::chrono` clock type of the stored timestamps. The
+//! clock's tick count type must be an integral type.
+//! @details Compact in-memory capture of a stream of timestamps. Each
+//! timestamp is stored as the zig-zag encoded difference from the previous
+//! one, written as a little-endian base-128 varint. Timestamps of a busy
+//! event stream are close together, so most take one or two bytes instead of
+//! eight. Decoding checks eight bytes at a time and handles runs of one byte
+//! deltas without per-byte branches. Timestamps need not be monotonic;
+//! backward steps just encode as negative deltas. The buffer is not
+//! thread-safe; use one buffer per capturing thread.
+//!
+//!  \snippet test_timestamp_buffer.cpp push_back timestamp_buffer example
+template< class ClockType = std::chrono::steady_clock >
+class timestamp_buffer
+{
+    static_assert( std::is_integral< typename ClockType::rep >::value,
+                   "clock must have an integral tick count type" );
+
+public:
+    //! `std::chrono::duration<rep, period>` type represents a duration
+    using duration = typename ClockType::duration;
+    //! reference clock type's `time_point` type, represents a point in time
+    using time_point = typename ClockType::time_point;
+
+    //! forward iterator decoding the stored timestamps in order
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = time_point;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const time_point*;
+        using reference = const time_point&;
+
+        const_iterator( )
+            : next_( nullptr )
+            , end_( nullptr )
+            , ticks_( 0 )
+            , current_( )
+            , at_end_( true )
+        {}
+
+        reference operator*( ) const
+        {
+            return current_;
+        }
+
+        pointer operator->( ) const
+        {
+            return &current_;
+        }
+
+        const_iterator& operator++( )
+        {
+            advance();
+            return *this;
+        }
+
+        const_iterator operator++( int )
+        {
+            const_iterator previous( *this );
+            advance();
+            return previous;
+        }
+
+        friend bool operator==( const const_iterator& lhs, const const_iterator& rhs )
+        {
+            return lhs.at_end_ == rhs.at_end_ && ( lhs.at_end_ || lhs.next_ == rhs.next_ );
+        }
+
+        friend bool operator!=( const const_iterator& lhs, const const_iterator& rhs )
+        {
+            return ! ( lhs == rhs );
+        }
+
+    private:
+        friend class timestamp_buffer;
+
+        const_iterator( const std::uint8_t* first, const std::uint8_t* last )
+            : next_( first )
+            , end_( last )
+            , ticks_( 0 )
+            , current_( )
+            , at_end_( false )
+        {
+            advance();
+        }
+
+        void advance( )
+        {
+            if ( next_ == end_ )
+            {
+                at_end_ = true;
+                return;
+            }
+            ticks_ += unzigzag( read_varint( next_ ) );
+            current_ = to_time_point( ticks_ );
+        }
+
+        const std::uint8_t* next_;
+        const std::uint8_t* end_;
+        std::uint64_t ticks_;
+        time_point current_;
+        bool at_end_;
+    };
+
+    //! constructor
+    timestamp_buffer( )
+        : bytes_( )
+        , count_( 0 )
+        , last_ticks_( 0 )
+    {}
+
+    //! append a timestamp
+    void push_back( time_point t )
+    {
+        std::uint64_t ticks = static_cast<std::uint64_t>( t.time_since_epoch().count() );
+        std::uint64_t delta = ticks - last_ticks_;
+        std::uint64_t encoded = ( delta << 1 ) ^ ( ( delta >> 63 ) ? ~std::uint64_t( 0 ) : 0 );
+        while ( encoded >= 0x80 )
+        {
+            bytes_.push_back( static_cast<std::uint8_t>( encoded | 0x80 ) );
+            encoded >>= 7;
+        }
+        bytes_.push_back( static_cast<std::uint8_t>( encoded ) );
+        last_ticks_ = ticks;
+        ++count_;
+    }
+
+    //! number of stored timestamps
+    std::size_t size( ) const
+    {
+        return count_;
+    }
+
+    //! is the buffer empty
+    bool empty( ) const
+    {
+        return count_ == 0;
+    }
+
+    //! encoded size in bytes
+    std::size_t encoded_size( ) const
+    {
+        return bytes_.size();
+    }
+
+    //! most recently stored timestamp
+    //! @returns  last stored timestamp; the clock's epoch if the buffer is empty
+    time_point back( ) const
+    {
+        return to_time_point( last_ticks_ );
+    }
+
+    //! reserve space for encoded bytes
+    void reserve( std::size_t byte_count )
+    {
+        bytes_.reserve( byte_count );
+    }
+
+    //! remove all timestamps
+    void clear( )
+    {
+        bytes_.clear();
+        count_ = 0;
+        last_ticks_ = 0;
+    }
+
+    //! iterator to the first timestamp
+    const_iterator begin( ) const
+    {
+        return bytes_.empty() ? const_iterator()
+            : const_iterator( bytes_.data(), bytes_.data() + bytes_.size() );
+    }
+
+    //! iterator past the last timestamp
+    const_iterator end( ) const
+    {
+        return const_iterator();
+    }
+
+    //! decode all timestamps
+    //! @param out  beginning of the destination range, with room for `size()` timestamps
+    //! @returns  end of the destination range
+    template< class OutputIt >
+    OutputIt decode( OutputIt out ) const
+    {
+        const std::uint8_t* next = bytes_.data();
+        const std::uint8_t* end = next + bytes_.size();
+        std::uint64_t ticks = 0;
+        while ( next != end )
+        {
+            if ( end - next >= 8 )
+            {
+                std::uint64_t word;
+                std::memcpy( &word, next, sizeof( word ) );
+                if ( ( word & 0x8080808080808080ull ) == 0 )
+                {
+                    // eight single byte deltas
+                    for ( int k = 0; k < 8; ++k )
+                    {
+                        ticks += unzigzag( next[k] );
+                        *out++ = to_time_point( ticks );
+                    }
+                    next += 8;
+                    continue;
+                }
+            }
+            ticks += unzigzag( read_varint( next ) );
+            *out++ = to_time_point( ticks );
+        }
+        return out;
+    }
+
+    //! decode all timestamps
+    std::vector<time_point> decode( ) const
+    {
+        std::vector<time_point> result( count_ );
+        decode( result.begin() );
+        return result;
+    }
+
+private:
+    std::vector<std::uint8_t> bytes_;
+    std::size_t count_;
+    std::uint64_t last_ticks_;
+
+    static std::uint64_t unzigzag( std::uint64_t encoded )
+    {
+        return ( encoded >> 1 ) ^ ( ~( encoded & 1 ) + 1 );
+    }
+
+    static std::uint64_t read_varint( const std::uint8_t*& next )
+    {
+        std::uint64_t encoded = 0;
+        unsigned shift = 0;
+        std::uint8_t b;
+        do
+        {
+            b = *next++;
+            encoded |= std::uint64_t( b & 0x7f ) << shift;
+            shift += 7;
+        } while ( b & 0x80 );
+        return encoded;
+    }
+
+    static time_point to_time_point( std::uint64_t ticks )
+    {
+        return time_point( duration( static_cast<typename duration::rep>( ticks ) ) );
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,183 @@
+//
+//  test adaptive_timeout C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/adaptive_timeout.h"
+#include "uteki/elapsed_timer.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_adaptive_timeout : public ::testing::Test
+{
+protected:
+
+	Test_adaptive_timeout()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_adaptive_timeout() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_adaptive_timeout, record )
+{
+    struct record_tag {};
+    using clock = uteki::manual_clock<record_tag>;
+    clock::reset();
+
+    //! [record adaptive_timeout example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/adaptive_timeout.h"
+    // #include "uteki/elapsed_timer.h"
+
+    // start at 1 s, never recommend less than 1 ms or more than 5 s
+    uteki::adaptive_timeout<> rpc_timeout( 1s, 1ms, 5s );
+    EXPECT_EQ( rpc_timeout.timeout(), 1s );
+
+    uteki::elapsed_timer<clock> call_timer;
+    clock::advance( 100ms );   // the call
+    rpc_timeout.record( call_timer.value() );
+
+    // wait this long for a reply, and send a hedged request after this long
+    auto timeout = rpc_timeout.timeout<std::chrono::milliseconds>();
+    auto hedge = rpc_timeout.hedge_delay<std::chrono::milliseconds>();
+
+    //! [record adaptive_timeout example]
+
+    // first sample: mean 100 ms, deviation 50 ms
+    EXPECT_EQ( timeout, 300ms );
+    EXPECT_EQ( hedge, 150ms );
+    EXPECT_EQ( rpc_timeout.smoothed(), 100ms );
+    EXPECT_EQ( rpc_timeout.variation(), 50ms );
+
+    // the deviation decays by a quarter when a sample matches the mean
+    rpc_timeout.record( 100ms );
+    EXPECT_EQ( rpc_timeout.smoothed(), 100ms );
+    EXPECT_EQ( rpc_timeout.variation(), 37500us );
+    EXPECT_EQ( rpc_timeout.timeout(), 250ms );
+    EXPECT_EQ( rpc_timeout.sample_count(), 2u );
+}
+
+TEST_F( Test_adaptive_timeout, smoothing )
+{
+    uteki::adaptive_timeout<> estimate( 1s, 0ms, 10s );
+
+    estimate.record( 10ms );
+    // a spike moves the mean by 1/8 of the error and the deviation by 1/4
+    estimate.record( 90ms );
+    EXPECT_EQ( estimate.smoothed(), 20ms );
+    EXPECT_EQ( estimate.variation(), 23750us );
+
+    for ( int k = 0; k < 1000; ++k )
+    {
+        estimate.record( 200us );
+    }
+    EXPECT_EQ( estimate.smoothed(), 200us );
+    EXPECT_LE( estimate.variation(), 1us );
+    EXPECT_LE( estimate.timeout(), 204us );
+    EXPECT_LE( estimate.hedge_delay(), estimate.timeout() );
+}
+
+TEST_F( Test_adaptive_timeout, clamp )
+{
+    uteki::adaptive_timeout<> estimate( 1s, 10ms, 2s );
+
+    estimate.record( 1us );
+    EXPECT_EQ( estimate.timeout(), 10ms );
+    EXPECT_EQ( estimate.hedge_delay(), 10ms );
+
+    estimate.reset();
+    EXPECT_EQ( estimate.sample_count(), 0u );
+    EXPECT_EQ( estimate.smoothed(), std::chrono::microseconds::zero() );
+    EXPECT_EQ( estimate.timeout(), 1s );
+
+    estimate.record( 10s );
+    EXPECT_EQ( estimate.timeout(), 2s );
+
+    // negative durations count as zero
+    estimate.reset();
+    estimate.record( -5ms );
+    EXPECT_EQ( estimate.smoothed(), std::chrono::microseconds::zero() );
+}
+
+TEST_F( Test_adaptive_timeout, saturation )
+{
+    uteki::adaptive_timeout<std::chrono::milliseconds> estimate( 1s, 0ms, std::chrono::hours( 24 * 365 ) );
+
+    estimate.record( std::chrono::hours( 24 * 30 ) );
+    auto limit = std::chrono::milliseconds( ( 1 << 29 ) - 1 );
+    EXPECT_LE( estimate.smoothed(), limit );
+    EXPECT_GT( estimate.smoothed(), limit - 1ms );
+}
+
+TEST_F( Test_adaptive_timeout, concurrent )
+{
+    uteki::adaptive_timeout<> estimate( 1s, 0ms, 10s );
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 8; ++t )
+    {
+        threads.emplace_back( [&estimate]() {
+            for ( int k = 0; k < 10000; ++k )
+            {
+                estimate.record( 500us );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( estimate.sample_count(), 80000u );
+    EXPECT_EQ( estimate.smoothed(), 500us );
+    EXPECT_LE( estimate.variation(), 1us );
+}
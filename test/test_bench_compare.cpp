@@ -0,0 +1,159 @@
+//
+//  test bench_compare C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/bench_compare.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_bench_compare : public ::testing::Test
+{
+protected:
+
+	Test_bench_compare()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_bench_compare() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_bench_compare, mann_whitney )
+{
+    //! [mann_whitney bench_compare example]
+
+    // #include "uteki/bench_compare.h"
+    // #include <vector>
+
+    std::vector<double> before = { 1.0, 2.0, 3.0 };
+    std::vector<double> after = { 4.0, 5.0, 6.0 };
+    auto test = uteki::mann_whitney_u( after, before );
+
+    //! [mann_whitney bench_compare example]
+
+    EXPECT_DOUBLE_EQ( test.u, 9.0 );
+    EXPECT_NEAR( test.z, 1.7457, 1e-4 );
+    EXPECT_NEAR( test.p_value, 0.0809, 1e-4 );
+
+    // the test is symmetric
+    auto reverse = uteki::mann_whitney_u( before, after );
+    EXPECT_DOUBLE_EQ( reverse.u, 0.0 );
+    EXPECT_DOUBLE_EQ( reverse.z, -test.z );
+    EXPECT_DOUBLE_EQ( reverse.p_value, test.p_value );
+
+    // identical sets are not different
+    auto same = uteki::mann_whitney_u( before, before );
+    EXPECT_DOUBLE_EQ( same.p_value, 1.0 );
+    std::vector<double> constant( 5, 2.0 );
+    EXPECT_DOUBLE_EQ( uteki::mann_whitney_u( constant, constant ).p_value, 1.0 );
+    EXPECT_DOUBLE_EQ( uteki::mann_whitney_u( constant, {} ).p_value, 1.0 );
+}
+
+TEST_F( Test_bench_compare, median )
+{
+    EXPECT_DOUBLE_EQ( uteki::bench_median( {} ), 0.0 );
+    EXPECT_DOUBLE_EQ( uteki::bench_median( { 3.0, 1.0, 2.0 } ), 2.0 );
+    EXPECT_DOUBLE_EQ( uteki::bench_median( { 4.0, 1.0, 3.0, 2.0 } ), 2.5 );
+}
+
+TEST_F( Test_bench_compare, compare )
+{
+    std::mt19937_64 random( 42 );
+    std::lognormal_distribution<double> noise( 0.0, 0.05 );
+
+    //! [compare bench_compare example]
+
+    // #include "uteki/bench_compare.h"
+
+    uteki::bench_results baseline;
+    uteki::bench_results candidate;
+    for ( int k = 0; k < 200; ++k )
+    {
+        baseline["encode"].samples_ns.push_back( 1000.0 * noise( random ) );
+        candidate["encode"].samples_ns.push_back( 1030.0 * noise( random ) );
+        baseline["decode"].samples_ns.push_back( 500.0 * noise( random ) );
+        candidate["decode"].samples_ns.push_back( 500.0 * noise( random ) );
+    }
+
+    // flag slowdowns of more than 1% that are significant at the 5% level
+    uteki::compare_options options;
+    options.threshold = 0.01;
+    auto comparisons = uteki::compare_results( baseline, candidate, options );
+
+    //! [compare bench_compare example]
+
+    ASSERT_EQ( comparisons.size(), 2u );
+    const auto& encode = comparisons[0];
+    EXPECT_EQ( encode.name, "encode" );
+    EXPECT_EQ( encode.baseline_count, 200u );
+    EXPECT_TRUE( encode.significant );
+    EXPECT_TRUE( encode.regression );
+    EXPECT_FALSE( encode.improvement );
+    EXPECT_NEAR( encode.change, 0.03, 0.015 );
+    EXPECT_LE( encode.change_low, encode.change );
+    EXPECT_GE( encode.change_high, encode.change );
+
+    const auto& decode = comparisons[1];
+    EXPECT_EQ( decode.name, "decode" );
+    EXPECT_FALSE( decode.regression );
+    EXPECT_FALSE( decode.improvement );
+    EXPECT_LT( decode.change_low, 0.01 );
+}
+
+TEST_F( Test_bench_compare, metadata_differences )
+{
+    uteki::bench_results a;
+    uteki::bench_results b;
+    a.metadata["governor"] = "performance";
+    b.metadata["governor"] = "powersave";
+    a.metadata["cpu"] = "x";
+    b.metadata["cpu"] = "x";
+    b.metadata["compiler"] = "y";
+
+    auto keys = uteki::metadata_differences( a, b );
+    EXPECT_EQ( keys, ( std::vector<std::string>{ "governor", "compiler" } ) );
+}
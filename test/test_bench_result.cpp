@@ -0,0 +1,156 @@
+//
+//  test bench_result C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/bench_result.h"
+#include "uteki/stopwatch_timer.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+using namespace std::chrono_literals;
+
+
+class Test_bench_result : public ::testing::Test
+{
+protected:
+
+	Test_bench_result()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_bench_result() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_bench_result, write )
+{
+    //! [write bench_result example]
+
+    // #include <chrono>
+    // #include "uteki/bench_result.h"
+    // #include "uteki/stopwatch_timer.h"
+    // #include <sstream>
+
+    uteki::bench_results run;
+    run.describe_environment<std::chrono::steady_clock>();
+
+    uteki::bench_result& parse = run["parse"];
+    for ( int iteration = 0; iteration < 20; ++iteration )
+    {
+        uteki::stopwatch_timer<> timer;
+        // code under test
+        timer.stop();
+        parse.add_sample( timer.value() );
+    }
+
+    std::stringstream file;
+    run.write( file );
+
+    uteki::bench_results loaded;
+    bool ok = loaded.read( file );
+
+    //! [write bench_result example]
+
+    ASSERT_TRUE( ok );
+    EXPECT_EQ( loaded.metadata, run.metadata );
+    ASSERT_EQ( loaded.results.size(), 1u );
+    EXPECT_EQ( loaded.results[0].name, "parse" );
+    EXPECT_EQ( loaded.results[0].samples_ns, parse.samples_ns );
+    EXPECT_EQ( loaded.metadata["clock"], "std::chrono::steady_clock" );
+    EXPECT_EQ( loaded.metadata["clock_is_steady"], "true" );
+}
+
+TEST_F( Test_bench_result, round_trip )
+{
+    uteki::bench_results run;
+    run.metadata["note"] = "value with spaces";
+    run["a"].add_sample( std::chrono::microseconds( 3 ) );
+    run["a"].add_sample( std::chrono::duration<double, std::nano>( 0.1 ) );
+    run["b"];
+
+    std::stringstream file;
+    run.write( file );
+
+    uteki::bench_results loaded;
+    ASSERT_TRUE( loaded.read( file ) );
+    EXPECT_EQ( loaded.metadata["note"], "value with spaces" );
+    ASSERT_NE( loaded.find( "a" ), nullptr );
+    EXPECT_EQ( loaded.find( "a" )->samples_ns, ( std::vector<double>{ 3000.0, 0.1 } ) );
+    ASSERT_NE( loaded.find( "b" ), nullptr );
+    EXPECT_TRUE( loaded.find( "b" )->samples_ns.empty() );
+    EXPECT_EQ( loaded.find( "c" ), nullptr );
+}
+
+TEST_F( Test_bench_result, read_errors )
+{
+    uteki::bench_results run;
+    std::string error;
+
+    std::istringstream empty( "" );
+    EXPECT_FALSE( run.read( empty, &error ) );
+    EXPECT_EQ( error, "line 0: empty file" );
+
+    std::istringstream foreign( "name,value\n" );
+    EXPECT_FALSE( run.read( foreign, &error ) );
+    EXPECT_EQ( error, "line 1: not a uteki benchmark result file" );
+
+    std::istringstream future( "uteki-bench-results 2\n" );
+    EXPECT_FALSE( run.read( future, &error ) );
+    EXPECT_EQ( error, "line 1: unsupported format version 2" );
+
+    std::istringstream truncated( "uteki-bench-results 1\nbench a 3 1 2\n" );
+    EXPECT_FALSE( run.read( truncated, &error ) );
+    EXPECT_EQ( error, "line 2: expected 3 samples" );
+
+    std::istringstream corrupt( "uteki-bench-results 1\nbench a 18446744073709551615 1 2\n" );
+    EXPECT_FALSE( run.read( corrupt, &error ) );
+    EXPECT_EQ( error, "line 2: expected 18446744073709551615 samples" );
+
+    std::istringstream unknown( "uteki-bench-results 1\n\nsample 1\n" );
+    EXPECT_FALSE( run.read( unknown, &error ) );
+    EXPECT_EQ( error, "line 3: unknown record 'sample'" );
+
+    EXPECT_FALSE( run.load( "/nonexistent/results.txt", &error ) );
+}
@@ -0,0 +1,197 @@
+//
+//  test clock_mapper C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/clock_mapper.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_clock_mapper : public ::testing::Test
+{
+protected:
+
+	Test_clock_mapper()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_clock_mapper() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+
+struct mapper_test_tag;
+using source_clock = uteki::manual_clock<mapper_test_tag>;
+
+//! wall clock derived from the manual source clock with a configurable rate
+struct drifting_wall_clock
+{
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<drifting_wall_clock>;
+    static constexpr bool is_steady = false;
+
+    static double drift_ppm;
+    static std::int64_t rate_change_source;
+    static double rate_change_wall;
+
+    static time_point now( )
+    {
+        auto source = source_clock::now().time_since_epoch().count();
+        double wall = rate_change_wall +
+            static_cast<double>( source - rate_change_source ) * ( 1.0 + drift_ppm * 1e-6 );
+        return time_point( duration( wall_epoch + static_cast<std::int64_t>( wall ) ) );
+    }
+
+    //! change the drift from now on, keeping the wall clock continuous
+    static void set_drift( double ppm )
+    {
+        auto source = source_clock::now().time_since_epoch().count();
+        rate_change_wall += static_cast<double>( source - rate_change_source ) * ( 1.0 + drift_ppm * 1e-6 );
+        rate_change_source = source;
+        drift_ppm = ppm;
+    }
+
+    static constexpr std::int64_t wall_epoch = 1600000000000000000;
+};
+
+double drifting_wall_clock::drift_ppm = 0.0;
+std::int64_t drifting_wall_clock::rate_change_source = 0;
+double drifting_wall_clock::rate_change_wall = 0.0;
+constexpr std::int64_t drifting_wall_clock::wall_epoch;
+
+template< class Rep, class Period >
+std::chrono::duration<Rep, Period> abs_duration( std::chrono::duration<Rep, Period> d )
+{
+    return ( d < d.zero() ) ? -d : d;
+}
+
+}
+
+TEST_F( Test_clock_mapper, to_wall )
+{
+    //! [to_wall clock_mapper example]
+
+    // #include <chrono>
+    // #include <vector>
+    // #include "uteki/clock_mapper.h"
+
+    uteki::clock_mapper<> mapper( std::chrono::seconds( 1 ) );
+
+    std::vector< std::chrono::steady_clock::time_point > stamps;
+    for ( int k = 0; k < 100; ++k )
+    {
+        stamps.push_back( std::chrono::steady_clock::now() );
+    }
+
+    // refit if due, then convert the whole batch
+    mapper.update();
+    std::vector< std::chrono::system_clock::time_point > wall_stamps( stamps.size() );
+    mapper.to_wall( stamps.begin(), stamps.end(), wall_stamps.begin() );
+
+    //! [to_wall clock_mapper example]
+
+    auto wall_now = std::chrono::system_clock::now();
+    auto error = wall_now - mapper.to_wall( std::chrono::steady_clock::now() );
+    EXPECT_LT( abs_duration( error ), 1ms );
+    for ( std::size_t k = 1; k < wall_stamps.size(); ++k )
+    {
+        EXPECT_GE( wall_stamps[k], wall_stamps[k - 1] );
+    }
+}
+
+TEST_F( Test_clock_mapper, drift_over_hours )
+{
+    using mapper_type = uteki::clock_mapper<source_clock, drifting_wall_clock>;
+
+    source_clock::reset();
+    drifting_wall_clock::rate_change_source = 0;
+    drifting_wall_clock::rate_change_wall = 0.0;
+    drifting_wall_clock::drift_ppm = 0.0;
+    drifting_wall_clock::set_drift( 50.0 );
+
+    mapper_type mapper( 10s, 8 );
+    EXPECT_FALSE( mapper.update() );
+    for ( int k = 0; k < 20; ++k )
+    {
+        source_clock::advance( 10s );
+        EXPECT_TRUE( mapper.update() );
+    }
+    EXPECT_EQ( mapper.sample_count(), 8u );
+    EXPECT_NEAR( mapper.drift_ppm(), 50.0, 0.01 );
+    EXPECT_LT( mapper.residual(), 2ns );
+
+    // extrapolate two hours past the last sample
+    source_clock::advance( 2h );
+    auto expected = drifting_wall_clock::now();
+    auto mapped = mapper.to_wall( source_clock::now() );
+    EXPECT_LT( abs_duration( expected - mapped ), 1us );
+
+    // NTP slews the wall clock; the window follows the new rate
+    drifting_wall_clock::set_drift( -20.0 );
+    for ( int k = 0; k < 8; ++k )
+    {
+        source_clock::advance( 10s );
+        mapper.update();
+    }
+    EXPECT_NEAR( mapper.drift_ppm(), -20.0, 0.01 );
+
+    std::vector< source_clock::time_point > stamps;
+    for ( int k = 0; k < 10; ++k )
+    {
+        stamps.push_back( source_clock::now() + std::chrono::minutes( 6 * k ) );
+    }
+    std::vector< drifting_wall_clock::time_point > wall_stamps( stamps.size() );
+    mapper.to_wall( stamps.begin(), stamps.end(), wall_stamps.begin() );
+
+    source_clock::advance( 54min );
+    EXPECT_LT( abs_duration( wall_stamps.back() - drifting_wall_clock::now() ), 1us );
+}
@@ -0,0 +1,170 @@
+//
+//  test deadline C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/deadline.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+
+class Test_deadline : public ::testing::Test
+{
+protected:
+
+	Test_deadline()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_deadline() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+    struct deadline_tag {};
+    using test_clock = uteki::manual_clock<deadline_tag>;
+}
+
+TEST_F( Test_deadline, child )
+{
+    test_clock::reset();
+
+    //! [child deadline example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/deadline.h"
+
+    // the caller gives the request 100 ms
+    auto request = uteki::deadline<test_clock>::from_now( 100ms );
+
+    test_clock::advance( 30ms );
+    // a backend call gets at most 50 ms, but no more than the request has left
+    auto backend_call = request.child( 50ms );
+
+    test_clock::advance( 40ms );
+    // a retry gets at most 50 ms
+    auto retry = request.child( 50ms );
+
+    //! [child deadline example]
+
+    EXPECT_EQ( backend_call.remaining(), 10ms );
+    EXPECT_EQ( retry.remaining(), 30ms );
+    EXPECT_EQ( retry.expiry(), request.expiry() );
+    EXPECT_FALSE( retry.expired() );
+
+    test_clock::advance( 30ms );
+    EXPECT_TRUE( request.expired() );
+    EXPECT_EQ( request.remaining(), 0ms );
+    EXPECT_TRUE( backend_call.expired( test_clock::now() ) );
+}
+
+TEST_F( Test_deadline, never )
+{
+    test_clock::reset();
+    using deadline_type = uteki::deadline<test_clock>;
+
+    deadline_type unbounded;
+    EXPECT_TRUE( unbounded.is_never() );
+    EXPECT_TRUE( deadline_type::never().is_never() );
+    EXPECT_FALSE( unbounded.expired() );
+    EXPECT_EQ( unbounded.remaining(), deadline_type::duration::max() );
+    EXPECT_EQ( unbounded.remaining<std::chrono::seconds>(), std::chrono::seconds::max() );
+
+    // a child of a deadline that never expires has the local budget
+    EXPECT_EQ( unbounded.child( 5ms ).remaining(), 5ms );
+    EXPECT_FALSE( unbounded.child( 5ms ).is_never() );
+
+    // budgets past the clock's range never expire
+    EXPECT_TRUE( deadline_type::from_now( std::chrono::hours::max() ).is_never() );
+    EXPECT_TRUE( deadline_type::from_now( std::chrono::duration<double>( 1e300 ) ).is_never() );
+}
+
+TEST_F( Test_deadline, child_of_deadline )
+{
+    test_clock::reset();
+    using deadline_type = uteki::deadline<test_clock>;
+
+    auto a = deadline_type::from_now( 10ms );
+    auto b = deadline_type::from_now( 20ms );
+    EXPECT_EQ( a.child( b ).expiry(), a.expiry() );
+    EXPECT_EQ( b.child( a ).expiry(), a.expiry() );
+
+    // a non-positive budget expires immediately
+    EXPECT_TRUE( b.child( 0ms ).expired() );
+    EXPECT_TRUE( b.child( -1ms ).expired() );
+}
+
+TEST_F( Test_deadline, deadline_checker )
+{
+    test_clock::reset();
+
+    //! [deadline_checker deadline example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/deadline.h"
+
+    auto limit = uteki::deadline<test_clock>::from_now( 1ms );
+
+    // read the clock once every 16 iterations
+    uteki::deadline_checker<test_clock> checker( limit, 16 );
+    int iterations = 0;
+    while ( ! checker.expired() )
+    {
+        ++iterations;
+        test_clock::advance( 10us );    // one unit of work
+    }
+
+    //! [deadline_checker deadline example]
+
+    // expiry after 100 iterations is noticed at the next clock read
+    EXPECT_EQ( iterations, 112 );
+    EXPECT_EQ( checker.clock_reads(), 8u );
+    EXPECT_TRUE( checker.expired() );
+    EXPECT_EQ( checker.clock_reads(), 8u );
+    EXPECT_EQ( checker.limit().expiry(), limit.expiry() );
+}
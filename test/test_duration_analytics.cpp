@@ -0,0 +1,194 @@
+//
+//  test duration_analytics C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/duration_analytics.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_duration_analytics : public ::testing::Test
+{
+protected:
+
+	Test_duration_analytics()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_duration_analytics() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+
+std::vector<std::int64_t> random_durations( std::size_t n, std::int64_t low, std::int64_t high, unsigned seed = 7 )
+{
+    std::mt19937_64 random( seed );
+    std::uniform_int_distribution<std::int64_t> pick( low, high );
+    std::vector<std::int64_t> data( n );
+    for ( auto& d : data )
+    {
+        d = pick( random );
+    }
+    return data;
+}
+
+const uteki::simd_kernel all_kernels[] = {
+    uteki::simd_kernel::scalar, uteki::simd_kernel::avx2, uteki::simd_kernel::avx512, uteki::simd_kernel::neon };
+
+}
+
+TEST_F( Test_duration_analytics, summarize )
+{
+    //! [summarize duration_analytics example]
+    std::vector<std::chrono::nanoseconds::rep> captured = { 120, 80, 100, 300, 400 };
+    auto summary = uteki::summarize_durations( captured.data(), captured.size() );
+    //! [summarize duration_analytics example]
+    EXPECT_EQ( summary.count, 5u );
+    EXPECT_EQ( summary.min, 80 );
+    EXPECT_EQ( summary.max, 400 );
+    EXPECT_EQ( summary.sum, 1000 );
+    EXPECT_DOUBLE_EQ( summary.mean, 200.0 );
+    EXPECT_DOUBLE_EQ( summary.variance, 16160.0 );
+
+    auto empty = uteki::summarize_durations( captured.data(), 0 );
+    EXPECT_EQ( empty.count, 0u );
+    EXPECT_DOUBLE_EQ( empty.variance, 0.0 );
+}
+
+TEST_F( Test_duration_analytics, kernels_agree )
+{
+    EXPECT_TRUE( uteki::simd_kernel_supported( uteki::simd_kernel::scalar ) );
+    EXPECT_TRUE( uteki::simd_kernel_supported( uteki::detected_simd_kernel() ) );
+
+    for ( std::size_t n : { std::size_t( 1 ), std::size_t( 3 ), std::size_t( 7 ), std::size_t( 8 ), std::size_t( 13 ),
+                            std::size_t( 100003 ) } )
+    {
+        auto data = random_durations( n, -1000, 50000000 );
+        auto expected = uteki::summarize_durations( data.data(), n, uteki::simd_kernel::scalar );
+        std::size_t expected_above = uteki::count_above( data.data(), n, std::int64_t( 1000000 ), uteki::simd_kernel::scalar );
+        for ( auto kernel : all_kernels )
+        {
+            // unsupported kernels fall back to the scalar loops
+            auto summary = uteki::summarize_durations( data.data(), n, kernel );
+            EXPECT_EQ( summary.min, expected.min );
+            EXPECT_EQ( summary.max, expected.max );
+            EXPECT_EQ( summary.sum, expected.sum );
+            EXPECT_DOUBLE_EQ( summary.mean, expected.mean );
+            EXPECT_NEAR( summary.variance, expected.variance, 1e-9 * expected.variance + 1e-9 );
+            EXPECT_EQ( uteki::count_above( data.data(), n, std::int64_t( 1000000 ), kernel ), expected_above );
+        }
+        EXPECT_EQ( expected_above,
+                   std::size_t( std::count_if( data.begin(), data.end(), []( std::int64_t d ) { return d > 1000000; } ) ) );
+    }
+}
+
+TEST_F( Test_duration_analytics, wide_range )
+{
+    // a range beyond 2^52 cannot use the vector variance pass
+    std::vector<std::int64_t> data = { INT64_MIN / 2, 0, INT64_MAX / 2, 5, -5, 1, 2, 3, 4 };
+    auto expected = uteki::summarize_durations( data.data(), data.size(), uteki::simd_kernel::scalar );
+    auto summary = uteki::summarize_durations( data.data(), data.size() );
+    EXPECT_EQ( summary.min, expected.min );
+    EXPECT_EQ( summary.max, expected.max );
+    EXPECT_DOUBLE_EQ( summary.variance, expected.variance );
+}
+
+TEST_F( Test_duration_analytics, other_rep )
+{
+    std::vector<int> ints = { 3, 1, 2 };
+    auto summary = uteki::summarize_durations( ints.data(), ints.size(), uteki::simd_kernel::avx2 );
+    EXPECT_EQ( summary.min, 1 );
+    EXPECT_EQ( summary.max, 3 );
+    EXPECT_EQ( summary.sum, 6 );
+    EXPECT_EQ( uteki::count_above( ints.data(), ints.size(), 2 ), 1u );
+
+    std::vector<double> doubles = { 0.5, 1.5 };
+    EXPECT_DOUBLE_EQ( uteki::summarize_durations( doubles.data(), doubles.size() ).variance, 0.25 );
+}
+
+TEST_F( Test_duration_analytics, bin_durations )
+{
+    auto data = random_durations( 10007, -50, 1050 );
+    std::vector<std::uint64_t> counts( 10, 0 );
+    uteki::bin_durations( data.data(), data.size(), std::int64_t( 0 ), std::int64_t( 100 ), counts.data(), counts.size() );
+
+    std::vector<std::uint64_t> expected( 10, 0 );
+    for ( auto d : data )
+    {
+        std::int64_t bin = ( d < 0 ) ? 0 : std::min<std::int64_t>( d / 100, 9 );
+        ++expected[ static_cast<std::size_t>( bin ) ];
+    }
+    EXPECT_EQ( counts, expected );
+
+    // bin edges
+    std::vector<std::int64_t> edges = { 0, 99, 100, 199, 200, 299, 300 };
+    std::vector<std::uint64_t> edge_counts( 3, 0 );
+    uteki::bin_durations( edges.data(), edges.size(), std::int64_t( 0 ), std::int64_t( 100 ), edge_counts.data(), 3 );
+    EXPECT_EQ( ( std::vector<std::uint64_t>{ 2, 2, 3 } ), edge_counts );
+}
+
+TEST_F( Test_duration_analytics, percentiles )
+{
+    //! [percentiles duration_analytics example]
+    std::vector<std::int64_t> captured = random_durations( 100001, 0, 1000000 );
+    auto p = uteki::duration_percentiles( captured, { 99.9, 50.0, 99.0 } );
+    //! [percentiles duration_analytics example]
+    std::vector<std::int64_t> sorted = captured;
+    std::sort( sorted.begin(), sorted.end() );
+    ASSERT_EQ( p.size(), 3u );
+    EXPECT_EQ( p[0], sorted[99900] );
+    EXPECT_EQ( p[1], sorted[50000] );
+    EXPECT_EQ( p[2], sorted[99000] );
+
+    auto bounds = uteki::duration_percentiles( std::vector<std::int64_t>{ 5, 1, 9 }, { 0.0, 100.0, 50.0, 50.0 } );
+    EXPECT_EQ( ( std::vector<std::int64_t>{ 1, 9, 5, 5 } ), bounds );
+    EXPECT_TRUE( uteki::duration_percentiles( std::vector<std::int64_t>(), { 50.0 } ).empty() );
+}
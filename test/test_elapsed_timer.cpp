@@ -23,6 +23,7 @@
 //
 
 #include "uteki/elapsed_timer.h"
+#include "uteki/manual_clock.h"
 #include <iostream>
 #include <gtest/gtest.h>
 #include <chrono>
@@ -347,3 +348,28 @@ TEST_F( Test_elapsed_timer, comparison )
     EXPECT_TRUE( timer_b >= timer_b );
     EXPECT_TRUE( timer_c >= timer_c );
 }
+
+TEST_F( Test_elapsed_timer, manual_clock )
+{
+    struct elapsed_timer_test_clock;
+    using clock_type = uteki::manual_clock<elapsed_timer_test_clock>;
+    using timer_type_mc = uteki::elapsed_timer<clock_type>;
+
+    timer_type_mc timer_a;
+    clock_type::advance( 192ms );
+    timer_type_mc timer_b;
+    clock_type::advance( 120ms );
+
+    EXPECT_EQ( timer_a.value(), 192ms + 120ms );
+    EXPECT_EQ( timer_b.value(), 120ms );
+    EXPECT_TRUE( timer_a > timer_b );
+
+    timer_type_mc timer_c( timer_a );
+    EXPECT_TRUE( timer_c == timer_a );
+
+    timer_a.restart();
+    clock_type::advance( 288ms );
+    EXPECT_EQ( timer_a.value(), 288ms );
+    EXPECT_EQ( timer_c.value(), 192ms + 120ms + 288ms );
+    EXPECT_TRUE( timer_a < timer_c );
+}
@@ -0,0 +1,194 @@
+//
+//  test latency_histogram C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/latency_histogram.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_latency_histogram : public ::testing::Test
+{
+protected:
+
+	Test_latency_histogram()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_latency_histogram() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_latency_histogram, empty )
+{
+    uteki::latency_histogram<> histogram;
+
+    EXPECT_EQ( histogram.count(), 0u );
+    EXPECT_EQ( histogram.sum(), std::chrono::nanoseconds::zero() );
+    EXPECT_EQ( histogram.min(), std::chrono::nanoseconds::zero() );
+    EXPECT_EQ( histogram.max(), std::chrono::nanoseconds::zero() );
+    EXPECT_EQ( histogram.percentile( 50.0 ), std::chrono::nanoseconds::zero() );
+    EXPECT_EQ( histogram.mean().count(), 0.0 );
+}
+
+TEST_F( Test_latency_histogram, bucket_bounds )
+{
+    using histogram_type = uteki::latency_histogram<>;
+
+    for ( std::size_t k = 0; k < histogram_type::bucket_count - 1; ++k )
+    {
+        auto lower = histogram_type::bucket_lower_bound( k );
+        auto next_lower = histogram_type::bucket_lower_bound( k + 1 );
+        EXPECT_LT( lower, next_lower );
+        EXPECT_EQ( histogram_type::bucket_index( lower ), k );
+        EXPECT_EQ( histogram_type::bucket_index( next_lower - 1ns ), k );
+    }
+
+    // relative bucket width is at most 1/16
+    auto idx = histogram_type::bucket_index( 1000000ns );
+    auto width = histogram_type::bucket_lower_bound( idx + 1 ) - histogram_type::bucket_lower_bound( idx );
+    EXPECT_LE( width.count() * 16, 1000000 );
+
+    EXPECT_EQ( histogram_type::bucket_index( -5ns ), 0u );
+}
+
+TEST_F( Test_latency_histogram, record )
+{
+    uteki::latency_histogram<std::chrono::microseconds> histogram;
+
+    for ( int k = 1; k <= 1000; ++k )
+    {
+        histogram.record( std::chrono::microseconds( k ) );
+    }
+    histogram.record( 2ms, 0 );
+
+    EXPECT_EQ( histogram.count(), 1000u );
+    EXPECT_EQ( histogram.sum(), std::chrono::microseconds( 500500 ) );
+    EXPECT_EQ( histogram.min(), 1us );
+    EXPECT_EQ( histogram.max(), 1000us );
+    EXPECT_DOUBLE_EQ( histogram.mean().count(), 500.5 );
+
+    EXPECT_NEAR( histogram.percentile( 50.0 ).count(), 500.0, 500.0 / 16 );
+    EXPECT_NEAR( histogram.percentile( 99.0 ).count(), 990.0, 990.0 / 16 );
+    EXPECT_EQ( histogram.percentile( 0.0 ), 1us );
+    EXPECT_EQ( histogram.percentile( 100.0 ), 1000us );
+
+    // recorded values are converted to the histogram's duration
+    histogram.record( 3ms );
+    EXPECT_EQ( histogram.max(), 3000us );
+}
+
+TEST_F( Test_latency_histogram, record_corrected )
+{
+    uteki::latency_histogram<std::chrono::microseconds> histogram;
+
+    // a 10ms stall of a loop meant to measure every 1ms hides nine measurements
+    histogram.record_corrected( 10ms, 1ms );
+    EXPECT_EQ( histogram.count(), 10u );
+    EXPECT_EQ( histogram.sum(), 55ms );
+    EXPECT_EQ( histogram.min(), 1ms );
+    EXPECT_EQ( histogram.max(), 10ms );
+
+    histogram.reset();
+    histogram.record_corrected( 500us, 1ms );
+    histogram.record_corrected( 2ms, 0ms );
+    EXPECT_EQ( histogram.count(), 2u );
+    EXPECT_EQ( histogram.sum(), 2500us );
+}
+
+TEST_F( Test_latency_histogram, merge_reset )
+{
+    uteki::latency_histogram<> histogram_a;
+    uteki::latency_histogram<> histogram_b;
+
+    histogram_a.record( 10us, 3 );
+    histogram_b.record( 5us );
+    histogram_b.record( 20us );
+
+    histogram_a.merge( histogram_b );
+    EXPECT_EQ( histogram_a.count(), 5u );
+    EXPECT_EQ( histogram_a.sum(), 55us );
+    EXPECT_EQ( histogram_a.min(), 5us );
+    EXPECT_EQ( histogram_a.max(), 20us );
+
+    histogram_a.reset();
+    EXPECT_EQ( histogram_a.count(), 0u );
+    EXPECT_EQ( histogram_a.sum(), 0us );
+    EXPECT_EQ( histogram_a.max(), 0us );
+    EXPECT_EQ( histogram_b.count(), 2u );
+}
+
+TEST_F( Test_latency_histogram, concurrent_record )
+{
+    uteki::latency_histogram<> histogram;
+    constexpr int thread_count = 4;
+    constexpr int records_per_thread = 10000;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < thread_count; ++t )
+    {
+        threads.emplace_back( [&histogram]() {
+            for ( int k = 0; k < records_per_thread; ++k )
+            {
+                histogram.record( std::chrono::nanoseconds( k ) );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( histogram.count(), std::uint64_t( thread_count * records_per_thread ) );
+    std::uint64_t bucket_total = 0;
+    for ( std::size_t k = 0; k < uteki::latency_histogram<>::bucket_count; ++k )
+    {
+        bucket_total += histogram.bucket_value( k );
+    }
+    EXPECT_EQ( bucket_total, histogram.count() );
+    EXPECT_EQ( histogram.max(), std::chrono::nanoseconds( records_per_thread - 1 ) );
+}
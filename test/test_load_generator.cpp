@@ -0,0 +1,188 @@
+//
+//  test load_generator C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/load_generator.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_load_generator : public ::testing::Test
+{
+protected:
+
+	Test_load_generator()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_load_generator() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_load_generator, run )
+{
+    //! [run load_generator example]
+    // 100us per request, with a 5ms stall on every 100th
+    uteki::simulated_service<> service( 100us, 5ms, 100 );
+    // 1000 requests per second
+    uteki::load_generator<> generator( 1ms );
+    generator.run( service, 300 );
+
+    auto p99 = generator.latency().percentile( 99.0 );
+    //! [run load_generator example]
+    EXPECT_EQ( service.calls(), 300u );
+    EXPECT_EQ( generator.requests(), 300u );
+    EXPECT_GE( generator.latency().max(), 5ms );
+    // the requests queued behind each stall see it too
+    EXPECT_GE( p99, 2ms );
+    EXPECT_GE( generator.latency().count(), generator.service_time().count() );
+}
+
+TEST_F( Test_load_generator, coordinated_omission )
+{
+    struct coordinated_omission_tag;
+    using clock = uteki::manual_clock<coordinated_omission_tag>;
+    clock::reset();
+
+    // requests meant to be sent every 1ms take 1ms, except one 100ms stall;
+    // the manual clock only moves inside requests, so none may be early
+    int sent = 0;
+    auto request = [&sent]() {
+        clock::advance( ( sent == 10 ) ? 101ms : 1ms );
+        ++sent;
+    };
+    uteki::load_generator<clock> generator( 1ms );
+    generator.run( request, 200 );
+
+    // a closed loop sees a single slow request
+    EXPECT_EQ( generator.service_time().count(), 200u );
+    EXPECT_EQ( generator.service_time().max(), 101ms );
+    EXPECT_LT( generator.service_time().percentile( 99.0 ), 2ms );
+
+    // every request due after the stall is charged the wait
+    EXPECT_EQ( generator.latency().count(), 200u );
+    EXPECT_EQ( generator.latency().max(), 101ms );
+    EXPECT_GE( generator.latency().percentile( 50.0 ), 100ms );
+    EXPECT_EQ( generator.late_sends(), 189u );
+    EXPECT_EQ( generator.max_send_lag(), 100ms );
+
+    // correction adds the 100 sends the stall hid
+    EXPECT_EQ( generator.corrected_service_time().count(), 300u );
+
+    generator.reset_statistics();
+    EXPECT_EQ( generator.requests(), 0u );
+    EXPECT_EQ( generator.late_sends(), 0u );
+}
+
+TEST_F( Test_load_generator, run_for )
+{
+    struct run_for_tag;
+    using clock = uteki::manual_clock<run_for_tag>;
+    clock::reset();
+
+    uteki::load_generator<clock> generator( 1ms );
+    auto request = []() { clock::advance( 1ms ); };
+    EXPECT_EQ( generator.run_for( request, 50ms ), 50u );
+    EXPECT_EQ( generator.late_sends(), 0u );
+    EXPECT_EQ( generator.latency().max(), 1ms );
+}
+
+TEST_F( Test_load_generator, poisson )
+{
+    struct poisson_tag;
+    using clock = uteki::manual_clock<poisson_tag>;
+    clock::reset();
+
+    // each request outlasts any gap, so the generator never waits and the
+    // schedule is the seeded one whatever the load on the host
+    std::vector<clock::time_point> intended;
+    intended.reserve( 2000 );
+    auto request = [&intended]( clock::time_point when ) {
+        intended.push_back( when );
+        clock::advance( 1s );
+    };
+    uteki::load_generator<clock> generator( 200us, uteki::arrival_process::poisson, 42 );
+    EXPECT_EQ( generator.process(), uteki::arrival_process::poisson );
+    generator.run( request, 2000 );
+    ASSERT_EQ( intended.size(), 2000u );
+
+    // gaps average the interval and vary about as much, as exponential gaps do
+    std::vector<double> gaps;
+    for ( std::size_t k = 1; k < intended.size(); ++k )
+    {
+        gaps.push_back( std::chrono::duration<double, std::micro>( intended[k] - intended[k - 1] ).count() );
+    }
+    double mean = 0.0;
+    for ( double g : gaps )
+    {
+        mean += g;
+    }
+    mean /= static_cast<double>( gaps.size() );
+    double variance = 0.0;
+    for ( double g : gaps )
+    {
+        variance += ( g - mean ) * ( g - mean );
+    }
+    variance /= static_cast<double>( gaps.size() );
+    EXPECT_NEAR( mean, 200.0, 20.0 );
+    EXPECT_NEAR( std::sqrt( variance ) / mean, 1.0, 0.1 );
+}
+
+TEST_F( Test_load_generator, zero_interval )
+{
+    struct zero_interval_tag;
+    using clock = uteki::manual_clock<zero_interval_tag>;
+    clock::reset();
+
+    // a zero interval would give the Poisson gaps an infinite rate
+    uteki::load_generator<clock> generator( 0ms, uteki::arrival_process::poisson );
+    EXPECT_EQ( generator.interval(), 1ns );
+    auto request = []() { clock::advance( 1us ); };
+    generator.run( request, 3 );
+    EXPECT_EQ( generator.requests(), 3u );
+}
@@ -0,0 +1,175 @@
+//
+//  test loop_pacer C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/loop_pacer.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+
+class Test_loop_pacer : public ::testing::Test
+{
+protected:
+
+	Test_loop_pacer()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_loop_pacer() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_loop_pacer, wait )
+{
+    //! [wait loop_pacer example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/loop_pacer.h"
+
+    // a 2 kHz control loop
+    uteki::loop_pacer<> pacer( 500us );
+    pacer.calibrate( 20 );
+
+    auto first = pacer.wait();
+    auto last = first;
+    for ( int k = 1; k < 100; ++k )
+    {
+        // loop body
+        last = pacer.wait();
+    }
+
+    auto worst_lateness = pacer.lateness().max();
+
+    //! [wait loop_pacer example]
+
+    // ticks stay on the absolute schedule
+    auto scheduled = pacer.tick_count() - 1 + pacer.missed_count();
+    EXPECT_EQ( ( last - first ) % std::chrono::steady_clock::duration( 500us ), 0us );
+    EXPECT_LE( last - first, scheduled * std::chrono::steady_clock::duration( 500us ) );
+    EXPECT_EQ( pacer.next_target(), last + 500us );
+    EXPECT_EQ( pacer.tick_count(), 100u );
+    EXPECT_EQ( pacer.lateness().count(), 100u );
+    EXPECT_LT( worst_lateness, 1s );
+}
+
+TEST_F( Test_loop_pacer, overrun )
+{
+    struct overrun_tag {};
+    using clock = uteki::manual_clock<overrun_tag>;
+    clock::reset();
+
+    uteki::loop_pacer<clock> pacer( 1ms, 0us );
+    EXPECT_EQ( pacer.interval(), 1ms );
+    EXPECT_EQ( pacer.next_target(), clock::time_point( 1ms ) );
+
+    clock::advance( 1ms );
+    EXPECT_EQ( pacer.wait(), clock::time_point( 1ms ) );
+    EXPECT_EQ( pacer.overrun_count(), 0u );
+    EXPECT_EQ( pacer.lateness().max(), 0ms );
+
+    // a body that runs 1.5 intervals long skips one tick
+    clock::advance( 2500us );
+    EXPECT_EQ( pacer.wait(), clock::time_point( 3ms ) );
+    EXPECT_EQ( pacer.overrun_count(), 1u );
+    EXPECT_EQ( pacer.missed_count(), 1u );
+    EXPECT_EQ( pacer.lateness().max(), 500us );
+
+    // a body that runs a little long keeps the tick, late
+    clock::advance( 1200us );
+    EXPECT_EQ( pacer.wait(), clock::time_point( 4ms ) );
+    EXPECT_EQ( pacer.overrun_count(), 2u );
+    EXPECT_EQ( pacer.missed_count(), 1u );
+    EXPECT_EQ( pacer.tick_count(), 3u );
+
+    pacer.reset_statistics();
+    EXPECT_EQ( pacer.tick_count(), 0u );
+    EXPECT_EQ( pacer.lateness().count(), 0u );
+
+    pacer.restart();
+    EXPECT_EQ( pacer.next_target(), clock::now() + 1ms );
+}
+
+TEST_F( Test_loop_pacer, short_interval )
+{
+    struct short_interval_tag {};
+    using clock = uteki::manual_clock<short_interval_tag>;
+    clock::reset();
+
+    // zero and sub-tick intervals are raised to one tick
+    uteki::loop_pacer<clock> zero( 0us, 0us );
+    EXPECT_EQ( zero.interval(), clock::duration( 1 ) );
+    uteki::loop_pacer<clock> sub_tick( std::chrono::duration<double, std::pico>( 300.0 ), 0us );
+    EXPECT_EQ( sub_tick.interval(), clock::duration( 1 ) );
+
+    clock::advance( 10us );
+    EXPECT_EQ( zero.wait(), clock::now() );
+    EXPECT_EQ( zero.overrun_count(), 1u );
+}
+
+TEST_F( Test_loop_pacer, wait_until )
+{
+    using pacer_type = uteki::loop_pacer<>;
+
+    auto target = std::chrono::steady_clock::now() + 2ms;
+    auto woke = pacer_type::wait_until( target, std::chrono::microseconds( 200 ) );
+    EXPECT_GE( woke, target );
+
+    // a target in the past returns at once
+    auto past = std::chrono::steady_clock::now() - 1ms;
+    EXPECT_GE( pacer_type::wait_until( past, pacer_type::duration::zero() ), past );
+}
+
+TEST_F( Test_loop_pacer, calibrate )
+{
+    uteki::loop_pacer<> pacer( 1ms );
+    EXPECT_EQ( pacer.spin_slice(), 100us );
+
+    auto slice = pacer.calibrate( 10 );
+    EXPECT_EQ( pacer.spin_slice(), slice );
+    EXPECT_GE( slice, 0us );
+    EXPECT_LT( slice, 1s );
+}
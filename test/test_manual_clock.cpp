@@ -0,0 +1,177 @@
+//
+//  test manual_clock C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/manual_clock.h"
+#include "uteki/elapsed_timer.h"
+#include "uteki/stopwatch_timer.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_manual_clock : public ::testing::Test
+{
+protected:
+
+	Test_manual_clock()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_manual_clock() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_manual_clock, advance )
+{
+    //! [advance manual_clock example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/elapsed_timer.h"
+    // #include "uteki/manual_clock.h"
+
+    struct advance_test_tag;
+    using clock_type = uteki::manual_clock<advance_test_tag>;
+
+    uteki::elapsed_timer<clock_type> my_timer;
+    EXPECT_EQ( my_timer.value(), 0ns );
+
+    clock_type::advance( 250ms );
+    EXPECT_EQ( my_timer.value(), 250ms );
+
+    clock_type::advance( 2h );
+    EXPECT_EQ( my_timer.value<std::chrono::minutes>(), 120min );
+
+    //! [advance manual_clock example]
+}
+
+TEST_F( Test_manual_clock, clock_requirements )
+{
+    struct requirements_test_tag;
+    using clock_type = uteki::manual_clock<requirements_test_tag>;
+
+    EXPECT_TRUE( clock_type::is_steady );
+    EXPECT_EQ( clock_type::now().time_since_epoch(), 0ns );
+
+    clock_type::advance( 10us );
+    auto t1 = clock_type::now();
+    EXPECT_EQ( t1.time_since_epoch(), 10us );
+
+    // never moves backwards
+    clock_type::advance( -5us );
+    EXPECT_EQ( clock_type::now(), t1 );
+    clock_type::advance_to( t1 - 1us );
+    EXPECT_EQ( clock_type::now(), t1 );
+    clock_type::advance_to( t1 + 1ms );
+    EXPECT_EQ( clock_type::now(), t1 + 1ms );
+
+    // sub-tick steps are truncated
+    clock_type::advance( std::chrono::duration<double, std::nano>( 0.5 ) );
+    EXPECT_EQ( clock_type::now(), t1 + 1ms );
+
+    clock_type::reset();
+    EXPECT_EQ( clock_type::now().time_since_epoch(), 0ns );
+}
+
+TEST_F( Test_manual_clock, independent_tags )
+{
+    struct tag_a;
+    struct tag_b;
+    uteki::manual_clock<tag_a>::reset();
+    uteki::manual_clock<tag_b>::reset();
+
+    uteki::manual_clock<tag_a>::advance( 1s );
+    EXPECT_EQ( uteki::manual_clock<tag_a>::now().time_since_epoch(), 1s );
+    EXPECT_EQ( uteki::manual_clock<tag_b>::now().time_since_epoch(), 0s );
+}
+
+TEST_F( Test_manual_clock, stopwatch_timer )
+{
+    struct stopwatch_test_tag;
+    using clock_type = uteki::manual_clock<stopwatch_test_tag>;
+
+    uteki::stopwatch_timer<clock_type> my_timer( false );
+    clock_type::advance( 3s );
+    EXPECT_EQ( my_timer.value(), 0s );
+
+    my_timer.start();
+    clock_type::advance( 40ms );
+    my_timer.stop();
+    clock_type::advance( 1s );
+    EXPECT_EQ( my_timer.value(), 40ms );
+
+    my_timer.start();
+    clock_type::advance( 2ms );
+    EXPECT_EQ( my_timer.value(), 42ms );
+}
+
+TEST_F( Test_manual_clock, shared_between_threads )
+{
+    struct threads_test_tag;
+    using clock_type = uteki::manual_clock<threads_test_tag>;
+    clock_type::reset();
+
+    constexpr int thread_count = 4;
+    constexpr int steps = 1000;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < thread_count; ++t )
+    {
+        threads.emplace_back( []() {
+            for ( int k = 0; k < steps; ++k )
+            {
+                clock_type::advance( 1us );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( clock_type::now().time_since_epoch(), std::chrono::microseconds( thread_count * steps ) );
+}
@@ -0,0 +1,219 @@
+//
+//  test parallel_region C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/parallel_region.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_parallel_region : public ::testing::Test
+{
+protected:
+
+	Test_parallel_region()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_parallel_region() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_parallel_region, join )
+{
+    struct join_tag {};
+    using clock = uteki::manual_clock<join_tag>;
+    clock::reset();
+
+    //! [join parallel_region example]
+    uteki::parallel_region<clock> region( 4 );
+
+    for ( std::size_t worker = 0; worker < 4; ++worker )
+    {
+        region.start( worker );
+    }
+    clock::advance( 10us );
+    region.stop( 0 );
+    region.stop( 2 );
+    clock::advance( 10us );
+    region.stop( 3 );
+    clock::advance( 20us );
+    region.stop( 1 );
+    clock::advance( 5us );
+
+    auto balance = region.join();
+    EXPECT_EQ( balance.wall, 45us );
+    EXPECT_EQ( balance.participants, 4u );
+    EXPECT_EQ( balance.busy[0], 10us );
+    EXPECT_EQ( balance.busy[1], 40us );
+    EXPECT_EQ( balance.total_busy, 80us );
+    EXPECT_EQ( balance.mean_busy, 20us );
+    EXPECT_EQ( balance.max_busy, 40us );
+    EXPECT_EQ( balance.critical_worker, 1u );
+    EXPECT_DOUBLE_EQ( balance.imbalance, 2.0 );
+    EXPECT_EQ( balance.wait, 80us );
+    EXPECT_EQ( balance.participant_wait, 80us );
+    //! [join parallel_region example]
+
+    // the wall time is fixed at the join
+    clock::advance( 1ms );
+    EXPECT_EQ( region.current().wall, 45us );
+}
+
+TEST_F( Test_parallel_region, tasks )
+{
+    struct tasks_tag {};
+    using clock = uteki::manual_clock<tasks_tag>;
+    clock::reset();
+
+    uteki::parallel_region<clock> region( 3 );
+    auto empty = region.current();
+    EXPECT_EQ( empty.participants, 0u );
+    EXPECT_TRUE( empty.critical_worker == uteki::parallel_region<clock>::no_worker );
+    EXPECT_EQ( empty.imbalance, 0.0 );
+    EXPECT_EQ( empty.participant_imbalance, 0.0 );
+
+    {
+        uteki::parallel_region<clock>::task first( region, 0 );
+        clock::advance( 3us );
+    }
+    {
+        uteki::parallel_region<clock>::task second( region, 0 );
+        clock::advance( 3us );
+        // a running task counts up to now
+        EXPECT_EQ( region.current().busy[0], 6us );
+    }
+    {
+        uteki::parallel_region<clock>::task third( region, 2 );
+        clock::advance( 2us );
+    }
+    {
+        uteki::parallel_region<clock>::task stray( region, 7 );
+        clock::advance( 1us );
+    }
+
+    auto balance = region.join();
+    EXPECT_EQ( balance.tasks[0], 2u );
+    EXPECT_EQ( balance.tasks[1], 0u );
+    EXPECT_EQ( balance.tasks[2], 1u );
+    EXPECT_EQ( region.untimed(), 1u );
+
+    // the idle slot waits for the whole critical path
+    EXPECT_EQ( balance.participants, 2u );
+    EXPECT_EQ( balance.total_busy, 8us );
+    EXPECT_EQ( balance.mean_busy, std::chrono::nanoseconds( 8000 / 3 ) );
+    EXPECT_EQ( balance.critical_worker, 0u );
+    EXPECT_DOUBLE_EQ( balance.imbalance, 2.25 );
+    EXPECT_EQ( balance.wait, 10us );
+
+    // without it, only the participating slots are compared
+    EXPECT_EQ( balance.participant_mean_busy, 4us );
+    EXPECT_DOUBLE_EQ( balance.participant_imbalance, 1.5 );
+    EXPECT_EQ( balance.participant_wait, 4us );
+
+    region.fork();
+    EXPECT_EQ( region.current().participants, 0u );
+    EXPECT_EQ( region.current().wall, 0us );
+    EXPECT_EQ( region.untimed(), 0u );
+}
+
+TEST_F( Test_parallel_region, this_worker )
+{
+    uteki::parallel_region<> region( 1 );
+
+    std::size_t mine = region.this_worker();
+    EXPECT_EQ( mine, 0u );
+    EXPECT_EQ( region.this_worker(), mine );
+
+    std::size_t other = 0;
+    std::thread late( [&region, &other]() { other = region.this_worker(); } );
+    late.join();
+    EXPECT_TRUE( other == uteki::parallel_region<>::no_worker );
+
+    // a fork releases the slots
+    region.fork();
+    std::thread early( [&region, &other]() { other = region.this_worker(); } );
+    early.join();
+    EXPECT_EQ( other, 0u );
+    EXPECT_TRUE( region.this_worker() == uteki::parallel_region<>::no_worker );
+}
+
+TEST_F( Test_parallel_region, threads )
+{
+    constexpr std::size_t thread_count = 4;
+    uteki::parallel_region<> region( thread_count );
+    std::vector<std::size_t> workers( thread_count );
+
+    std::vector<std::thread> threads;
+    for ( std::size_t t = 0; t < thread_count; ++t )
+    {
+        threads.emplace_back( [&region, &workers, t]() {
+            workers[t] = region.this_worker();
+            for ( int k = 0; k < 2; ++k )
+            {
+                uteki::parallel_region<>::task chunk( region );
+                std::this_thread::sleep_for( std::chrono::milliseconds( 2 + 4 * t ) );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+    auto balance = region.join();
+
+    EXPECT_EQ( balance.participants, thread_count );
+    for ( std::size_t t = 0; t < thread_count; ++t )
+    {
+        EXPECT_EQ( balance.tasks[ workers[t] ], 2u );
+        EXPECT_GE( balance.busy[ workers[t] ], std::chrono::milliseconds( 4 + 8 * t ) );
+    }
+    EXPECT_EQ( balance.critical_worker, workers[ thread_count - 1 ] );
+    EXPECT_GT( balance.imbalance, 1.0 );
+    EXPECT_GE( balance.wall, balance.max_busy );
+}
@@ -0,0 +1,147 @@
+//
+//  test per_core_stats C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/per_core_stats.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_per_core_stats : public ::testing::Test
+{
+protected:
+
+	Test_per_core_stats()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_per_core_stats() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_per_core_stats, record )
+{
+    //! [record per_core_stats example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/per_core_stats.h"
+    // #include <thread>
+    // #include <vector>
+
+    // background merge every 10 ms
+    uteki::per_core_stats<> request_stats( 10ms );
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 8; ++t )
+    {
+        threads.emplace_back( [&request_stats, t]() {
+            for ( int k = 1; k <= 1000; ++k )
+            {
+                request_stats.record( std::chrono::microseconds( k + t ) );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    auto merged = request_stats.merge_now();
+
+    //! [record per_core_stats example]
+
+    EXPECT_EQ( merged.count, 8000u );
+    EXPECT_EQ( merged.min, 1us );
+    EXPECT_EQ( merged.max, 1007us );
+    EXPECT_EQ( merged.total, std::chrono::microseconds( 8 * 500500 + 1000 * 28 ) );
+    using fp_microseconds = std::chrono::duration<double, std::micro>;
+    EXPECT_DOUBLE_EQ( merged.mean<fp_microseconds>().count(), 504.0 );
+    EXPECT_EQ( request_stats.latest().count, 8000u );
+}
+
+TEST_F( Test_per_core_stats, background_merge )
+{
+    uteki::per_core_stats<> stats( 5ms, 4 );
+    EXPECT_EQ( stats.shard_count(), 4u );
+    EXPECT_EQ( stats.latest().count, 0u );
+    EXPECT_EQ( stats.latest().min, std::chrono::nanoseconds::zero() );
+
+    stats.record( 2ms );
+    stats.record( 3ms );
+
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while ( stats.latest().count < 2 && std::chrono::steady_clock::now() < deadline )
+    {
+        std::this_thread::sleep_for( 1ms );
+    }
+    auto merged = stats.latest();
+    EXPECT_EQ( merged.count, 2u );
+    EXPECT_EQ( merged.total, 5ms );
+    EXPECT_EQ( merged.min, 2ms );
+    EXPECT_EQ( merged.max, 3ms );
+}
+
+TEST_F( Test_per_core_stats, merge_on_demand )
+{
+    // a zero interval starts no merge thread
+    uteki::per_core_stats<> stats( std::chrono::milliseconds::zero(), 1 );
+
+    stats.record( 7us );
+    EXPECT_EQ( stats.latest().count, 0u );
+    EXPECT_EQ( stats.merge_now().count, 1u );
+    EXPECT_EQ( stats.latest().max, 7us );
+}
+
+TEST_F( Test_per_core_stats, current_cpu )
+{
+    using stats_type = uteki::per_core_stats<>;
+
+    // CPU numbers and fallback thread indexes are small
+    std::size_t cpu = stats_type::current_cpu();
+    EXPECT_LT( cpu, 4096u );
+}
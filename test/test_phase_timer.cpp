@@ -0,0 +1,165 @@
+//
+//  test phase_timer C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/phase_timer.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+
+class Test_phase_timer : public ::testing::Test
+{
+protected:
+
+	Test_phase_timer()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_phase_timer() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+
+enum class stage
+{
+    parse,
+    execute,
+    respond,
+    count
+};
+
+}
+
+TEST_F( Test_phase_timer, transition )
+{
+    struct transition_tag;
+    using clock = uteki::manual_clock<transition_tag>;
+    clock::reset();
+
+    //! [transition phase_timer example]
+    uteki::phase_timer<stage, static_cast<std::size_t>( stage::count ), clock> request( stage::parse );
+    clock::advance( 2us );
+    request.transition( stage::execute );
+    clock::advance( 30us );
+    request.transition( stage::respond );
+    clock::advance( 5us );
+    request.stop();
+
+    auto execute_time = request.value<std::chrono::microseconds>( stage::execute );
+    //! [transition phase_timer example]
+    EXPECT_EQ( execute_time, 30us );
+    EXPECT_EQ( request.value( stage::parse ), 2us );
+    EXPECT_EQ( request.value( stage::respond ), 5us );
+    EXPECT_EQ( request.total(), 37us );
+    EXPECT_EQ( request.entries( stage::execute ), 1u );
+    EXPECT_FALSE( request.is_running() );
+    EXPECT_EQ( request.current(), stage::respond );
+    EXPECT_EQ( ( uteki::phase_timer<stage>::phase_count ), 3u );
+}
+
+TEST_F( Test_phase_timer, revisit )
+{
+    struct revisit_tag;
+    using clock = uteki::manual_clock<revisit_tag>;
+    clock::reset();
+
+    using timer_type = uteki::phase_timer<stage, 3, clock>;
+    timer_type timer( stage::parse );
+    clock::advance( 1us );
+    EXPECT_EQ( timer.transition( stage::execute ), 1us );
+    clock::advance( 4us );
+    EXPECT_EQ( timer.transition( stage::parse ), 4us );
+    clock::advance( 1us );
+    timer.transition( stage::execute );
+    clock::advance( 4us );
+    timer.transition( stage::execute );
+
+    EXPECT_EQ( timer.value( stage::parse ), 2us );
+    EXPECT_EQ( timer.value( stage::execute ), 8us );
+    EXPECT_EQ( timer.entries( stage::parse ), 2u );
+    EXPECT_EQ( timer.entries( stage::execute ), 3u );
+
+    // time while stopped is not attributed
+    timer.stop();
+    EXPECT_EQ( timer.stop(), 0us );
+    clock::advance( 100us );
+    EXPECT_EQ( timer.transition( stage::respond ), 0us );
+    clock::advance( 1us );
+    timer.stop();
+    EXPECT_EQ( timer.value( stage::respond ), 1us );
+    EXPECT_EQ( timer.total(), 11us );
+}
+
+TEST_F( Test_phase_timer, merge_reset )
+{
+    struct merge_tag;
+    using clock = uteki::manual_clock<merge_tag>;
+    clock::reset();
+
+    using timer_type = uteki::phase_timer<stage, 3, clock>;
+    timer_type totals( stage::parse );
+    totals.stop();
+    for ( int k = 0; k < 3; ++k )
+    {
+        timer_type request( stage::parse );
+        clock::advance( 1us );
+        request.transition( stage::respond );
+        clock::advance( 2us );
+        request.stop();
+        totals.merge( request );
+    }
+    EXPECT_EQ( totals.value( stage::parse ), 3us );
+    EXPECT_EQ( totals.value( stage::respond ), 6us );
+    EXPECT_EQ( totals.entries( stage::parse ), 4u );
+
+    totals.reset( stage::execute );
+    EXPECT_EQ( totals.total(), 0us );
+    EXPECT_EQ( totals.entries( stage::execute ), 1u );
+    EXPECT_EQ( totals.entries( stage::parse ), 0u );
+    EXPECT_TRUE( totals.is_running() );
+}
@@ -0,0 +1,181 @@
+//
+//  test record_channel C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/record_channel.h"
+#include "uteki/latency_histogram.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_record_channel : public ::testing::Test
+{
+protected:
+
+	Test_record_channel()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_record_channel() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_record_channel, push )
+{
+    //! [push record_channel example]
+
+    // #include <chrono>
+    // #include "uteki/latency_histogram.h"
+    // #include "uteki/record_channel.h"
+
+    using record_type = uteki::timing_record<>;
+
+    uteki::record_channel<record_type> channel( 1024 );
+    uteki::latency_histogram<> histogram;
+
+    {
+        // histogram sink running on its own thread
+        uteki::channel_consumer<record_type> consumer( channel,
+            [&histogram]( const record_type& r ) { histogram.record( r.elapsed ); } );
+
+        for ( std::uint64_t k = 0; k < 500; ++k )
+        {
+            auto start = std::chrono::steady_clock::now();
+            // ... measured work ...
+            channel.push( record_type{ k, start, std::chrono::steady_clock::now() - start } );
+        }
+    }   // consumer drains the remaining records and stops
+
+    //! [push record_channel example]
+
+    EXPECT_EQ( histogram.count(), 500u );
+    EXPECT_EQ( channel.dropped(), 0u );
+    EXPECT_EQ( channel.size(), 0u );
+}
+
+TEST_F( Test_record_channel, drain_in_order )
+{
+    uteki::record_channel<int> channel( 5 );
+    EXPECT_EQ( channel.capacity(), 8u );
+
+    for ( int k = 0; k < 6; ++k )
+    {
+        EXPECT_TRUE( channel.push( k ) );
+    }
+    EXPECT_EQ( channel.size(), 6u );
+
+    std::vector<int> drained;
+    auto sink = [&drained]( int v ) { drained.push_back( v ); };
+    EXPECT_EQ( channel.drain( sink, 4 ), 4u );
+    EXPECT_EQ( channel.drain( sink ), 2u );
+    EXPECT_EQ( channel.drain( sink ), 0u );
+    EXPECT_EQ( drained, ( std::vector<int>{ 0, 1, 2, 3, 4, 5 } ) );
+
+    // positions wrap around the ring
+    for ( int round = 0; round < 10; ++round )
+    {
+        for ( int k = 0; k < 8; ++k )
+        {
+            EXPECT_TRUE( channel.push( k ) );
+        }
+        drained.clear();
+        EXPECT_EQ( channel.drain( sink ), 8u );
+        EXPECT_EQ( drained.back(), 7 );
+    }
+}
+
+TEST_F( Test_record_channel, drop_when_full )
+{
+    uteki::record_channel<int> channel( 4, uteki::overflow_policy::drop );
+
+    for ( int k = 0; k < 10; ++k )
+    {
+        channel.push( k );
+    }
+    EXPECT_EQ( channel.dropped(), 6u );
+
+    std::vector<int> drained;
+    channel.drain( [&drained]( int v ) { drained.push_back( v ); } );
+    EXPECT_EQ( drained, ( std::vector<int>{ 0, 1, 2, 3 } ) );
+}
+
+TEST_F( Test_record_channel, multiple_producers_block )
+{
+    uteki::record_channel<std::uint64_t> channel( 64, uteki::overflow_policy::block );
+
+    constexpr int producer_count = 4;
+    constexpr std::uint64_t records_per_producer = 20000;
+
+    std::uint64_t total = 0;
+    std::uint64_t received = 0;
+    std::vector<std::thread> producers;
+    {
+        uteki::channel_consumer<std::uint64_t> consumer( channel,
+            [&total, &received]( std::uint64_t v ) { total += v; ++received; },
+            std::chrono::microseconds( 10 ) );
+
+        for ( int p = 0; p < producer_count; ++p )
+        {
+            producers.emplace_back( [&channel]() {
+                for ( std::uint64_t k = 1; k <= records_per_producer; ++k )
+                {
+                    channel.push( k );
+                }
+            } );
+        }
+        for ( auto& th : producers )
+        {
+            th.join();
+        }
+        consumer.stop();
+        EXPECT_EQ( consumer.consumed(), producer_count * records_per_producer );
+    }
+
+    EXPECT_EQ( channel.dropped(), 0u );
+    EXPECT_EQ( received, producer_count * records_per_producer );
+    EXPECT_EQ( total, producer_count * records_per_producer * ( records_per_producer + 1 ) / 2 );
+}
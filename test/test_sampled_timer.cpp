@@ -0,0 +1,173 @@
+//
+//  test sampled_timer C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/sampled_timer.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_sampled_timer : public ::testing::Test
+{
+protected:
+
+	Test_sampled_timer()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_sampled_timer() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_sampled_timer, sample_every_invocation )
+{
+    uteki::sampled_timer<> my_timer( 1 );
+    EXPECT_EQ( my_timer.interval(), 1u );
+
+    for ( int k = 0; k < 100; ++k )
+    {
+        auto s = my_timer.measure();
+        EXPECT_TRUE( s.is_sampled() );
+    }
+
+    EXPECT_EQ( my_timer.sample_count(), 100u );
+    EXPECT_EQ( my_timer.estimated_count(), 100u );
+    EXPECT_EQ( my_timer.estimated_total(), my_timer.samples().sum() );
+}
+
+TEST_F( Test_sampled_timer, measure )
+{
+    //! [measure sampled_timer example]
+
+    // #include <chrono>
+    // #include "uteki/sampled_timer.h"
+
+    // time about one in 64 calls
+    uteki::sampled_timer<> hot_timer( 64 );
+
+    auto hot_function = [&hot_timer]( int x ) {
+        auto timing = hot_timer.measure();
+        return x * 3 + 1;
+    };
+
+    long long total = 0;
+    for ( int k = 0; k < 1000000; ++k )
+    {
+        total += hot_function( k );
+    }
+
+    // scaled estimate of the number of calls
+    std::uint64_t calls = hot_timer.estimated_count();
+
+    //! [measure sampled_timer example]
+
+    EXPECT_GT( total, 0 );
+    EXPECT_NEAR( static_cast<double>( calls ), 1000000.0, 30000.0 );
+    EXPECT_NEAR( static_cast<double>( hot_timer.sample_count() ), 1000000.0 / 64, 470.0 );
+    EXPECT_GT( hot_timer.estimated_rate(), 0.0 );
+}
+
+TEST_F( Test_sampled_timer, interleaved_timers_unbiased )
+{
+    uteki::sampled_timer<> timer_a( 4 );
+    uteki::sampled_timer<> timer_b( 64 );
+
+    constexpr int invocations = 400000;
+    for ( int k = 0; k < invocations; ++k )
+    {
+        auto sa = timer_a.measure();
+        auto sb = timer_b.measure();
+    }
+
+    EXPECT_NEAR( static_cast<double>( timer_a.estimated_count() ), invocations, 0.02 * invocations );
+    EXPECT_NEAR( static_cast<double>( timer_b.estimated_count() ), invocations, 0.05 * invocations );
+}
+
+TEST_F( Test_sampled_timer, estimated_total )
+{
+    uteki::sampled_timer<> my_timer( 8 );
+
+    for ( int k = 0; k < 80000; ++k )
+    {
+        if ( my_timer.should_sample() )
+        {
+            my_timer.record_sample( 10us );
+        }
+    }
+
+    auto total = my_timer.estimated_total<std::chrono::duration<double>>();
+    EXPECT_NEAR( total.count(), 0.8, 0.05 );
+    EXPECT_EQ( my_timer.samples().max(), 10us );
+
+    my_timer.reset();
+    EXPECT_EQ( my_timer.sample_count(), 0u );
+}
+
+TEST_F( Test_sampled_timer, multiple_threads )
+{
+    uteki::sampled_timer<> my_timer( 16 );
+    constexpr int thread_count = 4;
+    constexpr int invocations = 100000;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < thread_count; ++t )
+    {
+        threads.emplace_back( [&my_timer]() {
+            for ( int k = 0; k < invocations; ++k )
+            {
+                auto s = my_timer.measure();
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    double expected = thread_count * invocations;
+    EXPECT_NEAR( static_cast<double>( my_timer.estimated_count() ), expected, 0.03 * expected );
+}
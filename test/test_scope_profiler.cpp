@@ -0,0 +1,467 @@
+//
+//  test scope_profiler C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/scope_profiler.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_scope_profiler : public ::testing::Test
+{
+protected:
+
+	Test_scope_profiler()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_scope_profiler() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_scope_profiler, scope )
+{
+    struct scope_tag {};
+    using clock = uteki::manual_clock<scope_tag>;
+    clock::reset();
+
+    //! [scope scope_profiler example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/scope_profiler.h"
+    // #include <string>
+
+    uteki::scope_profiler<clock> profiler;
+    {
+        uteki::scope_profiler<clock>::scope request( profiler, "request" );
+        clock::advance( 1ms );
+        {
+            uteki::scope_profiler<clock>::scope parse( profiler, "parse" );
+            clock::advance( 2ms );
+        }
+        for ( int k = 0; k < 3; ++k )
+        {
+            uteki::scope_profiler<clock>::scope query( profiler, "query" );
+            clock::advance( 5ms );
+        }
+    }
+
+    // self time in microseconds per stack, ready for flamegraph.pl
+    std::string stacks = profiler.folded();
+
+    //! [scope scope_profiler example]
+
+    EXPECT_EQ( stacks, "request;query 15000\nrequest;parse 2000\nrequest 1000\n" );
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>(),
+               "request;query 15\nrequest;parse 2\nrequest 1\n" );
+    EXPECT_EQ( profiler.dropped(), 0u );
+}
+
+TEST_F( Test_scope_profiler, paths )
+{
+    struct paths_tag {};
+    using clock = uteki::manual_clock<paths_tag>;
+    using profiler_type = uteki::scope_profiler<clock>;
+    clock::reset();
+
+    profiler_type profiler;
+    std::string name = "leaf";
+    {
+        profiler_type::scope a( profiler, "a" );
+        {
+            // same name under different parents gives different paths
+            profiler_type::scope leaf( profiler, "leaf" );
+            clock::advance( 3ms );
+        }
+    }
+    {
+        profiler_type::scope b( profiler, "b" );
+        {
+            profiler_type::scope leaf( profiler, name.c_str() );
+            clock::advance( 4ms );
+        }
+        {
+            // an equal name at another address shares the path
+            profiler_type::scope leaf( profiler, "leaf" );
+            clock::advance( 4ms );
+        }
+    }
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>(), "b;leaf 8\na;leaf 3\na 0\nb 0\n" );
+
+    profiler.reset();
+    EXPECT_EQ( profiler.folded(), "" );
+    {
+        profiler_type::scope a( profiler, "a" );
+        clock::advance( 1ms );
+    }
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>(), "a 1\n" );
+}
+
+TEST_F( Test_scope_profiler, bounded )
+{
+    struct bounded_tag {};
+    using clock = uteki::manual_clock<bounded_tag>;
+    using profiler_type = uteki::scope_profiler<clock>;
+    clock::reset();
+
+    profiler_type profiler( 2 );
+    EXPECT_EQ( profiler.max_nodes(), 2u );
+    {
+        profiler_type::scope a( profiler, "a" );
+        {
+            profiler_type::scope b( profiler, "b" );
+            {
+                // no room for a third path; its time counts as b's self time
+                profiler_type::scope c( profiler, "c" );
+                {
+                    profiler_type::scope d( profiler, "d" );
+                    clock::advance( 1ms );
+                }
+            }
+        }
+        {
+            profiler_type::scope b( profiler, "b" );
+            clock::advance( 1ms );
+        }
+    }
+    EXPECT_EQ( profiler.dropped(), 2u );
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>(), "a;b 2\na 0\n" );
+}
+
+TEST_F( Test_scope_profiler, threads )
+{
+    using profiler_type = uteki::scope_profiler<>;
+    profiler_type profiler;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 4; ++t )
+    {
+        threads.emplace_back( [&profiler]() {
+            for ( int k = 0; k < 1000; ++k )
+            {
+                profiler_type::scope outer( profiler, "worker" );
+                profiler_type::scope inner( profiler, "step" );
+            }
+        } );
+    }
+    // dumping while threads record is safe
+    std::string during = profiler.folded<std::chrono::nanoseconds>();
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    std::istringstream lines( profiler.folded<std::chrono::nanoseconds>() );
+    std::string path;
+    long long self = 0;
+    std::vector<std::string> paths;
+    while ( lines >> path >> self )
+    {
+        paths.push_back( path );
+        EXPECT_GE( self, 0 );
+    }
+    ASSERT_EQ( paths.size(), 2u );
+    EXPECT_TRUE( ( paths[0] == "worker" && paths[1] == "worker;step" ) ||
+                 ( paths[0] == "worker;step" && paths[1] == "worker" ) );
+}
+
+TEST_F( Test_scope_profiler, exited_threads )
+{
+    struct exited_tag {};
+    using clock = uteki::manual_clock<exited_tag>;
+    using profiler_type = uteki::scope_profiler<clock>;
+    clock::reset();
+
+    profiler_type profiler( 16, 0 );
+    for ( int t = 0; t < 3; ++t )
+    {
+        std::thread worker( [&profiler]() {
+            profiler_type::scope outer( profiler, "worker" );
+            profiler_type::scope inner( profiler, "step" );
+        } );
+        worker.join();
+    }
+    {
+        profiler_type::scope own( profiler, "main" );
+    }
+
+    // the trees of exited threads are merged into one entry
+    auto threads = profiler.thread_overhead();
+    ASSERT_EQ( threads.size(), 2u );
+    std::size_t exited = ( threads[0].thread == std::thread::id() ) ? 0 : 1;
+    EXPECT_EQ( threads[exited].thread, std::thread::id() );
+    EXPECT_EQ( threads[exited].scopes, 6u );
+    EXPECT_EQ( threads[1 - exited].thread, std::this_thread::get_id() );
+    EXPECT_EQ( threads[1 - exited].scopes, 1u );
+
+    auto paths = profiler.report();
+    ASSERT_EQ( paths.size(), 3u );
+    EXPECT_EQ( paths[0].path, "main" );
+    EXPECT_EQ( paths[1].path, "worker" );
+    EXPECT_EQ( paths[1].calls, 3u );
+    EXPECT_EQ( paths[1].descendants, 3u );
+    EXPECT_EQ( paths[2].path, "worker;step" );
+    EXPECT_EQ( paths[2].calls, 3u );
+
+    profiler.reset();
+    EXPECT_EQ( profiler.thread_overhead().size(), 1u );
+    EXPECT_EQ( profiler.folded(), "" );
+
+    // a thread may outlive a profiler it recorded into
+    std::atomic<bool> recorded( false );
+    std::atomic<bool> destroyed( false );
+    std::thread late;
+    {
+        profiler_type gone( 16, 0 );
+        late = std::thread( [&]() {
+            {
+                profiler_type::scope s( gone, "late" );
+            }
+            recorded = true;
+            while ( ! destroyed )
+            {
+                std::this_thread::yield();
+            }
+        } );
+        while ( ! recorded )
+        {
+            std::this_thread::yield();
+        }
+        EXPECT_EQ( gone.thread_overhead().size(), 1u );
+    }
+    destroyed = true;
+    late.join();
+}
+
+TEST_F( Test_scope_profiler, interleaved_profilers )
+{
+    struct interleaved_tag {};
+    using clock = uteki::manual_clock<interleaved_tag>;
+    using profiler_type = uteki::scope_profiler<clock>;
+    clock::reset();
+
+    // more profilers than cache slots, used in turn by one thread
+    std::vector< std::unique_ptr<profiler_type> > profilers;
+    for ( std::size_t k = 0; k < profiler_type::local_slots + 3; ++k )
+    {
+        profilers.emplace_back( new profiler_type( 16, 0 ) );
+    }
+    for ( int round = 0; round < 10; ++round )
+    {
+        for ( std::size_t k = 0; k < profilers.size(); ++k )
+        {
+            profiler_type::scope s( *profilers[k], "work" );
+            clock::advance( std::chrono::milliseconds( k + 1 ) );
+        }
+    }
+    for ( std::size_t k = 0; k < profilers.size(); ++k )
+    {
+        auto paths = profilers[k]->report();
+        ASSERT_EQ( paths.size(), 1u );
+        EXPECT_EQ( paths[0].calls, 10u );
+        EXPECT_EQ( paths[0].inclusive, std::chrono::milliseconds( 10 * ( k + 1 ) ) );
+        EXPECT_EQ( profilers[k]->thread_overhead().size(), 1u );
+    }
+}
+
+TEST_F( Test_scope_profiler, report )
+{
+    struct report_tag {};
+    using clock = uteki::manual_clock<report_tag>;
+    clock::reset();
+    using profiler_type = uteki::scope_profiler<clock>;
+
+    //! [report scope_profiler example]
+
+    profiler_type profiler;
+    // a manual clock measures no overhead; pretend each scope costs 1ms
+    profiler.set_scope_overhead( 1ms );
+    {
+        profiler_type::scope request( profiler, "request" );
+        clock::advance( 2ms );
+        {
+            profiler_type::scope parse( profiler, "parse" );
+            clock::advance( 3ms );
+        }
+        {
+            profiler_type::scope query( profiler, "query" );
+            clock::advance( 1ms );
+            profiler_type::scope fetch( profiler, "fetch" );
+            clock::advance( 4ms );
+        }
+        clock::advance( 1ms );
+    }
+
+    auto paths = profiler.report();
+    auto threads = profiler.thread_overhead();
+
+    //! [report scope_profiler example]
+
+    ASSERT_EQ( paths.size(), 4u );
+    const auto& request = paths[0];
+    EXPECT_EQ( request.path, "request" );
+    EXPECT_EQ( request.calls, 1u );
+    EXPECT_EQ( request.descendants, 3u );
+    EXPECT_EQ( request.inclusive, 11ms );
+    EXPECT_EQ( request.exclusive, 3ms );
+    EXPECT_EQ( request.corrected_inclusive, 8ms );
+    EXPECT_EQ( request.corrected_exclusive, 1ms );
+
+    const auto& query = paths[2];
+    EXPECT_EQ( query.path, "request;query" );
+    EXPECT_EQ( query.descendants, 1u );
+    EXPECT_EQ( query.corrected_inclusive, 4ms );
+    // one nested scope's overhead exceeds the measured self time
+    EXPECT_EQ( query.corrected_exclusive, 0ms );
+
+    const auto& fetch = paths[3];
+    EXPECT_EQ( fetch.path, "request;query;fetch" );
+    EXPECT_EQ( fetch.descendants, 0u );
+    EXPECT_EQ( fetch.corrected_inclusive, fetch.inclusive );
+
+    ASSERT_EQ( threads.size(), 1u );
+    EXPECT_EQ( threads[0].thread, std::this_thread::get_id() );
+    EXPECT_EQ( threads[0].scopes, 4u );
+    EXPECT_EQ( threads[0].instrumented, 11ms );
+    EXPECT_EQ( threads[0].overhead, 4ms );
+
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>(),
+               "request;query;fetch 4\nrequest 3\nrequest;parse 3\nrequest;query 1\n" );
+    EXPECT_EQ( profiler.folded<std::chrono::milliseconds>( true ),
+               "request;query;fetch 4\nrequest;parse 3\nrequest 1\nrequest;query 0\n" );
+
+    profiler.reset();
+    EXPECT_EQ( profiler.thread_overhead()[0].scopes, 0u );
+    EXPECT_TRUE( profiler.report().empty() );
+}
+
+TEST_F( Test_scope_profiler, window_overhead )
+{
+    struct window_tag {};
+    using clock = uteki::manual_clock<window_tag>;
+    clock::reset();
+    using profiler_type = uteki::scope_profiler<clock>;
+
+    profiler_type profiler;
+    // each scope costs 1ms, 200us of it between its own clock readings
+    profiler.set_scope_overhead( 1ms, 200us );
+    EXPECT_EQ( profiler.window_overhead(), 200us );
+    {
+        profiler_type::scope outer( profiler, "outer" );
+        clock::advance( 3ms );
+        for ( int k = 0; k < 2; ++k )
+        {
+            profiler_type::scope inner( profiler, "inner" );
+            clock::advance( 1ms );
+        }
+    }
+
+    auto paths = profiler.report();
+    ASSERT_EQ( paths.size(), 2u );
+    const auto& outer = paths[0];
+    EXPECT_EQ( outer.inclusive, 5ms );
+    EXPECT_EQ( outer.corrected_inclusive, 2800us );
+    EXPECT_EQ( outer.corrected_exclusive, 1200us );
+    const auto& inner = paths[1];
+    EXPECT_EQ( inner.corrected_inclusive, 1600us );
+    EXPECT_EQ( inner.corrected_exclusive, 1600us );
+
+    // the window part cannot exceed the whole
+    profiler.set_scope_overhead( 1ms, 2ms );
+    EXPECT_EQ( profiler.window_overhead(), 1ms );
+}
+
+TEST_F( Test_scope_profiler, calibrate )
+{
+    struct calibrate_tag {};
+    using manual = uteki::scope_profiler< uteki::manual_clock<calibrate_tag> >;
+    manual still;
+    EXPECT_EQ( still.scope_overhead().count(), 0 );
+
+    uteki::scope_profiler<> profiler;
+    EXPECT_GT( profiler.scope_overhead().count(), 0 );
+    EXPECT_LT( profiler.scope_overhead(), 1ms );
+
+    uteki::scope_profiler<> uncalibrated( 16, 0 );
+    EXPECT_EQ( uncalibrated.scope_overhead().count(), 0 );
+    uncalibrated.calibrate( 100 );
+    EXPECT_GT( uncalibrated.scope_overhead().count(), 0 );
+}
+
+TEST_F( Test_scope_profiler, calibrated_correction )
+{
+    // empty nested scopes measure nothing but their own overhead
+    uteki::scope_profiler<> profiler( 16, 10000 );
+    EXPECT_LE( profiler.window_overhead(), profiler.scope_overhead() );
+    for ( int k = 0; k < 100; ++k )
+    {
+        uteki::scope_profiler<>::scope outer( profiler, "outer" );
+        for ( int j = 0; j < 1000; ++j )
+        {
+            uteki::scope_profiler<>::scope inner( profiler, "inner" );
+        }
+    }
+
+    auto paths = profiler.report();
+    ASSERT_EQ( paths.size(), 2u );
+    const auto& outer = paths[0];
+    const auto& inner = paths[1];
+    ASSERT_EQ( inner.path, "outer;inner" );
+
+    // a child never costs more than its parent, and the overhead is removed
+    // from both, even though the calibrated means differ from run to run
+    EXPECT_LE( inner.corrected_inclusive, outer.corrected_inclusive );
+    EXPECT_LT( inner.corrected_inclusive, inner.inclusive );
+    EXPECT_LT( outer.corrected_inclusive, outer.inclusive );
+    EXPECT_GT( profiler.window_overhead().count(), 0 );
+}
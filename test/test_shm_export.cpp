@@ -0,0 +1,240 @@
+//
+//  test shm_export C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/shm_export.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+
+class Test_shm_export : public ::testing::Test
+{
+protected:
+
+	Test_shm_export()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_shm_export() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+
+std::string segment_name( const char* test )
+{
+    return "/uteki_test_" + std::string( test ) + "_" + std::to_string( ::getpid() );
+}
+
+}
+
+TEST_F( Test_shm_export, publish )
+{
+    std::string name = segment_name( "publish" );
+    //! [publish shm_export example]
+    uteki::shm_exporter exporter;
+    ASSERT_TRUE( exporter.open( name, 16 ) );
+    std::size_t index = exporter.add( "request" );
+
+    uteki::latency_histogram<std::chrono::microseconds> latency;
+    latency.record( 100us );
+    latency.record( 300us );
+    exporter.publish( index, latency );
+
+    // in another process
+    uteki::shm_reader reader;
+    ASSERT_TRUE( reader.open( name ) );
+    uteki::shm_snapshot snapshot;
+    ASSERT_TRUE( reader.read( index, snapshot ) );
+    //! [publish shm_export example]
+
+    EXPECT_STREQ( snapshot.name, "request" );
+    EXPECT_EQ( snapshot.generation, 1u );
+    EXPECT_EQ( snapshot.stats.count, 2u );
+    EXPECT_EQ( snapshot.stats.total_ns, 400000u );
+    EXPECT_EQ( snapshot.stats.min_ns, 100000u );
+    EXPECT_EQ( snapshot.stats.max_ns, 300000u );
+    EXPECT_EQ( reader.writer_pid(), static_cast<std::uint32_t>( ::getpid() ) );
+    EXPECT_EQ( reader.capacity(), 16u );
+    EXPECT_EQ( reader.size(), 1u );
+}
+
+TEST_F( Test_shm_export, capacity )
+{
+    uteki::shm_exporter exporter;
+    ASSERT_TRUE( exporter.open( segment_name( "capacity" ), 2 ) );
+    EXPECT_EQ( exporter.add( "a" ), 0u );
+    EXPECT_EQ( exporter.add( "b" ), 1u );
+    EXPECT_TRUE( exporter.add( "c" ) == uteki::shm_exporter::no_record );
+    EXPECT_EQ( exporter.size(), 2u );
+
+    // indexes that were never added publish nothing
+    uteki::shm_stats stats = { 1, 1, 1, 1, 1, 1, 1, 1 };
+    exporter.publish( uteki::shm_exporter::no_record, stats );
+    exporter.publish( 2, stats );
+    uteki::shm_exporter closed;
+    closed.publish( 0, stats );
+
+    std::string long_name( 100, 'n' );
+    uteki::shm_exporter other;
+    ASSERT_TRUE( other.open( segment_name( "capacity_other" ), 1 ) );
+    std::size_t index = other.add( long_name.c_str() );
+    uteki::shm_reader reader;
+    ASSERT_TRUE( reader.open( other.name() ) );
+    uteki::shm_snapshot snapshot;
+    ASSERT_TRUE( reader.read( index, snapshot ) );
+    EXPECT_EQ( std::strlen( snapshot.name ), uteki::shm_snapshot::name_size - 1 );
+    EXPECT_EQ( snapshot.generation, 0u );
+}
+
+TEST_F( Test_shm_export, reopen )
+{
+    std::string name = segment_name( "reopen" );
+    uteki::shm_exporter old_writer;
+    ASSERT_TRUE( old_writer.open( name, 4 ) );
+    std::size_t index = old_writer.add( "old" );
+    uteki::shm_stats stats = { 5, 5, 1, 1, 1, 1, 1, 1 };
+    old_writer.publish( index, stats );
+    uteki::shm_reader old_reader;
+    ASSERT_TRUE( old_reader.open( name ) );
+    EXPECT_FALSE( old_reader.replaced() );
+
+    // a new writer of the same name leaves the attached reader's segment intact
+    uteki::shm_exporter new_writer;
+    ASSERT_TRUE( new_writer.open( name, 8 ) );
+    new_writer.add( "new" );
+
+    uteki::shm_snapshot snapshot;
+    ASSERT_TRUE( old_reader.read( index, snapshot ) );
+    EXPECT_STREQ( snapshot.name, "old" );
+    EXPECT_EQ( snapshot.stats.count, 5u );
+    EXPECT_EQ( old_reader.capacity(), 4u );
+    EXPECT_TRUE( old_reader.replaced() );
+
+    uteki::shm_reader new_reader;
+    ASSERT_TRUE( new_reader.open( name ) );
+    ASSERT_TRUE( new_reader.read( 0, snapshot ) );
+    EXPECT_STREQ( snapshot.name, "new" );
+    EXPECT_EQ( new_reader.capacity(), 8u );
+    EXPECT_FALSE( new_reader.replaced() );
+
+    // closing the replaced writer does not remove the new segment
+    old_writer.close();
+    uteki::shm_reader late_reader;
+    EXPECT_TRUE( late_reader.open( name ) );
+
+    // a removed segment is noticed as well
+    new_writer.close();
+    EXPECT_TRUE( late_reader.replaced() );
+}
+
+TEST_F( Test_shm_export, open_errors )
+{
+    uteki::shm_reader reader;
+    std::string error;
+    EXPECT_FALSE( reader.open( segment_name( "missing" ), &error ) );
+    EXPECT_NE( std::string::npos, error.find( "shm_open" ) );
+    EXPECT_FALSE( reader.is_open() );
+
+    std::string name = segment_name( "closed" );
+    {
+        uteki::shm_exporter exporter;
+        ASSERT_TRUE( exporter.open( name, 1 ) );
+        EXPECT_TRUE( exporter.is_open() );
+    }
+    // the segment is removed with the exporter
+    EXPECT_FALSE( reader.open( name ) );
+}
+
+TEST_F( Test_shm_export, concurrent_publish )
+{
+    uteki::shm_exporter exporter;
+    ASSERT_TRUE( exporter.open( segment_name( "concurrent" ), 1 ) );
+    std::size_t index = exporter.add( "counter" );
+    uteki::shm_reader reader;
+    ASSERT_TRUE( reader.open( exporter.name() ) );
+
+    std::atomic<bool> done( false );
+    std::thread writer( [&]() {
+        for ( std::uint64_t n = 1; n <= 20000; ++n )
+        {
+            // every field holds the same value, so a torn read is detectable
+            uteki::shm_stats stats = { n, n, n, n, n, n, n, n };
+            exporter.publish( index, stats );
+        }
+        done.store( true );
+    } );
+
+    std::uint64_t last = 0;
+    std::size_t torn = 0;
+    while ( ! done.load() )
+    {
+        uteki::shm_snapshot snapshot;
+        if ( reader.read( index, snapshot ) )
+        {
+            std::uint64_t values[8];
+            std::memcpy( values, &snapshot.stats, sizeof( values ) );
+            for ( std::size_t k = 1; k < 8; ++k )
+            {
+                torn += ( values[k] != values[0] ) ? 1 : 0;
+            }
+            EXPECT_GE( values[0], last );
+            last = values[0];
+        }
+    }
+    writer.join();
+    EXPECT_EQ( torn, 0u );
+
+    uteki::shm_snapshot snapshot;
+    ASSERT_TRUE( reader.read( index, snapshot ) );
+    EXPECT_EQ( snapshot.stats.p999_ns, 20000u );
+    EXPECT_EQ( snapshot.generation, 20000u );
+}
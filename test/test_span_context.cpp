@@ -0,0 +1,215 @@
+//
+//  test span_context C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/span_context.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+using namespace std::chrono_literals;
+
+
+class Test_span_context : public ::testing::Test
+{
+protected:
+
+	Test_span_context()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_span_context() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+
+//! minimal blocking queue for handing spans between pipeline threads
+template< class T >
+class handoff_queue
+{
+public:
+    void push( const T& item )
+    {
+        std::lock_guard<std::mutex> guard( lock_ );
+        items_.push_back( item );
+        ready_.notify_one();
+    }
+
+    T pop( )
+    {
+        std::unique_lock<std::mutex> guard( lock_ );
+        ready_.wait( guard, [this]() { return ! items_.empty(); } );
+        T item = items_.front();
+        items_.pop_front();
+        return item;
+    }
+
+private:
+    std::mutex lock_;
+    std::condition_variable ready_;
+    std::deque<T> items_;
+};
+
+}
+
+TEST_F( Test_span_context, trivially_copyable )
+{
+    EXPECT_TRUE( std::is_trivially_copyable< uteki::span_context<> >::value );
+    EXPECT_TRUE( ( std::is_trivially_copyable< uteki::span_context<std::chrono::steady_clock, 32> >::value ) );
+}
+
+TEST_F( Test_span_context, mark )
+{
+    //! [mark span_context example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/manual_clock.h"
+    // #include "uteki/span_context.h"
+
+    struct mark_test_tag;
+    using clock_type = uteki::manual_clock<mark_test_tag>;
+    using span_type = uteki::span_context<clock_type>;
+
+    enum stage : span_type::stage_type { accepted, processed, completed };
+
+    span_type span = span_type::begin( 42 );
+    clock_type::advance( 5us );
+    span.mark( accepted );
+
+    span_type handed_off = span;     // copied into the next stage's queue
+    clock_type::advance( 120us );
+    handed_off.mark( processed );
+    clock_type::advance( 10us );
+    handed_off.mark( completed );
+
+    EXPECT_EQ( handed_off.stage_count(), 3u );
+    EXPECT_EQ( handed_off.stage_duration( 0 ), 5us );
+    EXPECT_EQ( handed_off.stage_duration( 1 ), 120us );
+    EXPECT_EQ( handed_off.stage_duration( 2 ), 10us );
+    EXPECT_EQ( handed_off.elapsed(), 135us );
+
+    //! [mark span_context example]
+
+    EXPECT_EQ( handed_off.id(), 42u );
+    EXPECT_EQ( handed_off.parent_id(), 0u );
+    EXPECT_EQ( handed_off.stage( 1 ), processed );
+    EXPECT_EQ( span.stage_count(), 1u );
+    EXPECT_EQ( span.elapsed(), 5us );
+    EXPECT_EQ( span.value(), 135us );
+}
+
+TEST_F( Test_span_context, child_and_capacity )
+{
+    using span_type = uteki::span_context<std::chrono::steady_clock, 2>;
+
+    span_type parent = span_type::begin( 1 );
+    EXPECT_EQ( parent.elapsed(), span_type::duration::zero() );
+
+    span_type child = parent.child( 2 );
+    EXPECT_EQ( child.id(), 2u );
+    EXPECT_EQ( child.parent_id(), 1u );
+    EXPECT_GE( child.start_time(), parent.start_time() );
+
+    EXPECT_TRUE( child.mark( 10 ) );
+    EXPECT_TRUE( child.mark( 11 ) );
+    EXPECT_FALSE( child.mark( 12 ) );
+    EXPECT_EQ( child.stage_count(), span_type::max_stages );
+    EXPECT_EQ( child.stage( 1 ), 11 );
+}
+
+TEST_F( Test_span_context, pipeline_threads )
+{
+    using span_type = uteki::span_context<>;
+
+    constexpr int request_count = 100;
+    handoff_queue<span_type> to_worker;
+    handoff_queue<span_type> to_completion;
+    handoff_queue<span_type> finished;
+
+    std::thread worker( [&]() {
+        for ( int k = 0; k < request_count; ++k )
+        {
+            span_type span = to_worker.pop();
+            std::this_thread::sleep_for( 50us );
+            span.mark( 1 );
+            to_completion.push( span );
+        }
+    } );
+    std::thread completion( [&]() {
+        for ( int k = 0; k < request_count; ++k )
+        {
+            span_type span = to_completion.pop();
+            span.mark( 2 );
+            finished.push( span );
+        }
+    } );
+
+    for ( int k = 0; k < request_count; ++k )
+    {
+        span_type span = span_type::begin( static_cast<span_type::id_type>( k + 1 ) );
+        span.mark( 0 );
+        to_worker.push( span );
+    }
+
+    for ( int k = 0; k < request_count; ++k )
+    {
+        span_type span = finished.pop();
+        ASSERT_EQ( span.stage_count(), 3u );
+        EXPECT_EQ( span.stage( 0 ), 0 );
+        EXPECT_EQ( span.stage( 2 ), 2 );
+        EXPECT_GE( span.stage_duration( 1 ), 50us );
+        EXPECT_EQ( span.elapsed(),
+                   span.stage_duration( 0 ) + span.stage_duration( 1 ) + span.stage_duration( 2 ) );
+    }
+
+    worker.join();
+    completion.join();
+}
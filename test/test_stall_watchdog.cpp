@@ -0,0 +1,316 @@
+//
+//  test stall_watchdog C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/stall_watchdog.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_stall_watchdog : public ::testing::Test
+{
+protected:
+
+	Test_stall_watchdog()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_stall_watchdog() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_stall_watchdog, guard )
+{
+    //! [guard stall_watchdog example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/stall_watchdog.h"
+    // #include <cstdint>
+    // #include <thread>
+
+    std::atomic<std::uint64_t> stalled_tag( 0 );
+
+    // report requests running longer than 20 ms, scanning every 5 ms
+    uteki::stall_watchdog<> watchdog( 64, 20ms, 5ms,
+        [&stalled_tag]( const uteki::stall_watchdog<>::stall_report& report ) {
+            stalled_tag.store( report.tag );
+        } );
+
+    {
+        uteki::stall_watchdog<>::guard in_flight( watchdog, 42 );
+        // a request that takes too long
+        std::this_thread::sleep_for( 100ms );
+    }
+
+    //! [guard stall_watchdog example]
+
+    EXPECT_EQ( stalled_tag.load(), 42u );
+    EXPECT_EQ( watchdog.stalls_reported(), 1u );
+}
+
+TEST_F( Test_stall_watchdog, scan )
+{
+    struct scan_tag {};
+    using clock = uteki::manual_clock<scan_tag>;
+    using watchdog_type = uteki::stall_watchdog<clock>;
+    clock::reset();
+
+    std::vector<watchdog_type::stall_report> reports;
+    // a zero scan interval starts no scan thread
+    watchdog_type watchdog( 4, 10ms, std::chrono::milliseconds::zero(),
+        [&reports]( const watchdog_type::stall_report& report ) {
+            reports.push_back( report );
+        } );
+
+    auto first = watchdog.register_start( 1 );
+    clock::advance( 5ms );
+    auto second = watchdog.register_start( 2 );
+    EXPECT_EQ( watchdog.scan(), 0u );
+
+    clock::advance( 6ms );
+    EXPECT_EQ( watchdog.scan(), 1u );
+    ASSERT_EQ( reports.size(), 1u );
+    EXPECT_EQ( reports[0].tag, 1u );
+    EXPECT_EQ( reports[0].elapsed, 11ms );
+    EXPECT_EQ( reports[0].start, clock::time_point( ) );
+    EXPECT_EQ( reports[0].frame_count, 0 );
+
+    // each stall is reported once
+    clock::advance( 5ms );
+    EXPECT_EQ( watchdog.scan(), 1u );
+    ASSERT_EQ( reports.size(), 2u );
+    EXPECT_EQ( reports[1].tag, 2u );
+    EXPECT_EQ( watchdog.scan(), 0u );
+
+    // a reused slot is reported again
+    watchdog.deregister( first );
+    watchdog.deregister( second );
+    auto third = watchdog.register_start( 3 );
+    clock::advance( 20ms );
+    EXPECT_EQ( watchdog.scan(), 1u );
+    ASSERT_EQ( reports.size(), 3u );
+    EXPECT_EQ( reports[2].tag, 3u );
+    EXPECT_EQ( reports[2].elapsed, 20ms );
+    watchdog.deregister( third );
+
+    EXPECT_EQ( watchdog.scan(), 0u );
+    EXPECT_EQ( watchdog.stalls_reported(), 3u );
+}
+
+TEST_F( Test_stall_watchdog, capacity )
+{
+    uteki::stall_watchdog<> watchdog( 2, 1s, std::chrono::milliseconds::zero(), nullptr );
+    EXPECT_EQ( watchdog.capacity(), 2u );
+
+    uteki::stall_watchdog<>::guard a( watchdog );
+    {
+        uteki::stall_watchdog<>::guard b( watchdog );
+        uteki::stall_watchdog<>::guard c( watchdog );
+        EXPECT_TRUE( a.is_registered() );
+        EXPECT_TRUE( b.is_registered() );
+        EXPECT_FALSE( c.is_registered() );
+    }
+    // the slot of b is free again
+    uteki::stall_watchdog<>::guard d( watchdog );
+    EXPECT_TRUE( d.is_registered() );
+}
+
+TEST_F( Test_stall_watchdog, concurrent_registration )
+{
+    uteki::stall_watchdog<> watchdog( 8, 1s, 1ms, nullptr );
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures( 0 );
+    for ( int t = 0; t < 8; ++t )
+    {
+        threads.emplace_back( [&watchdog, &failures]() {
+            for ( int k = 0; k < 10000; ++k )
+            {
+                uteki::stall_watchdog<>::guard in_flight( watchdog );
+                if ( ! in_flight.is_registered() )
+                {
+                    failures.fetch_add( 1 );
+                }
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    // eight threads never need more than eight slots
+    EXPECT_EQ( failures.load(), 0 );
+    EXPECT_EQ( watchdog.stalls_reported(), 0u );
+}
+
+#if UTEKI_STALL_WATCHDOG_BACKTRACE
+TEST_F( Test_stall_watchdog, backtrace )
+{
+    int frame_count = 0;
+    uteki::stall_watchdog<> watchdog( 4, 1ms, std::chrono::milliseconds::zero(),
+        [&frame_count]( const uteki::stall_watchdog<>::stall_report& report ) {
+            frame_count = report.frame_count;
+        }, true );
+
+    std::atomic<bool> registered( false );
+    std::atomic<bool> done( false );
+    std::thread stuck( [&]() {
+        uteki::stall_watchdog<>::guard in_flight( watchdog, 7 );
+        registered.store( true );
+        while ( ! done.load() )
+        {
+            std::this_thread::sleep_for( 1ms );
+        }
+    } );
+    while ( ! registered.load() )
+    {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for( 5ms );
+
+    EXPECT_EQ( watchdog.scan(), 1u );
+    EXPECT_GT( frame_count, 0 );
+
+    done.store( true );
+    stuck.join();
+}
+
+TEST_F( Test_stall_watchdog, backtrace_signals )
+{
+    // watchdogs on different signals each install their own handler
+    int first_frames = 0;
+    int second_frames = 0;
+    uteki::stall_watchdog<> first( 4, 1ms, std::chrono::milliseconds::zero(),
+        [&first_frames]( const uteki::stall_watchdog<>::stall_report& report ) {
+            first_frames = report.frame_count;
+        }, true, SIGUSR2 );
+    uteki::stall_watchdog<> second( 4, 1ms, std::chrono::milliseconds::zero(),
+        [&second_frames]( const uteki::stall_watchdog<>::stall_report& report ) {
+            second_frames = report.frame_count;
+        }, true, SIGUSR1 );
+    // a signal that cannot be handled disables capture instead of killing the thread
+    int unhandled_frames = -1;
+    uteki::stall_watchdog<> unhandled( 4, 1ms, std::chrono::milliseconds::zero(),
+        [&unhandled_frames]( const uteki::stall_watchdog<>::stall_report& report ) {
+            unhandled_frames = report.frame_count;
+        }, true, SIGKILL );
+
+    std::atomic<bool> registered( false );
+    std::atomic<bool> done( false );
+    std::thread stuck( [&]() {
+        uteki::stall_watchdog<>::guard in_first( first );
+        uteki::stall_watchdog<>::guard in_second( second );
+        uteki::stall_watchdog<>::guard in_unhandled( unhandled );
+        registered.store( true );
+        while ( ! done.load() )
+        {
+            std::this_thread::sleep_for( 1ms );
+        }
+    } );
+    while ( ! registered.load() )
+    {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for( 5ms );
+
+    EXPECT_EQ( second.scan(), 1u );
+    EXPECT_GT( second_frames, 0 );
+    EXPECT_EQ( first.scan(), 1u );
+    EXPECT_GT( first_frames, 0 );
+    EXPECT_EQ( unhandled.scan(), 1u );
+    EXPECT_EQ( unhandled_frames, 0 );
+
+    done.store( true );
+    stuck.join();
+}
+
+TEST_F( Test_stall_watchdog, backtrace_short_lived )
+{
+    // operations end, and their threads exit, while the scanner signals them
+    std::atomic<int> captured( 0 );
+    uteki::stall_watchdog<> watchdog( 16, std::chrono::nanoseconds::zero(), std::chrono::milliseconds::zero(),
+        [&captured]( const uteki::stall_watchdog<>::stall_report& report ) {
+            if ( report.frame_count > 0 )
+            {
+                captured.fetch_add( 1 );
+            }
+        }, true );
+
+    std::atomic<bool> done( false );
+    std::thread scanner( [&]() {
+        while ( ! done.load() )
+        {
+            watchdog.scan();
+        }
+    } );
+    for ( int round = 0; round < 200; ++round )
+    {
+        std::vector<std::thread> threads;
+        for ( int t = 0; t < 4; ++t )
+        {
+            threads.emplace_back( [&watchdog]() {
+                uteki::stall_watchdog<>::guard in_flight( watchdog );
+                std::this_thread::yield();
+            } );
+        }
+        for ( auto& th : threads )
+        {
+            th.join();
+        }
+    }
+    done.store( true );
+    scanner.join();
+
+    EXPECT_GE( watchdog.stalls_reported(), std::uint64_t( captured.load() ) );
+}
+#endif
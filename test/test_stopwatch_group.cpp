@@ -0,0 +1,259 @@
+//
+//  test stopwatch_group C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/stopwatch_group.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+//! manual clock that runs a hook after a reading, to interleave other work
+//! with the code under test at an exact point
+struct hooked_clock
+{
+    struct tag {};
+    using base = uteki::manual_clock<tag>;
+    using rep = base::rep;
+    using period = base::period;
+    using duration = base::duration;
+    using time_point = std::chrono::time_point<hooked_clock>;
+    static constexpr bool is_steady = true;
+
+    static std::function<void()>& hook( )
+    {
+        static std::function<void()> h;
+        return h;
+    }
+
+    static time_point now( )
+    {
+        time_point reading( base::now().time_since_epoch() );
+        std::function<void()> h;
+        std::swap( h, hook() );
+        if ( h )
+        {
+            h();
+        }
+        return reading;
+    }
+};
+
+}
+
+
+class Test_stopwatch_group : public ::testing::Test
+{
+protected:
+
+	Test_stopwatch_group()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_stopwatch_group() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_stopwatch_group, stop )
+{
+    struct stop_tag {};
+    using clock = uteki::manual_clock<stop_tag>;
+    clock::reset();
+
+    //! [stop stopwatch_group example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/stopwatch_group.h"
+
+    uteki::stopwatch_group<clock> requests;
+    uteki::grouped_stopwatch<clock> first( requests );
+    clock::advance( 10ms );
+    uteki::grouped_stopwatch<clock> second( requests );
+    clock::advance( 5ms );
+
+    // exclude a global pause from every request in one update
+    requests.stop();
+    clock::advance( 100ms );
+    requests.start();
+
+    clock::advance( 5ms );
+
+    //! [stop stopwatch_group example]
+
+    EXPECT_EQ( first.value(), 20ms );
+    EXPECT_EQ( second.value(), 10ms );
+    EXPECT_EQ( requests.value(), 20ms );
+    EXPECT_TRUE( requests.is_running() );
+    EXPECT_TRUE( first.is_running() );
+}
+
+TEST_F( Test_stopwatch_group, member_start_stop )
+{
+    struct member_tag {};
+    using clock = uteki::manual_clock<member_tag>;
+    clock::reset();
+
+    uteki::stopwatch_group<clock> group( false );
+    EXPECT_FALSE( group.is_running() );
+    uteki::grouped_stopwatch<clock> timer( group );
+    uteki::grouped_stopwatch<clock> idle( group, false );
+    EXPECT_TRUE( timer.is_running() );
+    EXPECT_FALSE( idle.is_running() );
+
+    // a stopped group holds every member
+    clock::advance( 7ms );
+    EXPECT_EQ( timer.value(), 0ms );
+    EXPECT_EQ( group.value(), 0ms );
+
+    group.start();
+    clock::advance( 3ms );
+    timer.stop();
+    timer.stop();
+    clock::advance( 4ms );
+    EXPECT_EQ( timer.value(), 3ms );
+    EXPECT_FALSE( timer.is_running() );
+
+    timer.start();
+    idle.start();
+    clock::advance( 2ms );
+    EXPECT_EQ( timer.value(), 5ms );
+    EXPECT_EQ( idle.value(), 2ms );
+    EXPECT_EQ( idle.value<std::chrono::microseconds>(), 2000us );
+
+    // a member stopped while the group is paused keeps the frozen value
+    group.stop();
+    group.stop();
+    clock::advance( 1ms );
+    timer.stop();
+    group.start();
+    clock::advance( 1ms );
+    EXPECT_EQ( timer.value(), 5ms );
+    EXPECT_EQ( idle.value(), 3ms );
+
+    timer.restart();
+    clock::advance( 1ms );
+    EXPECT_EQ( timer.value(), 1ms );
+    timer.reset();
+    EXPECT_FALSE( timer.is_running() );
+    EXPECT_EQ( timer.value(), 0ms );
+}
+
+TEST_F( Test_stopwatch_group, concurrent )
+{
+    uteki::stopwatch_group<> group;
+
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 4; ++t )
+    {
+        threads.emplace_back( [&group]() {
+            uteki::grouped_stopwatch<> timer( group );
+            auto previous = timer.value();
+            for ( int k = 0; k < 10000; ++k )
+            {
+                if ( k % 100 == 0 )
+                {
+                    timer.stop();
+                    timer.start();
+                }
+                auto current = timer.value();
+                EXPECT_GE( current, previous );
+                previous = current;
+            }
+        } );
+    }
+    for ( int k = 0; k < 1000; ++k )
+    {
+        group.stop();
+        group.start();
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+    EXPECT_TRUE( group.is_running() );
+}
+
+TEST_F( Test_stopwatch_group, read_during_stop )
+{
+    hooked_clock::base::reset();
+    uteki::stopwatch_group<hooked_clock> group;
+    hooked_clock::base::advance( 5ms );
+
+    // a reader runs after the stopper has read the clock, and after the clock
+    // has moved on, but before the stop has landed
+    std::atomic<bool> go( false );
+    std::atomic<bool> read( false );
+    hooked_clock::duration seen( 0 );
+    std::thread reader( [&]() {
+        while ( ! go.load() )
+        {
+            std::this_thread::yield();
+        }
+        seen = group.value();
+        read.store( true );
+    } );
+    hooked_clock::hook() = [&]() {
+        hooked_clock::base::advance( 1ms );
+        go.store( true );
+        auto give_up = std::chrono::steady_clock::now() + 50ms;
+        while ( ! read.load() && std::chrono::steady_clock::now() < give_up )
+        {
+            std::this_thread::yield();
+        }
+    };
+    group.stop();
+    reader.join();
+
+    // the reader waited for the stop instead of reading past the frozen value
+    EXPECT_EQ( group.value(), 5ms );
+    EXPECT_EQ( seen, 5ms );
+}
@@ -23,6 +23,7 @@
 //
 
 #include "uteki/stopwatch_timer.h"
+#include "uteki/manual_clock.h"
 #include <iostream>
 #include <gtest/gtest.h>
 #include <chrono>
@@ -498,3 +499,31 @@ TEST_F( Test_stopwatch_timer, comparison )
     EXPECT_TRUE( timer_b >= timer_b );
     EXPECT_TRUE( timer_c >= timer_c );
 }
+
+TEST_F( Test_stopwatch_timer, manual_clock )
+{
+    struct stopwatch_timer_test_clock;
+    using clock_type = uteki::manual_clock<stopwatch_timer_test_clock>;
+    using timer_type_mc = uteki::stopwatch_timer<clock_type>;
+
+    timer_type_mc my_timer( false );
+    clock_type::advance( 462ms );
+    EXPECT_EQ( my_timer.value(), clock_type::duration::zero() );
+
+    my_timer.start();
+    clock_type::advance( 192ms );
+    my_timer.stop();
+    clock_type::advance( 720ms );
+    EXPECT_EQ( my_timer.value(), 192ms );
+
+    timer_type_mc other_timer;
+    my_timer.start();
+    clock_type::advance( 120ms );
+    EXPECT_EQ( my_timer.value(), 192ms + 120ms );
+    EXPECT_EQ( other_timer.value(), 120ms );
+    EXPECT_TRUE( my_timer > other_timer );
+
+    my_timer.reset();
+    EXPECT_FALSE( my_timer.is_running() );
+    EXPECT_EQ( my_timer.value(), clock_type::duration::zero() );
+}
@@ -0,0 +1,211 @@
+//
+//  test task_timing C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/task_timing.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+
+class Test_task_timing : public ::testing::Test
+{
+protected:
+
+	Test_task_timing()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_task_timing() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+
+};
+
+TEST_F( Test_task_timing, wrap )
+{
+    struct wrap_tag {};
+    using clock = uteki::manual_clock<wrap_tag>;
+    clock::reset();
+
+    //! [wrap task_timing example]
+    uteki::task_timing<clock> executor_timing;
+
+    std::function<int()> task = executor_timing.wrap( []() {
+        clock::advance( 30ms );
+        return 7;
+    } );
+    EXPECT_EQ( executor_timing.queued(), 1u );
+
+    // the task waits in the queue
+    clock::advance( 20ms );
+    EXPECT_EQ( task(), 7 );
+
+    EXPECT_EQ( executor_timing.queued(), 0u );
+    EXPECT_EQ( executor_timing.running(), 0u );
+    EXPECT_EQ( executor_timing.completed(), 1u );
+    EXPECT_EQ( executor_timing.queue_delay().max(), 20ms );
+    EXPECT_EQ( executor_timing.run_time().max(), 30ms );
+    EXPECT_EQ( executor_timing.end_to_end().max(), 50ms );
+    //! [wrap task_timing example]
+}
+
+TEST_F( Test_task_timing, invoked_again )
+{
+    struct again_tag {};
+    using clock = uteki::manual_clock<again_tag>;
+    clock::reset();
+
+    uteki::task_timing<clock> executor_timing;
+    auto task = executor_timing.wrap( []() { clock::advance( 2ms ); } );
+    clock::advance( 5ms );
+    task();
+    EXPECT_EQ( task.enqueue_time(), clock::now() );
+
+    // a second run counts as resubmitted when the first returned
+    clock::advance( 3ms );
+    task();
+    EXPECT_EQ( executor_timing.submitted(), 2u );
+    EXPECT_EQ( executor_timing.completed(), 2u );
+    EXPECT_EQ( executor_timing.queued(), 0u );
+    EXPECT_EQ( executor_timing.queue_delay().min(), 3ms );
+    EXPECT_EQ( executor_timing.queue_delay().max(), 5ms );
+    EXPECT_EQ( executor_timing.end_to_end().max(), 7ms );
+
+    // a rerun is counted when it starts, so a finished task is never left queued
+    auto pending = executor_timing.wrap( []() {} );
+    EXPECT_EQ( executor_timing.queued(), 1u );
+    pending();
+    pending();
+    EXPECT_EQ( executor_timing.queued(), 0u );
+    EXPECT_EQ( executor_timing.submitted(), 4u );
+    EXPECT_EQ( executor_timing.completed(), 4u );
+}
+
+TEST_F( Test_task_timing, arguments_and_exceptions )
+{
+    uteki::task_timing<> executor_timing;
+
+    auto add = executor_timing.wrap( []( int a, int b ) { return a + b; } );
+    EXPECT_EQ( add( 2, 3 ), 5 );
+
+    auto fail = executor_timing.wrap( []() { throw std::runtime_error( "task failed" ); } );
+    EXPECT_THROW( fail(), std::runtime_error );
+
+    EXPECT_EQ( executor_timing.submitted(), 2u );
+    EXPECT_EQ( executor_timing.completed(), 2u );
+    EXPECT_EQ( executor_timing.run_time().count(), 2u );
+    EXPECT_EQ( executor_timing.queued(), 0u );
+}
+
+TEST_F( Test_task_timing, record )
+{
+    using timing_type = uteki::task_timing<>;
+    timing_type executor_timing;
+
+    timing_type::time_point t0 = std::chrono::steady_clock::now();
+    executor_timing.record( t0, t0 + 3ms, t0 + 10ms );
+
+    EXPECT_EQ( executor_timing.queue_delay().max(), 3ms );
+    EXPECT_EQ( executor_timing.run_time().max(), 7ms );
+    EXPECT_EQ( executor_timing.end_to_end().max(), 10ms );
+
+    executor_timing.reset();
+    EXPECT_EQ( executor_timing.end_to_end().count(), 0u );
+}
+
+TEST_F( Test_task_timing, worker_thread )
+{
+    uteki::task_timing<> executor_timing;
+
+    std::mutex queue_lock;
+    std::condition_variable queue_cv;
+    std::deque< std::function<void()> > queue;
+    bool done = false;
+
+    std::thread worker( [&]() {
+        for ( ;; )
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard( queue_lock );
+                queue_cv.wait( guard, [&]() { return done || ! queue.empty(); } );
+                if ( queue.empty() )
+                {
+                    return;
+                }
+                task = std::move( queue.front() );
+                queue.pop_front();
+            }
+            task();
+        }
+    } );
+
+    constexpr int task_count = 50;
+    for ( int k = 0; k < task_count; ++k )
+    {
+        std::lock_guard<std::mutex> guard( queue_lock );
+        queue.push_back( executor_timing.wrap( []() {
+            std::this_thread::sleep_for( 100us );
+        } ) );
+        queue_cv.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> guard( queue_lock );
+        done = true;
+        queue_cv.notify_one();
+    }
+    worker.join();
+
+    EXPECT_EQ( executor_timing.completed(), std::uint64_t( task_count ) );
+    EXPECT_EQ( executor_timing.queue_delay().count(), std::uint64_t( task_count ) );
+    EXPECT_GE( executor_timing.run_time().min(), 100us );
+    EXPECT_GE( executor_timing.end_to_end().max(), executor_timing.run_time().max() );
+}
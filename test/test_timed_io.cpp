@@ -0,0 +1,274 @@
+//
+//  test timed_io C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/timed_io.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+// makes the nothrow operator new fail, as it would with memory exhausted
+std::atomic<bool> fail_nothrow_new( false );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept
+{
+    if ( fail_nothrow_new.load() )
+    {
+        return nullptr;
+    }
+    try
+    {
+        return ::operator new( size );
+    }
+    catch ( ... )
+    {
+        return nullptr;
+    }
+}
+
+
+class Test_timed_io : public ::testing::Test
+{
+protected:
+
+	Test_timed_io()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_timed_io() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_timed_io, size_class_of )
+{
+    using stats = uteki::io_stats<>;
+    EXPECT_EQ( stats::size_class_of( 0 ), 0u );
+    EXPECT_EQ( stats::size_class_of( 1 ), 1u );
+    EXPECT_EQ( stats::size_class_of( 3 ), 1u );
+    EXPECT_EQ( stats::size_class_of( 4 ), 2u );
+    EXPECT_EQ( stats::size_class_of( 4096 ), 7u );
+    EXPECT_EQ( stats::size_class_lower_bound( 7 ), 4096u );
+    EXPECT_EQ( stats::size_class_of( std::size_t( 1 ) << 40 ), stats::size_class_count - 1 );
+    for ( std::size_t k = 1; k < stats::size_class_count; ++k )
+    {
+        EXPECT_EQ( stats::size_class_of( stats::size_class_lower_bound( k ) ), k );
+        EXPECT_EQ( stats::size_class_of( stats::size_class_lower_bound( k ) - 1 ), k - 1 );
+    }
+}
+
+TEST_F( Test_timed_io, record )
+{
+    uteki::io_stats<> stats;
+    stats.record( uteki::io_operation::pread, 4096, 2ms );
+    stats.record( uteki::io_operation::pread, 5000, 2ms );
+    stats.record( uteki::io_operation::pread, 100, 1ms );
+    stats.record_error( uteki::io_operation::pread );
+
+    EXPECT_EQ( stats.calls( uteki::io_operation::pread ), 3u );
+    EXPECT_EQ( stats.total_bytes( uteki::io_operation::pread ), 9196u );
+    EXPECT_EQ( stats.errors( uteki::io_operation::pread ), 1u );
+    EXPECT_EQ( stats.calls( uteki::io_operation::read ), 0u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::pread, 7 ).count(), 2u );
+    EXPECT_EQ( stats.bytes( uteki::io_operation::pread, 7 ), 9096u );
+    EXPECT_DOUBLE_EQ( stats.bytes_per_second( uteki::io_operation::pread, 7 ), 9096.0 / 0.004 );
+    EXPECT_DOUBLE_EQ( stats.bytes_per_second( uteki::io_operation::write, 6 ), 0.0 );
+
+    stats.reset();
+    EXPECT_EQ( stats.calls( uteki::io_operation::pread ), 0u );
+    EXPECT_EQ( stats.errors( uteki::io_operation::pread ), 0u );
+}
+
+TEST_F( Test_timed_io, concurrent_first_record )
+{
+    // threads race to allocate the histogram of the same size class
+    uteki::io_stats<> stats;
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < 4; ++t )
+    {
+        threads.emplace_back( [&stats]() {
+            for ( int k = 0; k < 1000; ++k )
+            {
+                stats.record( uteki::io_operation::write, 512, 10us );
+            }
+        } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+
+    EXPECT_EQ( stats.latency( uteki::io_operation::write, 5 ).count(), 4000u );
+    EXPECT_EQ( stats.bytes( uteki::io_operation::write, 5 ), 4000u * 512u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::write, 4 ).count(), 0u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::read, 5 ).count(), 0u );
+}
+
+TEST_F( Test_timed_io, reserve )
+{
+    uteki::io_stats<> stats;
+    EXPECT_TRUE( stats.reserve( uteki::io_operation::write, 4096 ) );
+
+    int fds[2];
+    ASSERT_EQ( ::pipe( fds ), 0 );
+    char message[100] = {};
+    fail_nothrow_new = true;
+
+    // reserved histograms are recorded into without allocating
+    EXPECT_EQ( uteki::timed_write( stats, fds[1], message, sizeof message ), 100 );
+    EXPECT_EQ( stats.calls( uteki::io_operation::write ), 1u );
+    stats.record( uteki::io_operation::write, 4096, 1ms );
+    EXPECT_EQ( stats.latency( uteki::io_operation::write, 7 ).count(), 1u );
+
+    // a pair that cannot be allocated drops the call, not its result
+    EXPECT_EQ( uteki::timed_read( stats, fds[0], message, sizeof message ), 100 );
+    EXPECT_EQ( stats.calls( uteki::io_operation::read ), 0u );
+    EXPECT_EQ( stats.dropped( uteki::io_operation::read ), 1u );
+    stats.record( uteki::io_operation::write, 1u << 20, 1ms );
+    EXPECT_EQ( stats.dropped( uteki::io_operation::write ), 1u );
+    EXPECT_FALSE( stats.reserve( uteki::io_operation::fsync ) );
+
+    fail_nothrow_new = false;
+    EXPECT_TRUE( stats.reserve( uteki::io_operation::fsync ) );
+    stats.reset();
+    EXPECT_EQ( stats.dropped( uteki::io_operation::read ), 0u );
+    ::close( fds[0] );
+    ::close( fds[1] );
+}
+
+TEST_F( Test_timed_io, file )
+{
+    char path[] = "/tmp/uteki_timed_io_XXXXXX";
+    int fd = ::mkstemp( path );
+    ASSERT_GE( fd, 0 );
+    ::unlink( path );
+
+    //! [timed_pwrite timed_io example]
+    uteki::io_stats<> stats;
+    char block[4096] = {};
+    for ( int k = 0; k < 4; ++k )
+    {
+        ASSERT_EQ( uteki::timed_pwrite( stats, fd, block, sizeof( block ), k * 4096 ), 4096 );
+    }
+    ASSERT_EQ( uteki::timed_fsync( stats, fd ), 0 );
+
+    std::size_t size_class = stats.size_class_of( sizeof( block ) );
+    auto p99 = stats.latency( uteki::io_operation::pwrite, size_class ).percentile( 99.0 );
+    double megabytes_per_second = stats.bytes_per_second( uteki::io_operation::pwrite, size_class ) / 1e6;
+    //! [timed_pwrite timed_io example]
+    EXPECT_GT( p99.count(), 0 );
+    EXPECT_GT( megabytes_per_second, 0.0 );
+    EXPECT_EQ( stats.calls( uteki::io_operation::pwrite ), 4u );
+    EXPECT_EQ( stats.total_bytes( uteki::io_operation::pwrite ), 16384u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::fsync, 0 ).count(), 1u );
+
+    char in[4096];
+    EXPECT_EQ( uteki::timed_pread( stats, fd, in, sizeof( in ), 8192 ), 4096 );
+    EXPECT_EQ( uteki::timed_pread( stats, fd, in, sizeof( in ), 16384 ), 0 );
+    EXPECT_EQ( stats.latency( uteki::io_operation::pread, size_class ).count(), 1u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::pread, 0 ).count(), 1u );
+
+    ::close( fd );
+}
+
+TEST_F( Test_timed_io, pipe )
+{
+    int fds[2];
+    ASSERT_EQ( ::pipe( fds ), 0 );
+    uteki::io_stats<> stats;
+    const char message[] = "pipe";
+    EXPECT_EQ( uteki::timed_write( stats, fds[1], message, 4 ), 4 );
+    char in[16];
+    EXPECT_EQ( uteki::timed_read( stats, fds[0], in, sizeof( in ) ), 4 );
+    EXPECT_EQ( std::memcmp( message, in, 4 ), 0 );
+    EXPECT_EQ( stats.latency( uteki::io_operation::write, 2 ).count(), 1u );
+    EXPECT_EQ( stats.latency( uteki::io_operation::read, 2 ).count(), 1u );
+
+    // seeking is not possible on a pipe
+    EXPECT_EQ( uteki::timed_pread( stats, fds[0], in, sizeof( in ), 0 ), -1 );
+    EXPECT_EQ( errno, ESPIPE );
+    EXPECT_EQ( stats.errors( uteki::io_operation::pread ), 1u );
+    ::close( fds[0] );
+    ::close( fds[1] );
+}
+
+TEST_F( Test_timed_io, socket )
+{
+    int fds[2];
+    ASSERT_EQ( ::socketpair( AF_UNIX, SOCK_STREAM, 0, fds ), 0 );
+    uteki::io_stats<> stats;
+    std::string message( 100, 'x' );
+    EXPECT_EQ( uteki::timed_write( stats, fds[0], message.data(), message.size() ), 100 );
+    char in[128];
+    EXPECT_EQ( uteki::timed_read( stats, fds[1], in, sizeof( in ) ), 100 );
+    EXPECT_EQ( stats.total_bytes( uteki::io_operation::read ), 100u );
+    ::close( fds[0] );
+    ::close( fds[1] );
+}
+
+TEST_F( Test_timed_io, errno_preserved )
+{
+    uteki::io_stats<> stats;
+    char in[16];
+    errno = 0;
+    EXPECT_EQ( uteki::timed_read( stats, -1, in, sizeof( in ) ), -1 );
+    EXPECT_EQ( errno, EBADF );
+    EXPECT_EQ( uteki::timed_fsync( stats, -1 ), -1 );
+    EXPECT_EQ( errno, EBADF );
+    EXPECT_EQ( stats.errors( uteki::io_operation::read ), 1u );
+    EXPECT_EQ( stats.errors( uteki::io_operation::fsync ), 1u );
+    EXPECT_EQ( stats.calls( uteki::io_operation::read ), 0u );
+}
@@ -0,0 +1,233 @@
+//
+//  test timed_mutex_wrapper C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/timed_mutex_wrapper.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_timed_mutex_wrapper : public ::testing::Test
+{
+protected:
+
+	Test_timed_mutex_wrapper()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_timed_mutex_wrapper() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+namespace
+{
+    //! hold `mutex` on another thread for `hold` while the caller tries to lock it
+    template< class Mutex >
+    std::thread hold_for( Mutex& mutex, std::chrono::milliseconds hold, std::atomic<bool>& locked )
+    {
+        return std::thread( [&mutex, hold, &locked]() {
+            mutex.lock();
+            locked.store( true );
+            std::this_thread::sleep_for( hold );
+            mutex.unlock();
+        } );
+    }
+}
+
+TEST_F( Test_timed_mutex_wrapper, guard )
+{
+    //! [guard timed_mutex_wrapper example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/timed_mutex_wrapper.h"
+    // #include <mutex>
+
+    uteki::timed_mutex_wrapper<std::mutex> orders_lock( "orders" );
+    {
+        // the guard records this line as the call site when it has to wait
+        uteki::timed_mutex_wrapper<std::mutex>::guard lock( orders_lock );
+        // critical section
+    }
+    {
+        // any standard lock type works too
+        std::lock_guard< uteki::timed_mutex_wrapper<std::mutex> > lock( orders_lock );
+    }
+
+    uteki::lock_report report = orders_lock.report();
+
+    //! [guard timed_mutex_wrapper example]
+
+    EXPECT_EQ( report.name, "orders" );
+    EXPECT_EQ( report.acquisitions, 2u );
+    EXPECT_EQ( report.contended, 0u );
+    EXPECT_EQ( report.total_wait, 0ns );
+    EXPECT_EQ( report.worst_site.file, nullptr );
+}
+
+TEST_F( Test_timed_mutex_wrapper, contended )
+{
+    uteki::timed_mutex_wrapper<> mutex( "contended" );
+
+    std::atomic<bool> locked( false );
+    std::thread holder = hold_for( mutex, 20ms, locked );
+    while ( ! locked.load() )
+    {
+        std::this_thread::yield();
+    }
+    unsigned line = __LINE__ + 1;
+    mutex.lock( UTEKI_CALL_SITE );
+    mutex.unlock();
+    holder.join();
+
+    auto report = mutex.report();
+    EXPECT_EQ( report.acquisitions, 2u );
+    EXPECT_EQ( report.contended, 1u );
+    EXPECT_GT( report.total_wait, 1ms );
+    EXPECT_EQ( report.max_wait, report.total_wait );
+    EXPECT_EQ( report.worst_site_wait, report.total_wait );
+    EXPECT_EQ( report.worst_site.line, line );
+    EXPECT_NE( std::string( report.worst_site.file ).find( "test_timed_mutex_wrapper.cpp" ), std::string::npos );
+    EXPECT_EQ( mutex.waits().count(), 1u );
+}
+
+TEST_F( Test_timed_mutex_wrapper, default_call_site )
+{
+    using wrapper = uteki::timed_mutex_wrapper<>;
+    wrapper mutex( "default_call_site" );
+
+    std::atomic<bool> locked( false );
+    std::thread holder = hold_for( mutex, 5ms, locked );
+    while ( ! locked.load() )
+    {
+        std::this_thread::yield();
+    }
+    {
+        wrapper::guard lock( mutex );
+    }
+    holder.join();
+
+    auto report = mutex.report();
+    ASSERT_NE( report.worst_site.file, nullptr );
+#if defined( __GNUC__ ) || defined( __clang__ )
+    EXPECT_NE( std::string( report.worst_site.file ).find( "test_timed_mutex_wrapper.cpp" ), std::string::npos );
+#endif
+}
+
+TEST_F( Test_timed_mutex_wrapper, hold_sampling )
+{
+    uteki::timed_mutex_wrapper<> every( "every", 1 );
+    uteki::timed_mutex_wrapper<> none( "none", 0 );
+    uteki::timed_mutex_wrapper<> some( "some", 4 );
+    for ( int k = 0; k < 8; ++k )
+    {
+        std::lock_guard< uteki::timed_mutex_wrapper<> > a( every );
+        std::lock_guard< uteki::timed_mutex_wrapper<> > b( none );
+        std::lock_guard< uteki::timed_mutex_wrapper<> > c( some );
+    }
+    EXPECT_EQ( every.holds().count(), 8u );
+    EXPECT_EQ( none.holds().count(), 0u );
+    EXPECT_EQ( some.holds().count(), 2u );
+    EXPECT_EQ( some.report().hold_samples, 2u );
+
+    // try_lock counts as an acquisition
+    EXPECT_TRUE( some.try_lock() );
+    std::thread other( [&some]() { EXPECT_FALSE( some.try_lock() ); } );
+    other.join();
+    some.unlock();
+    EXPECT_EQ( some.acquisitions(), 9u );
+}
+
+TEST_F( Test_timed_mutex_wrapper, ranked_by_wait )
+{
+    auto& registry = uteki::lock_registry::instance();
+    std::size_t before = registry.size();
+
+    //! [ranked_by_wait timed_mutex_wrapper example]
+
+    // #include <chrono>
+    // using namespace std::chrono_literals;
+    // #include "uteki/timed_mutex_wrapper.h"
+
+    uteki::timed_mutex_wrapper<> cache_lock( "cache" );
+    uteki::timed_mutex_wrapper<> queue_lock( "queue" );
+
+    // ... the application runs and the queue lock is contended ...
+    std::atomic<bool> locked( false );
+    std::thread holder = hold_for( queue_lock, 10ms, locked );
+    while ( ! locked.load() )
+    {
+        std::this_thread::yield();
+    }
+    queue_lock.lock();
+    queue_lock.unlock();
+    holder.join();
+
+    // the locks with the most total wait time first
+    std::vector<uteki::lock_report> ranking = uteki::lock_registry::instance().ranked_by_wait();
+
+    //! [ranked_by_wait timed_mutex_wrapper example]
+
+    EXPECT_EQ( registry.size(), before + 2 );
+    ASSERT_GE( ranking.size(), 2u );
+    EXPECT_EQ( ranking[0].name, "queue" );
+    EXPECT_GT( ranking[0].total_wait, 0ns );
+}
+
+TEST_F( Test_timed_mutex_wrapper, unregister )
+{
+    auto& registry = uteki::lock_registry::instance();
+    std::size_t before = registry.size();
+    {
+        uteki::timed_mutex_wrapper<std::recursive_mutex> scoped( "scoped" );
+        EXPECT_EQ( registry.size(), before + 1 );
+    }
+    EXPECT_EQ( registry.size(), before );
+}
@@ -0,0 +1,163 @@
+//
+//  test timestamp_buffer C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "uteki/timestamp_buffer.h"
+#include "uteki/manual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+
+class Test_timestamp_buffer : public ::testing::Test
+{
+protected:
+
+	Test_timestamp_buffer()
+	{
+	 // common set-up work for each test
+	}
+
+	~Test_timestamp_buffer() override
+	{
+		// common clean-up work that doesn't throw exceptions
+	}
+
+	// If the constructor and destructor are not enough for setting up
+	// and cleaning up each test, you can define the following methods:
+
+
+	void SetUp() override
+	{
+		// Code here will be called immediately after the constructor (right
+		// before each test).
+
+	}
+
+	void TearDown() override
+	{
+		// Code here will be called immediately after each test (right
+		// before the destructor).
+	}
+};
+
+TEST_F( Test_timestamp_buffer, push_back )
+{
+    //! [push_back timestamp_buffer example]
+
+    // #include <chrono>
+    // #include <vector>
+    // #include "uteki/timestamp_buffer.h"
+
+    uteki::timestamp_buffer<> capture;
+
+    for ( int k = 0; k < 1000; ++k )
+    {
+        capture.push_back( std::chrono::steady_clock::now() );
+    }
+
+    std::vector< std::chrono::steady_clock::time_point > stamps = capture.decode();
+
+    //! [push_back timestamp_buffer example]
+
+    ASSERT_EQ( stamps.size(), 1000u );
+    EXPECT_EQ( stamps.back(), capture.back() );
+    for ( std::size_t k = 1; k < stamps.size(); ++k )
+    {
+        EXPECT_GE( stamps[k], stamps[k - 1] );
+    }
+}
+
+TEST_F( Test_timestamp_buffer, round_trip )
+{
+    using buffer_type = uteki::timestamp_buffer<>;
+    using time_point = buffer_type::time_point;
+
+    std::mt19937_64 generator( 12345 );
+    std::uniform_int_distribution<int> small_delta( 0, 60 );
+    std::uniform_int_distribution<std::int64_t> large_delta( -1000000000, 1000000000 );
+
+    std::vector<time_point> expected;
+    time_point t = time_point( std::chrono::nanoseconds( 1234567890123456789 ) );
+    for ( int k = 0; k < 10000; ++k )
+    {
+        t += ( k % 97 == 0 ) ? std::chrono::nanoseconds( large_delta( generator ) )
+                             : std::chrono::nanoseconds( small_delta( generator ) );
+        expected.push_back( t );
+    }
+    expected.push_back( time_point::min() );
+    expected.push_back( time_point::max() );
+    expected.push_back( time_point() );
+
+    buffer_type capture;
+    for ( auto& stamp : expected )
+    {
+        capture.push_back( stamp );
+    }
+    EXPECT_EQ( capture.size(), expected.size() );
+
+    EXPECT_EQ( capture.decode(), expected );
+
+    std::vector<time_point> iterated( capture.begin(), capture.end() );
+    EXPECT_EQ( iterated, expected );
+}
+
+TEST_F( Test_timestamp_buffer, compression )
+{
+    struct compression_test_tag;
+    using clock_type = uteki::manual_clock<compression_test_tag>;
+
+    std::mt19937 generator( 42 );
+    std::exponential_distribution<double> gap( 1.0 / 2000.0 );  // mean 2 us, in ns
+
+    uteki::timestamp_buffer<clock_type> capture;
+    constexpr int event_count = 100000;
+    for ( int k = 0; k < event_count; ++k )
+    {
+        clock_type::advance( std::chrono::nanoseconds( static_cast<std::int64_t>( gap( generator ) ) ) );
+        capture.push_back( clock_type::now() );
+    }
+
+    std::size_t raw_size = event_count * sizeof( clock_type::time_point );
+    EXPECT_GE( raw_size, 4 * capture.encoded_size() );
+    EXPECT_EQ( capture.back(), clock_type::now() );
+}
+
+TEST_F( Test_timestamp_buffer, empty_and_clear )
+{
+    uteki::timestamp_buffer<> capture;
+    EXPECT_TRUE( capture.empty() );
+    EXPECT_TRUE( capture.begin() == capture.end() );
+    EXPECT_TRUE( capture.decode().empty() );
+
+    capture.push_back( std::chrono::steady_clock::now() );
+    EXPECT_FALSE( capture.empty() );
+    EXPECT_TRUE( capture.begin() != capture.end() );
+
+    capture.clear();
+    EXPECT_TRUE( capture.empty() );
+    EXPECT_EQ( capture.encoded_size(), 0u );
+}
@@ -0,0 +1,145 @@
+//
+//  uteki_bench_compare C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares two benchmark result files written by `uteki::bench_results`.
+//
+// For every benchmark present in both files the medians are compared, the
+// Mann-Whitney U test decides whether the difference is significant, and a
+// bootstrap confidence interval bounds the relative change of the median.
+// The exit status is 1 when any benchmark regressed, so the tool can gate a
+// build, 2 on a usage or file error, and 0 otherwise. Differences in the
+// environment metadata are reported as warnings.
+
+#include "uteki/bench_compare.h"
+#include "uteki/bench_result.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+void usage( const char* program )
+{
+    std::fprintf( stderr,
+        "usage: %s [options] baseline candidate\n"
+        "  --alpha P         significance level, default 0.05\n"
+        "  --threshold F     relative slowdown tolerated, default 0.0 (0.02 is 2%%)\n"
+        "  --confidence C    bootstrap confidence level, default 0.95\n"
+        "  --resamples N     bootstrap resamples, default 2000\n",
+        program );
+}
+
+}
+
+int main( int argc, char** argv )
+{
+    uteki::compare_options options;
+    std::string paths[2];
+    int path_count = 0;
+    for ( int k = 1; k < argc; ++k )
+    {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if ( arg == "--alpha" && has_value )
+        {
+            options.alpha = std::atof( argv[++k] );
+        }
+        else if ( arg == "--threshold" && has_value )
+        {
+            options.threshold = std::atof( argv[++k] );
+        }
+        else if ( arg == "--confidence" && has_value )
+        {
+            options.confidence = std::atof( argv[++k] );
+        }
+        else if ( arg == "--resamples" && has_value )
+        {
+            options.resamples = static_cast<std::size_t>( std::strtoull( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg.compare( 0, 2, "--" ) != 0 && path_count < 2 )
+        {
+            paths[path_count++] = arg;
+        }
+        else
+        {
+            usage( argv[0] );
+            return 2;
+        }
+    }
+    if ( path_count != 2 )
+    {
+        usage( argv[0] );
+        return 2;
+    }
+
+    uteki::bench_results runs[2];
+    for ( int k = 0; k < 2; ++k )
+    {
+        std::string error;
+        if ( ! runs[k].load( paths[k], &error ) )
+        {
+            std::fprintf( stderr, "%s: %s\n", paths[k].c_str(), error.c_str() );
+            return 2;
+        }
+    }
+
+    for ( const auto& key : uteki::metadata_differences( runs[0], runs[1] ) )
+    {
+        auto before = runs[0].metadata.find( key );
+        auto after = runs[1].metadata.find( key );
+        std::fprintf( stderr, "warning: %s differs: '%s' vs '%s'\n", key.c_str(),
+                      before == runs[0].metadata.end() ? "" : before->second.c_str(),
+                      after == runs[1].metadata.end() ? "" : after->second.c_str() );
+    }
+
+    auto comparisons = uteki::compare_results( runs[0], runs[1], options );
+    int regressions = 0;
+    std::printf( "%-32s %14s %14s %9s %21s %10s  %s\n",
+                 "benchmark", "baseline ns", "candidate ns", "change", "interval", "p-value", "verdict" );
+    for ( const auto& c : comparisons )
+    {
+        const char* verdict = c.regression ? "REGRESSION"
+            : c.improvement ? "improvement"
+            : c.significant ? "within threshold" : "no difference";
+        regressions += c.regression ? 1 : 0;
+        std::printf( "%-32s %14.1f %14.1f %+8.2f%% [%+8.2f%%, %+8.2f%%] %10.4f  %s\n",
+                     c.name.c_str(), c.baseline_median, c.candidate_median, 100.0 * c.change,
+                     100.0 * c.change_low, 100.0 * c.change_high, c.test.p_value, verdict );
+    }
+    for ( const auto& r : runs[0].results )
+    {
+        if ( runs[1].find( r.name ) == nullptr )
+        {
+            std::fprintf( stderr, "warning: %s is missing from the candidate\n", r.name.c_str() );
+        }
+    }
+
+    if ( regressions > 0 )
+    {
+        std::printf( "%d regression%s\n", regressions, regressions == 1 ? "" : "s" );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,409 @@
+//
+//  uteki_jitter C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Measures scheduling latency and jitter, in the manner of cyclictest.
+//
+// One thread per allowed CPU (or as many as requested) is pinned and wakes at fixed
+// absolute intervals. The wake-up latency, the time from the intended wake-up
+// to the thread running again, is recorded in a histogram per thread. Wake-ups
+// slower than the outlier threshold are also kept with their wall clock time,
+// so they can be matched against other logs. Results are written as JSON.
+// No special privileges are needed; `--priority` asks for real-time
+// scheduling and falls back to normal scheduling with a warning.
+
+#include "uteki/clock_mapper.h"
+#include "uteki/latency_histogram.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace
+{
+
+using clock_type = std::chrono::steady_clock;
+using histogram_type = uteki::latency_histogram<std::chrono::nanoseconds>;
+
+struct options
+{
+    unsigned threads = 0;
+    std::chrono::microseconds interval{ 1000 };
+    std::chrono::seconds duration{ 10 };
+    std::chrono::microseconds outlier_threshold{ 100 };
+    std::size_t max_outliers = 100;
+    int priority = 0;
+    bool pin = true;
+    std::string output;
+};
+
+struct outlier
+{
+    clock_type::time_point target;
+    std::chrono::nanoseconds latency;
+};
+
+struct thread_result
+{
+    unsigned index = 0;
+    int cpu = -1;
+    bool pinned = false;
+    bool realtime = false;
+    histogram_type latency;
+    std::vector<outlier> outliers;
+    std::uint64_t outlier_count = 0;
+};
+
+void usage( const char* program )
+{
+    std::fprintf( stderr,
+        "usage: %s [options]\n"
+        "  --threads N        measuring threads, default one per allowed CPU\n"
+        "  --interval-us N    wake-up interval in microseconds, default 1000\n"
+        "  --duration-s N     run time in seconds, default 10\n"
+        "  --outlier-us N     latency above which wake-ups are listed, default 100\n"
+        "  --max-outliers N   outliers listed per thread, default 100\n"
+        "  --priority N       request SCHED_FIFO priority N, default 0 (normal scheduling)\n"
+        "  --no-pin           do not pin threads to CPUs\n"
+        "  --output FILE      write JSON to FILE instead of standard output\n",
+        program );
+}
+
+bool parse_options( int argc, char** argv, std::size_t cpu_count, options& opts )
+{
+    for ( int k = 1; k < argc; ++k )
+    {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if ( arg == "--no-pin" )
+        {
+            opts.pin = false;
+        }
+        else if ( arg == "--threads" && has_value )
+        {
+            opts.threads = static_cast<unsigned>( std::strtoul( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg == "--interval-us" && has_value )
+        {
+            opts.interval = std::chrono::microseconds( std::strtoll( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg == "--duration-s" && has_value )
+        {
+            opts.duration = std::chrono::seconds( std::strtoll( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg == "--outlier-us" && has_value )
+        {
+            opts.outlier_threshold = std::chrono::microseconds( std::strtoll( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg == "--max-outliers" && has_value )
+        {
+            opts.max_outliers = static_cast<std::size_t>( std::strtoull( argv[++k], nullptr, 10 ) );
+        }
+        else if ( arg == "--priority" && has_value )
+        {
+            opts.priority = std::atoi( argv[++k] );
+        }
+        else if ( arg == "--output" && has_value )
+        {
+            opts.output = argv[++k];
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if ( opts.threads == 0 )
+    {
+        opts.threads = static_cast<unsigned>( cpu_count );
+    }
+    return opts.interval > std::chrono::microseconds::zero() && opts.duration.count() > 0;
+}
+
+//! CPUs this process may run on
+std::vector<int> allowed_cpus( )
+{
+    std::vector<int> cpus;
+#if defined( __linux__ )
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    if ( sched_getaffinity( 0, sizeof( set ), &set ) == 0 )
+    {
+        for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+        {
+            if ( CPU_ISSET( cpu, &set ) )
+            {
+                cpus.push_back( cpu );
+            }
+        }
+    }
+#endif
+    if ( cpus.empty() )
+    {
+        unsigned n = std::max( 1u, std::thread::hardware_concurrency() );
+        for ( unsigned cpu = 0; cpu < n; ++cpu )
+        {
+            cpus.push_back( static_cast<int>( cpu ) );
+        }
+    }
+    return cpus;
+}
+
+bool pin_to_cpu( int cpu )
+{
+#if defined( __linux__ )
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    return pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool set_realtime( int priority )
+{
+#if defined( __linux__ )
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam( pthread_self(), SCHED_FIFO, &param ) == 0;
+#else
+    (void)priority;
+    return false;
+#endif
+}
+
+//! sleep until an absolute steady clock time
+void sleep_until( clock_type::time_point target )
+{
+#if defined( __linux__ )
+    // libstdc++ and libc++ read CLOCK_MONOTONIC for steady_clock
+    auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>( target.time_since_epoch() );
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>( since_epoch.count() / 1000000000 );
+    ts.tv_nsec = static_cast<long>( since_epoch.count() % 1000000000 );
+    int error;
+    while ( ( error = clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr ) ) == EINTR )
+    {
+    }
+    if ( error != 0 )
+    {
+        std::fprintf( stderr, "clock_nanosleep: %s\n", std::strerror( error ) );
+        std::exit( 1 );
+    }
+#else
+    std::this_thread::sleep_until( target );
+#endif
+}
+
+void measure( const options& opts, clock_type::time_point start, clock_type::time_point stop,
+              thread_result& result )
+{
+    if ( opts.pin )
+    {
+        result.pinned = pin_to_cpu( result.cpu );
+    }
+    if ( opts.priority > 0 )
+    {
+        result.realtime = set_realtime( opts.priority );
+    }
+
+    auto interval = std::chrono::duration_cast<clock_type::duration>( opts.interval );
+    for ( auto target = start + interval; target < stop; target += interval )
+    {
+        sleep_until( target );
+        auto woke = clock_type::now();
+        auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>( woke - target );
+        result.latency.record( latency );
+        if ( latency > opts.outlier_threshold )
+        {
+            ++result.outlier_count;
+            if ( result.outliers.size() < opts.max_outliers )
+            {
+                result.outliers.push_back( outlier{ target, latency } );
+            }
+        }
+        // skip wake-ups that were missed entirely, as cyclictest does
+        while ( target + interval <= woke )
+        {
+            target += interval;
+        }
+    }
+}
+
+long long ns( std::chrono::nanoseconds d )
+{
+    return static_cast<long long>( d.count() );
+}
+
+void write_histogram_summary( std::FILE* out, const histogram_type& h, const char* indent )
+{
+    std::fprintf( out,
+        "%s\"count\": %llu,\n"
+        "%s\"min_ns\": %lld,\n"
+        "%s\"mean_ns\": %.1f,\n"
+        "%s\"p50_ns\": %lld,\n"
+        "%s\"p99_ns\": %lld,\n"
+        "%s\"p99_9_ns\": %lld,\n"
+        "%s\"p99_99_ns\": %lld,\n"
+        "%s\"max_ns\": %lld",
+        indent, static_cast<unsigned long long>( h.count() ),
+        indent, ns( h.min() ),
+        indent, h.mean().count(),
+        indent, ns( h.percentile( 50.0 ) ),
+        indent, ns( h.percentile( 99.0 ) ),
+        indent, ns( h.percentile( 99.9 ) ),
+        indent, ns( h.percentile( 99.99 ) ),
+        indent, ns( h.max() ) );
+}
+
+void write_json( std::FILE* out, const options& opts,
+                 const std::vector< std::unique_ptr<thread_result> >& results,
+                 const histogram_type& overall, const uteki::clock_mapper<>& mapper )
+{
+    std::fprintf( out, "{\n  \"config\": {\n" );
+    std::fprintf( out, "    \"threads\": %u,\n", opts.threads );
+    std::fprintf( out, "    \"interval_us\": %lld,\n", static_cast<long long>( opts.interval.count() ) );
+    std::fprintf( out, "    \"duration_s\": %lld,\n", static_cast<long long>( opts.duration.count() ) );
+    std::fprintf( out, "    \"outlier_us\": %lld,\n", static_cast<long long>( opts.outlier_threshold.count() ) );
+    std::fprintf( out, "    \"priority\": %d\n  },\n", opts.priority );
+
+    std::fprintf( out, "  \"overall\": {\n" );
+    write_histogram_summary( out, overall, "    " );
+    std::fprintf( out, "\n  },\n  \"threads\": [\n" );
+    for ( std::size_t t = 0; t < results.size(); ++t )
+    {
+        const thread_result& r = *results[t];
+        std::fprintf( out, "    {\n" );
+        std::fprintf( out, "      \"thread\": %u,\n", r.index );
+        std::fprintf( out, "      \"cpu\": %d,\n", r.pinned ? r.cpu : -1 );
+        std::fprintf( out, "      \"realtime\": %s,\n", r.realtime ? "true" : "false" );
+        write_histogram_summary( out, r.latency, "      " );
+        std::fprintf( out, ",\n      \"outlier_count\": %llu,\n      \"outliers\": [",
+                      static_cast<unsigned long long>( r.outlier_count ) );
+        for ( std::size_t k = 0; k < r.outliers.size(); ++k )
+        {
+            auto wall = mapper.to_wall( r.outliers[k].target );
+            auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>( wall.time_since_epoch() );
+            std::fprintf( out, "%s\n        { \"time_unix_ns\": %lld, \"latency_ns\": %lld }",
+                          k == 0 ? "" : ",", ns( wall_ns ), ns( r.outliers[k].latency ) );
+        }
+        std::fprintf( out, "%s]\n    }%s\n", r.outliers.empty() ? "" : "\n      ",
+                      t + 1 < results.size() ? "," : "" );
+    }
+    std::fprintf( out, "  ]\n}\n" );
+}
+
+}
+
+int main( int argc, char** argv )
+{
+    std::vector<int> cpus = allowed_cpus();
+    options opts;
+    if ( ! parse_options( argc, argv, cpus.size(), opts ) )
+    {
+        usage( argv[0] );
+        return 2;
+    }
+
+    uteki::clock_mapper<> mapper;
+
+    std::vector< std::unique_ptr<thread_result> > results;
+    for ( unsigned t = 0; t < opts.threads; ++t )
+    {
+        results.emplace_back( new thread_result );
+        results.back()->index = t;
+        results.back()->cpu = cpus[ t % cpus.size() ];
+    }
+
+    // all threads share the same schedule, starting shortly after creation
+    auto start = clock_type::now() + std::chrono::milliseconds( 50 );
+    auto stop = start + opts.duration;
+    std::vector<std::thread> threads;
+    for ( auto& r : results )
+    {
+        thread_result* result = r.get();
+        threads.emplace_back( [&opts, start, stop, result]() { measure( opts, start, stop, *result ); } );
+    }
+    for ( auto& th : threads )
+    {
+        th.join();
+    }
+    mapper.sample();
+
+    histogram_type overall;
+    bool any_unpinned = false;
+    bool any_normal = false;
+    std::uint64_t outlier_count = 0;
+    for ( const auto& r : results )
+    {
+        overall.merge( r->latency );
+        outlier_count += r->outlier_count;
+        any_unpinned = any_unpinned || ( opts.pin && ! r->pinned );
+        any_normal = any_normal || ( opts.priority > 0 && ! r->realtime );
+    }
+    if ( any_unpinned )
+    {
+        std::fprintf( stderr, "warning: some threads could not be pinned to a CPU\n" );
+    }
+    if ( any_normal )
+    {
+        std::fprintf( stderr, "warning: real-time priority was not granted; using normal scheduling\n" );
+    }
+
+    std::FILE* out = stdout;
+    if ( ! opts.output.empty() )
+    {
+        out = std::fopen( opts.output.c_str(), "w" );
+        if ( out == nullptr )
+        {
+            std::fprintf( stderr, "cannot open %s: %s\n", opts.output.c_str(), std::strerror( errno ) );
+            return 1;
+        }
+    }
+    write_json( out, opts, results, overall, mapper );
+    if ( out != stdout )
+    {
+        std::fclose( out );
+    }
+
+    std::fprintf( stderr, "wake-ups %llu  max %.1f us  p99.99 %.1f us  p99 %.1f us  outliers %llu\n",
+                  static_cast<unsigned long long>( overall.count() ),
+                  overall.max().count() / 1e3, overall.percentile( 99.99 ).count() / 1e3,
+                  overall.percentile( 99.0 ).count() / 1e3,
+                  static_cast<unsigned long long>( outlier_count ) );
+    return 0;
+}
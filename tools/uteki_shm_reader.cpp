@@ -0,0 +1,154 @@
+//
+//  uteki_shm_reader C++ code
+//
+//  Copyright © 2021 Mitchell Burghart.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+// Prints the timer aggregates a process exports with `uteki::shm_exporter`.
+//
+// The reader attaches read-only to the shared memory segment, so the
+// measured process does no work on its behalf. Without `--interval-ms` the
+// records are printed once; with it they are printed repeatedly, together
+// with the number of measurements added since the previous print. When the
+// writer restarts and replaces the segment, the reader attaches to the new
+// one before the next print. The exit status is 2 on a usage error or when
+// the segment cannot be attached.
+
+#include "uteki/shm_export.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+void usage( const char* program )
+{
+    std::fprintf( stderr,
+        "usage: %s [options] segment\n"
+        "  --interval-ms N   print every N milliseconds instead of once\n"
+        "  --count N         number of prints when streaming, default unlimited\n",
+        program );
+}
+
+double us( std::uint64_t ns )
+{
+    return static_cast<double>( ns ) / 1000.0;
+}
+
+}
+
+int main( int argc, char** argv )
+{
+    long interval_ms = 0;
+    unsigned long count = 0;
+    std::string name;
+    for ( int k = 1; k < argc; ++k )
+    {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if ( arg == "--interval-ms" && has_value )
+        {
+            interval_ms = std::atol( argv[++k] );
+        }
+        else if ( arg == "--count" && has_value )
+        {
+            count = std::strtoul( argv[++k], nullptr, 10 );
+        }
+        else if ( arg.compare( 0, 2, "--" ) != 0 && name.empty() )
+        {
+            name = arg;
+        }
+        else
+        {
+            usage( argv[0] );
+            return 2;
+        }
+    }
+    if ( name.empty() || interval_ms < 0 )
+    {
+        usage( argv[0] );
+        return 2;
+    }
+
+    uteki::shm_reader reader;
+    std::string error;
+    if ( ! reader.open( name, &error ) )
+    {
+        std::fprintf( stderr, "%s\n", error.c_str() );
+        return 2;
+    }
+    std::printf( "segment %s, writer pid %u, %zu of %zu records\n",
+                 name.c_str(), reader.writer_pid(), reader.size(), reader.capacity() );
+
+    std::vector<std::uint64_t> previous;
+    for ( unsigned long round = 0; ; ++round )
+    {
+        // a removed segment stays attached, showing its last values, until
+        // a new writer creates one
+        if ( round > 0 && reader.replaced() && uteki::shm_reader().open( name ) )
+        {
+            if ( ! reader.open( name, &error ) )
+            {
+                std::fprintf( stderr, "%s\n", error.c_str() );
+                return 2;
+            }
+            previous.clear();
+            std::printf( "segment %s replaced, writer pid %u, %zu of %zu records\n",
+                         name.c_str(), reader.writer_pid(), reader.size(), reader.capacity() );
+        }
+        std::printf( "%-32s %12s %10s %10s %10s %10s %10s %10s %10s\n",
+                     "name", "count", "new", "mean us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us" );
+        std::size_t size = reader.size();
+        previous.resize( size, 0 );
+        for ( std::size_t index = 0; index < size; ++index )
+        {
+            uteki::shm_snapshot snapshot;
+            if ( ! reader.read( index, snapshot ) )
+            {
+                std::printf( "%-32s %12s\n", "?", "busy" );
+                continue;
+            }
+            const uteki::shm_stats& s = snapshot.stats;
+            // a writer that reset its histogram starts counting again from zero
+            std::uint64_t added = ( s.count >= previous[index] ) ? s.count - previous[index] : s.count;
+            double mean = ( s.count > 0 ) ? us( s.total_ns ) / static_cast<double>( s.count ) : 0.0;
+            std::printf( "%-32s %12llu %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                         snapshot.name, static_cast<unsigned long long>( s.count ),
+                         static_cast<unsigned long long>( added ),
+                         mean, us( s.p50_ns ), us( s.p90_ns ), us( s.p99_ns ), us( s.p999_ns ), us( s.max_ns ) );
+            previous[index] = s.count;
+        }
+        std::fflush( stdout );
+        if ( interval_ms == 0 || ( count != 0 && round + 1 >= count ) )
+        {
+            break;
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( interval_ms ) );
+        std::printf( "\n" );
+    }
+    return 0;
+}